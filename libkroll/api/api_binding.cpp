@@ -11,6 +11,7 @@
 #include "script_binding.h"
 #include <kroll/thread_manager.h>
 #include <algorithm>
+#include <Poco/FileStream.h>
 
 using std::string;
 using std::vector;
@@ -205,6 +206,157 @@ namespace kroll
 		this->SetMethod("createBytes", &APIBinding::_CreateBytes);
 		this->SetMethod("createBlob", &APIBinding::_CreateBytes);
 
+		/**
+		 * @tiapi(method=True,name=API.createBytesBuilder,since=0.9) Create a
+		 * @tiapi BytesBuilder, which accumulates data without copying it on
+		 * @tiapi every append.
+		 * @tiarg[String, contents, optional=true] The initial contents.
+		 * @tiresult[BytesBuilder] A new BytesBuilder.
+		 */
+		this->SetMethod("createBytesBuilder", &APIBinding::_CreateBytesBuilder);
+
+		/**
+		 * @tiapi(method=True,name=API.createBytesReader,since=0.9) Create a
+		 * @tiapi BytesReader, which reads lines, records and numbers from
+		 * @tiapi a Bytes without copying it.
+		 * @tiarg[Bytes|String, contents] The data to read.
+		 * @tiresult[BytesReader] A new BytesReader.
+		 */
+		this->SetMethod("createBytesReader", &APIBinding::_CreateBytesReader);
+
+		/**
+		 * @tiapi(method=True,name=API.createDeflateStream,since=0.9) Create a
+		 * @tiapi CompressionStream which compresses data a chunk at a time.
+		 * @tiarg[String, format, optional=true] 'zlib' (the default) or 'gzip'.
+		 * @tiarg[Number, level, optional=true] 0 (none) to 9 (best).
+		 * @tiresult[CompressionStream] A new CompressionStream.
+		 */
+		this->SetMethod("createDeflateStream", &APIBinding::_CreateDeflateStream);
+
+		/**
+		 * @tiapi(method=True,name=API.createInflateStream,since=0.9) Create a
+		 * @tiapi CompressionStream which decompresses data a chunk at a time.
+		 * @tiarg[String, format, optional=true] 'zlib' (the default) or 'gzip'.
+		 * @tiresult[CompressionStream] A new CompressionStream.
+		 */
+		this->SetMethod("createInflateStream", &APIBinding::_CreateInflateStream);
+
+		/**
+		 * @tiapi(method=True,name=API.mapFile,since=0.9) Map a file into
+		 * @tiapi memory read-only. Pages are read in as they are touched and
+		 * @tiapi slices share the mapping, so large files can be sliced cheaply.
+		 * @tiarg[String, path] The path of the file.
+		 * @tiarg[String, access, optional=true] How the contents will be read:
+		 * @tiarg 'normal' (the default), 'sequential' or 'random'.
+		 * @tiresult[Bytes] A Bytes which views the file's contents.
+		 */
+		this->SetMethod("mapFile", &APIBinding::_MapFile);
+
+		/**
+		 * @tiapi(method=True,name=API.getAllocatorStatistics,since=0.9)
+		 * @tiapi Get statistics from the allocators used for binding objects
+		 * @tiapi and for the buffers of Bytes.
+		 * @tiresult[Object] An object with a 'types' list (live objects and
+		 * @tiresult bytes per type), a 'sizeClasses' list (slab occupancy) and
+		 * @tiresult a 'bufferPool' object (retained bytes and buffer reuse).
+		 */
+		this->SetMethod("getAllocatorStatistics", &APIBinding::_GetAllocatorStatistics);
+
+		/**
+		 * @tiapi(method=True,name=API.runCycleCollector,since=0.9)
+		 * @tiapi Run a full pass of the cross-language cycle collector on
+		 * @tiapi the main thread.
+		 * @tiresult[Number] The number of bridge objects reclaimed.
+		 */
+		this->SetMethod("runCycleCollector", &APIBinding::_RunCycleCollector);
+
+		/**
+		 * @tiapi(method=True,name=API.setCycleCollectorEnabled,since=0.9)
+		 * @tiapi Start or stop running the cycle collector periodically.
+		 * Objects created while it is stopped are never collected.
+		 * @tiarg[Boolean, enabled] Whether the collector should run.
+		 * @tiarg[Number, interval, optional=true] Milliseconds between passes.
+		 */
+		this->SetMethod("setCycleCollectorEnabled", &APIBinding::_SetCycleCollectorEnabled);
+
+		/**
+		 * @tiapi(method=True,name=API.getCycleCollectorStatistics,since=0.9)
+		 * @tiapi Get statistics from the cross-language cycle collector.
+		 * @tiresult[Object] An object with the pass count, the objects
+		 * @tiresult scanned and reclaimed by the last pass, its duration and a
+		 * @tiresult 'reclaimedPerPass' list of recent passes.
+		 */
+		this->SetMethod("getCycleCollectorStatistics", &APIBinding::_GetCycleCollectorStatistics);
+
+		/**
+		 * @tiapi(method=True,name=API.getProfilerStatistics,since=0.9)
+		 * @tiapi Get the timings the profiler collected so far, merged
+		 * @tiapi from all threads.
+		 * @tiresult[Array<Object>] one object per event type and name, the
+		 * @tiresult longest in total first, with the count and the total,
+		 * @tiresult max, p50, p90 and p99 times in microseconds
+		 */
+		this->SetMethod("getProfilerStatistics", &APIBinding::_GetProfilerStatistics);
+
+		/**
+		 * @tiapi(method=True,name=API.setProfilingEnabled,since=0.9)
+		 * @tiapi Start or stop timing the gets, sets and calls which go
+		 * @tiapi through the global object. Objects reached while profiling
+		 * @tiapi is stopped are not profiled later.
+		 * @tiarg[Boolean, enabled] Whether to profile.
+		 * @tiarg[Number, sampleEvery, optional=true] Time only one in this
+		 * @tiarg many events (default: 1).
+		 */
+		this->SetMethod("setProfilingEnabled", &APIBinding::_SetProfilingEnabled);
+
+		/**
+		 * @tiapi(method=True,name=API.isProfilingEnabled,since=0.9)
+		 * @tiapi Check whether the profiler is running.
+		 * @tiresult[Boolean] true if the profiler is running.
+		 */
+		this->SetMethod("isProfilingEnabled", &APIBinding::_IsProfilingEnabled);
+
+		/**
+		 * @tiapi(method=True,name=API.resetProfiler,since=0.9)
+		 * @tiapi Forget the timings the profiler collected so far.
+		 */
+		this->SetMethod("resetProfiler", &APIBinding::_ResetProfiler);
+
+		/**
+		 * @tiapi(method=True,name=API.setTracingEnabled,since=0.9)
+		 * @tiapi Start or stop recording spans around method calls across
+		 * @tiapi the language bridges. Starting drops the spans recorded before.
+		 * @tiarg[Boolean, enabled] Whether to record spans.
+		 * @tiarg[Number, spansPerThread, optional=true] How many of its most
+		 * @tiarg recent spans each thread keeps (default: 65536).
+		 */
+		this->SetMethod("setTracingEnabled", &APIBinding::_SetTracingEnabled);
+
+		/**
+		 * @tiapi(method=True,name=API.writeTrace,since=0.9)
+		 * @tiapi Write the recorded spans to a file in the Chrome trace-event
+		 * @tiapi format, which chrome://tracing and Perfetto can load.
+		 * @tiarg[String, path] The path of the file to write.
+		 */
+		this->SetMethod("writeTrace", &APIBinding::_WriteTrace);
+
+		/**
+		 * @tiapi(method=True,name=API.setObjectAccountingEnabled,since=0.9)
+		 * @tiapi Start or stop counting the objects created by type. Objects
+		 * @tiapi created while counting is stopped are never counted.
+		 * @tiarg[Boolean, enabled] Whether to count new objects.
+		 */
+		this->SetMethod("setObjectAccountingEnabled", &APIBinding::_SetObjectAccountingEnabled);
+
+		/**
+		 * @tiapi(method=True,name=API.getObjectStatistics,since=0.9)
+		 * @tiapi Get the counts of live objects by type.
+		 * @tiresult[Array<Object>] one object per type, the one with the most
+		 * @tiresult live bytes first, with the type, liveObjects, liveBytes and
+		 * @tiresult totalObjects.
+		 */
+		this->SetMethod("getObjectStatistics", &APIBinding::_GetObjectStatistics);
+
 		/**
 		 * @tiapi(method=True,name=API.log,since=0.2)
 		 * @tiapi Log a statement with a given severity
@@ -282,6 +434,34 @@ namespace kroll
 		 * @tiresult[Number] the threshold of severity to log
 		 */
 		this->SetMethod("getLogLevel", &APIBinding::_GetLogLevel);
+
+		/**
+		 * @tiapi(method=True,name=API.setLogLimit,since=0.9)
+		 * @tiapi Limit how many messages the loggers under a name prefix,
+		 * @tiapi such as 'Kroll.JavaScript.*', may log. Dropped messages are
+		 * @tiapi counted and the counts logged every few seconds.
+		 * @tiarg[String, prefix] the logger name prefix
+		 * @tiarg[Number, messagesPerSecond] the sustained rate, or 0 for no rate limit
+		 * @tiarg[Number, burst, optional=true] messages allowed at once (default: messagesPerSecond)
+		 * @tiarg[Number, sampleEvery, optional=true] keep only one in this many messages (default: 1)
+		 */
+		this->SetMethod("setLogLimit", &APIBinding::_SetLogLimit);
+
+		/**
+		 * @tiapi(method=True,name=API.removeLogLimit,since=0.9)
+		 * @tiapi Remove the limit on a logger name prefix, or all limits
+		 * @tiarg[String, prefix, optional=true] the prefix given to setLogLimit
+		 */
+		this->SetMethod("removeLogLimit", &APIBinding::_RemoveLogLimit);
+
+		/**
+		 * @tiapi(method=True,name=API.getLogLimits,since=0.9)
+		 * @tiapi Get the log limits and how many messages each one dropped
+		 * @tiresult[Array<Object>] one object per limit with its prefix,
+		 * @tiresult messagesPerSecond, burst, sampleEvery and the admitted,
+		 * @tiresult sampledOut and rateLimited message counts
+		 */
+		this->SetMethod("getLogLimits", &APIBinding::_GetLogLimits);
 	
 		/**
 		 * @tiapi(method=True,name=API.print,since=0.6)
@@ -492,6 +672,51 @@ namespace kroll
 		result->SetInt(Logger::GetRootLogger()->GetLevel());
 	}
 
+	void APIBinding::_SetLogLimit(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("setLogLimit", "s n ?n n");
+		double messagesPerSecond = args.GetNumber(1);
+		int burst = (int) args.GetNumber(2, messagesPerSecond);
+		int sampleEvery = (int) args.GetNumber(3, 1);
+		if (messagesPerSecond < 0 || sampleEvery < 1)
+		{
+			throw ValueException::FromString(
+				"setLogLimit expects a rate of at least 0 and a sample interval of at least 1");
+		}
+		LogLimiter::SetLimit(args.GetString(0), messagesPerSecond, burst, sampleEvery);
+	}
+
+	void APIBinding::_RemoveLogLimit(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("removeLogLimit", "?s");
+		if (args.size() > 0)
+			LogLimiter::RemoveLimit(args.GetString(0));
+		else
+			LogLimiter::RemoveAllLimits();
+	}
+
+	void APIBinding::_GetLogLimits(const ValueList& args, KValueRef result)
+	{
+		std::vector<LogLimitInfo> limits;
+		LogLimiter::GetLimits(limits);
+
+		KListRef list = new StaticBoundList();
+		for (size_t i = 0; i < limits.size(); i++)
+		{
+			LogLimitInfo& l = limits[i];
+			KObjectRef limit = new StaticBoundObject();
+			limit->SetString("prefix", l.prefix);
+			limit->SetDouble("messagesPerSecond", l.messagesPerSecond);
+			limit->SetInt("burst", l.burst);
+			limit->SetInt("sampleEvery", l.sampleEvery);
+			limit->SetDouble("admitted", (double) l.admitted);
+			limit->SetDouble("sampledOut", (double) l.sampledOut);
+			limit->SetDouble("rateLimited", (double) l.rateLimited);
+			list->Append(Value::NewObject(limit));
+		}
+		result->SetList(list);
+	}
+
 	void APIBinding::_Print(const ValueList& args, KValueRef result)
 	{
 		for (size_t c=0; c < args.size(); c++)
@@ -931,7 +1156,11 @@ namespace kroll
 	{
 		if (value->IsObject())
 		{
-			blobs.push_back(value->ToObject().cast<Bytes>());
+			BytesBuilderRef builder(value->ToObject().cast<BytesBuilder>());
+			if (!builder.isNull())
+				builder->GetChunks(blobs);
+			else
+				blobs.push_back(value->ToObject().cast<Bytes>());
 		}
 		else if (value->IsString())
 		{
@@ -962,6 +1191,295 @@ namespace kroll
 		result->SetObject(Bytes::GlobBytes(blobs));
 	}
 
+	void APIBinding::_CreateBytesBuilder(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("createBytesBuilder", "?s|o|l|i");
+		std::vector<BytesRef> blobs;
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			GetBytes(args.at(i), blobs);
+		}
+
+		BytesBuilderRef builder(new BytesBuilder());
+		for (size_t i = 0; i < blobs.size(); i++)
+		{
+			builder->Append(blobs[i]);
+		}
+		result->SetObject(builder);
+	}
+
+	void APIBinding::_CreateBytesReader(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("createBytesReader", "s|o");
+		BytesRef bytes(args.GetObject(0).cast<Bytes>());
+		if (bytes.isNull())
+		{
+			if (!args.at(0)->IsString())
+				throw ValueException::FromString("createBytesReader expects Bytes or a String");
+			bytes = new Bytes(args.GetString(0));
+		}
+		result->SetObject(new BytesReader(bytes));
+	}
+
+	void APIBinding::_CreateDeflateStream(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("createDeflateStream", "?s n");
+		result->SetObject(new CompressionStream(CompressionStream::DEFLATE,
+			CompressionStream::GetFormat(args.GetString(0, "zlib")),
+			(int) args.GetNumber(1, -1)));
+	}
+
+	void APIBinding::_CreateInflateStream(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("createInflateStream", "?s");
+		result->SetObject(new CompressionStream(CompressionStream::INFLATE,
+			CompressionStream::GetFormat(args.GetString(0, "zlib"))));
+	}
+
+	void APIBinding::_MapFile(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("mapFile", "s ?s");
+		std::string access(args.GetString(1, "normal"));
+
+		Bytes::AccessPattern pattern = Bytes::NORMAL_ACCESS;
+		if (access == "sequential")
+			pattern = Bytes::SEQUENTIAL_ACCESS;
+		else if (access == "random")
+			pattern = Bytes::RANDOM_ACCESS;
+		else if (access != "normal")
+			throw ValueException::FromFormat("Unknown access pattern: %s",
+				access.c_str());
+
+		result->SetObject(Bytes::MapFile(args.GetString(0), 0, -1, pattern));
+	}
+
+	void APIBinding::_GetAllocatorStatistics(const ValueList& args, KValueRef result)
+	{
+		std::vector<SlabTypeCounts> typeCounts;
+		SlabAllocator::GetTypeCounts(typeCounts);
+		KListRef types = new StaticBoundList();
+		for (size_t i = 0; i < typeCounts.size(); i++)
+		{
+			SlabTypeCounts& c = typeCounts[i];
+			KObjectRef t = new StaticBoundObject();
+			t->SetString("type", c.typeName);
+			t->SetInt("liveObjects", (int) c.liveObjects);
+			t->SetDouble("liveBytes", (double) c.liveBytes);
+			t->SetDouble("allocations", (double) c.totalAllocations);
+			types->Append(Value::NewObject(t));
+		}
+
+		std::vector<SlabSizeClassStats> classStats;
+		SlabAllocator::GetSizeClassStats(classStats);
+		KListRef sizeClasses = new StaticBoundList();
+		for (size_t i = 0; i < classStats.size(); i++)
+		{
+			SlabSizeClassStats& s = classStats[i];
+			KObjectRef c = new StaticBoundObject();
+			c->SetInt("blockSize", (int) s.blockSize);
+			c->SetInt("slabs", (int) s.slabs);
+			c->SetDouble("reservedBytes", (double) s.reservedBytes);
+			c->SetInt("liveBlocks", (int) s.liveBlocks);
+			c->SetInt("depotBlocks", (int) s.depotBlocks);
+			c->SetDouble("occupancy", s.reservedBytes == 0 ? 0.0 :
+				(double) (s.liveBlocks * s.blockSize) / (double) s.reservedBytes);
+			sizeClasses->Append(Value::NewObject(c));
+		}
+
+		BufferPoolStats poolStats;
+		BufferPool::GetStatistics(poolStats);
+		KListRef bufferClasses = new StaticBoundList();
+		for (size_t i = 0; i < poolStats.sizeClasses.size(); i++)
+		{
+			BufferPoolSizeClassStats& s = poolStats.sizeClasses[i];
+			KObjectRef c = new StaticBoundObject();
+			c->SetInt("blockSize", (int) s.blockSize);
+			c->SetDouble("allocations", (double) s.allocations);
+			c->SetDouble("reused", (double) s.reused);
+			c->SetInt("liveBlocks", (int) s.liveBlocks);
+			c->SetInt("depotBlocks", (int) s.depotBlocks);
+			bufferClasses->Append(Value::NewObject(c));
+		}
+
+		KObjectRef bufferPool = new StaticBoundObject();
+		bufferPool->SetDouble("retainedBytes", (double) poolStats.retainedBytes);
+		bufferPool->SetDouble("retentionLimit", (double) poolStats.retentionLimit);
+		bufferPool->SetDouble("discardedBlocks", (double) poolStats.discardedBlocks);
+		bufferPool->SetDouble("unpooledAllocations", (double) poolStats.unpooledAllocations);
+		bufferPool->SetList("sizeClasses", bufferClasses);
+
+		KObjectRef stats = new StaticBoundObject();
+		stats->SetList("types", types);
+		stats->SetList("sizeClasses", sizeClasses);
+		stats->SetObject("bufferPool", bufferPool);
+		result->SetObject(stats);
+	}
+
+	static KValueRef RunCycleCollector(const ValueList& args)
+	{
+		return Value::NewInt(CycleCollector::Collect());
+	}
+
+	void APIBinding::_RunCycleCollector(const ValueList& args, KValueRef result)
+	{
+		result->SetValue(RunOnMainThread(
+			new KFunctionPtrMethod(&RunCycleCollector), ValueList()));
+	}
+
+	static KValueRef DisableCycleCollector(const ValueList& args)
+	{
+		CycleCollector::Disable();
+		return Value::Undefined;
+	}
+
+	void APIBinding::_SetCycleCollectorEnabled(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("setCycleCollectorEnabled", "b ?n");
+		if (!args.GetBool(0))
+		{
+			RunOnMainThread(new KFunctionPtrMethod(&DisableCycleCollector), ValueList());
+		}
+		else if (!CycleCollector::Enable((long) args.GetNumber(1, 5000)))
+		{
+			throw ValueException::FromString("The cycle collector is not "
+				"available with biased reference counting");
+		}
+	}
+
+	void APIBinding::_GetCycleCollectorStatistics(const ValueList& args, KValueRef result)
+	{
+		CycleCollectorStatistics statistics(CycleCollector::GetStatistics());
+		KListRef reclaimedPerPass = new StaticBoundList();
+		for (size_t i = 0; i < statistics.reclaimedPerPass.size(); i++)
+			reclaimedPerPass->Append(Value::NewInt(statistics.reclaimedPerPass[i]));
+
+		KObjectRef stats = new StaticBoundObject();
+		stats->SetBool("enabled", CycleCollector::IsEnabled());
+		stats->SetInt("passes", statistics.passes);
+		stats->SetInt("lastScanned", statistics.lastScanned);
+		stats->SetInt("lastCandidates", statistics.lastCandidates);
+		stats->SetInt("lastReclaimed", statistics.lastReclaimed);
+		stats->SetInt("totalReclaimed", statistics.totalReclaimed);
+		stats->SetDouble("lastMilliseconds", statistics.lastMilliseconds);
+		stats->SetList("reclaimedPerPass", reclaimedPerPass);
+		result->SetObject(stats);
+	}
+
+	void APIBinding::_GetProfilerStatistics(const ValueList& args, KValueRef result)
+	{
+		std::vector<ProfileStatistics> statistics;
+		Profiler::GetStatistics(statistics);
+
+		KListRef list = new StaticBoundList();
+		for (size_t i = 0; i < statistics.size(); i++)
+		{
+			ProfileStatistics& s = statistics[i];
+			KObjectRef site = new StaticBoundObject();
+			site->SetString("event", s.eventType);
+			site->SetString("name", s.name);
+			site->SetDouble("count", (double) s.count);
+			site->SetDouble("total", (double) s.total);
+			site->SetDouble("max", (double) s.max);
+			site->SetDouble("p50", (double) s.p50);
+			site->SetDouble("p90", (double) s.p90);
+			site->SetDouble("p99", (double) s.p99);
+			list->Append(Value::NewObject(site));
+		}
+		result->SetList(list);
+	}
+
+	void APIBinding::_SetProfilingEnabled(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("setProfilingEnabled", "b ?n");
+		if (args.GetBool(0))
+		{
+			int sampleEvery = (int) args.GetNumber(1, 1);
+			if (sampleEvery < 1)
+			{
+				throw ValueException::FromString(
+					"setProfilingEnabled expects a sample interval of at least 1");
+			}
+			Profiler::Enable(sampleEvery);
+		}
+		else
+		{
+			Profiler::Disable();
+		}
+	}
+
+	void APIBinding::_IsProfilingEnabled(const ValueList& args, KValueRef result)
+	{
+		result->SetBool(Profiler::IsEnabled());
+	}
+
+	void APIBinding::_ResetProfiler(const ValueList& args, KValueRef result)
+	{
+		Profiler::Reset();
+	}
+
+	void APIBinding::_SetTracingEnabled(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("setTracingEnabled", "b ?n");
+		if (args.GetBool(0))
+		{
+			double spansPerThread = args.GetNumber(1, 65536);
+			if (spansPerThread < 1)
+			{
+				throw ValueException::FromString(
+					"setTracingEnabled expects room for at least one span per thread");
+			}
+			Tracer::Enable((size_t) spansPerThread);
+		}
+		else
+		{
+			Tracer::Disable();
+		}
+	}
+
+	void APIBinding::_WriteTrace(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("writeTrace", "s");
+		std::string path(args.GetString(0));
+		try
+		{
+			Poco::FileOutputStream stream(path);
+			Tracer::WriteTrace(stream);
+		}
+		catch (Poco::Exception& e)
+		{
+			throw ValueException::FromFormat("Could not write the trace to %s: %s",
+				path.c_str(), e.displayText().c_str());
+		}
+	}
+
+	void APIBinding::_SetObjectAccountingEnabled(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("setObjectAccountingEnabled", "b");
+		if (args.GetBool(0))
+			ObjectAccounting::Enable();
+		else
+			ObjectAccounting::Disable();
+	}
+
+	void APIBinding::_GetObjectStatistics(const ValueList& args, KValueRef result)
+	{
+		std::vector<ObjectTypeStats> stats;
+		ObjectAccounting::GetStatistics(stats);
+
+		KListRef list = new StaticBoundList();
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			ObjectTypeStats& s = stats[i];
+			KObjectRef type = new StaticBoundObject();
+			type->SetString("type", s.type);
+			type->SetDouble("liveObjects", (double) s.liveObjects);
+			type->SetDouble("liveBytes", (double) s.liveBytes);
+			type->SetDouble("totalObjects", (double) s.totalObjects);
+			list->Append(Value::NewObject(type));
+		}
+		result->SetList(list);
+	}
+
 	KObjectWrapper::KObjectWrapper(KObjectRef object) :
 		object(object)
 	{
@@ -56,6 +56,9 @@ namespace kroll
 		Logger::Level ValueToLevel(KValueRef v);
 		void _SetLogLevel(const ValueList& args, KValueRef result);
 		void _GetLogLevel(const ValueList& args, KValueRef result);
+		void _SetLogLimit(const ValueList& args, KValueRef result);
+		void _RemoveLogLimit(const ValueList& args, KValueRef result);
+		void _GetLogLimits(const ValueList& args, KValueRef result);
 		void _RunOnMainThread(const ValueList& args, KValueRef result);
 		void _RunOnMainThreadAsync(const ValueList& args, KValueRef result);
 
@@ -89,6 +92,23 @@ namespace kroll
 		void _CreateKMethod(const ValueList& args, KValueRef result);
 		void _CreateKList(const ValueList& args, KValueRef result);
 		void _CreateBytes(const ValueList& args, KValueRef result);
+		void _CreateBytesBuilder(const ValueList& args, KValueRef result);
+		void _CreateBytesReader(const ValueList& args, KValueRef result);
+		void _CreateDeflateStream(const ValueList& args, KValueRef result);
+		void _CreateInflateStream(const ValueList& args, KValueRef result);
+		void _MapFile(const ValueList& args, KValueRef result);
+		void _GetAllocatorStatistics(const ValueList& args, KValueRef result);
+		void _RunCycleCollector(const ValueList& args, KValueRef result);
+		void _SetCycleCollectorEnabled(const ValueList& args, KValueRef result);
+		void _GetCycleCollectorStatistics(const ValueList& args, KValueRef result);
+		void _GetProfilerStatistics(const ValueList& args, KValueRef result);
+		void _SetProfilingEnabled(const ValueList& args, KValueRef result);
+		void _IsProfilingEnabled(const ValueList& args, KValueRef result);
+		void _ResetProfiler(const ValueList& args, KValueRef result);
+		void _SetTracingEnabled(const ValueList& args, KValueRef result);
+		void _WriteTrace(const ValueList& args, KValueRef result);
+		void _SetObjectAccountingEnabled(const ValueList& args, KValueRef result);
+		void _GetObjectStatistics(const ValueList& args, KValueRef result);
 	};
 
 	/**
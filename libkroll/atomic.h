@@ -0,0 +1,92 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_ATOMIC_H_
+#define _KR_ATOMIC_H_
+
+#include "base.h"
+
+#ifdef OS_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+namespace kroll
+{
+	/**
+	 * Small portable wrappers around the platform's atomic primitives. All
+	 * of these are full memory barriers. Unlike Poco::AtomicCounter, they
+	 * work on plain words, so they can be used for packed counters and flags.
+	 */
+#ifdef OS_WIN32
+	typedef LONG AtomicWord;
+
+	inline AtomicWord AtomicAdd(volatile AtomicWord* target, AtomicWord amount)
+	{
+		return InterlockedExchangeAdd(target, amount) + amount;
+	}
+
+	inline bool AtomicCompareAndSwap(volatile AtomicWord* target,
+		AtomicWord oldValue, AtomicWord newValue)
+	{
+		return InterlockedCompareExchange(target, newValue, oldValue) == oldValue;
+	}
+
+	inline bool AtomicCompareAndSwapPointer(void* volatile* target,
+		void* oldValue, void* newValue)
+	{
+		return InterlockedCompareExchangePointer(target, newValue, oldValue) == oldValue;
+	}
+#else
+	typedef int AtomicWord;
+
+	inline AtomicWord AtomicAdd(volatile AtomicWord* target, AtomicWord amount)
+	{
+		return __sync_add_and_fetch(target, amount);
+	}
+
+	inline bool AtomicCompareAndSwap(volatile AtomicWord* target,
+		AtomicWord oldValue, AtomicWord newValue)
+	{
+		return __sync_bool_compare_and_swap(target, oldValue, newValue);
+	}
+
+	inline bool AtomicCompareAndSwapPointer(void* volatile* target,
+		void* oldValue, void* newValue)
+	{
+		return __sync_bool_compare_and_swap(target, oldValue, newValue);
+	}
+#endif
+
+	/**
+	 * Atomically set bits in a word.
+	 * @return the value of the word before the bits were set
+	 */
+	inline AtomicWord AtomicOr(volatile AtomicWord* target, AtomicWord bits)
+	{
+		AtomicWord oldValue;
+		do
+		{
+			oldValue = *target;
+		} while (!AtomicCompareAndSwap(target, oldValue, oldValue | bits));
+		return oldValue;
+	}
+
+	/**
+	 * Atomically clear bits in a word.
+	 * @return the value of the word before the bits were cleared
+	 */
+	inline AtomicWord AtomicClear(volatile AtomicWord* target, AtomicWord bits)
+	{
+		AtomicWord oldValue;
+		do
+		{
+			oldValue = *target;
+		} while (!AtomicCompareAndSwap(target, oldValue, oldValue & ~bits));
+		return oldValue;
+	}
+}
+
+#endif
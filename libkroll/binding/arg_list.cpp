@@ -12,25 +12,25 @@ namespace kroll
 
 	ArgList::ArgList()
 	{
-		this->args = new std::vector<KValueRef>;
+		this->args = new ArgVector;
 	}
 
 	ArgList::ArgList(KValueRef a)
 	{
-		this->args = new std::vector<KValueRef>;
+		this->args = new ArgVector;
 		this->args->push_back(a);
 	}
 
 	ArgList::ArgList(KValueRef a, KValueRef b)
 	{
-		this->args = new std::vector<KValueRef>;
+		this->args = new ArgVector;
 		this->args->push_back(a);
 		this->args->push_back(b);
 	}
 
 	ArgList::ArgList(KValueRef a, KValueRef b, KValueRef c)
 	{
-		this->args = new std::vector<KValueRef>;
+		this->args = new ArgVector;
 		this->args->push_back(a);
 		this->args->push_back(b);
 		this->args->push_back(c);
@@ -38,7 +38,7 @@ namespace kroll
 
 	ArgList::ArgList(KValueRef a, KValueRef b, KValueRef c, KValueRef d)
 	{
-		this->args = new std::vector<KValueRef>;
+		this->args = new ArgVector;
 		this->args->push_back(a);
 		this->args->push_back(b);
 		this->args->push_back(c);
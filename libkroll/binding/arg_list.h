@@ -10,10 +10,58 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <new>
 #include "callback.h"
 
 namespace kroll
 {
+	/**
+	 * An STL allocator which keeps argument storage in the slab allocator,
+	 * since argument lists are built and thrown away for every call.
+	 */
+	template <class T>
+	class ArgListAllocator
+	{
+		public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		template <class U>
+		struct rebind { typedef ArgListAllocator<U> other; };
+
+		ArgListAllocator() {}
+		ArgListAllocator(const ArgListAllocator&) {}
+		template <class U>
+		ArgListAllocator(const ArgListAllocator<U>&) {}
+
+		pointer address(reference x) const { return &x; }
+		const_pointer address(const_reference x) const { return &x; }
+		size_type max_size() const { return size_t(-1) / sizeof(T); }
+		void construct(pointer p, const T& value) { new (p) T(value); }
+		void destroy(pointer p) { p->~T(); }
+
+		pointer allocate(size_type n, const void* hint = 0)
+		{
+			return static_cast<pointer>(SlabAllocator::Allocate(
+				n * sizeof(T), &SlabAllocator::argListStats));
+		}
+
+		void deallocate(pointer p, size_type n)
+		{
+			SlabAllocator::Free(p, n * sizeof(T), &SlabAllocator::argListStats);
+		}
+
+		bool operator==(const ArgListAllocator&) const { return true; }
+		bool operator!=(const ArgListAllocator&) const { return false; }
+	};
+
+	typedef std::vector<KValueRef, ArgListAllocator<KValueRef> > ArgVector;
+
 	/**
 	 * An argument list
 	 *
@@ -51,7 +99,7 @@ namespace kroll
 		KListRef GetList(size_t index, KListRef defaultValue=NULL) const;
 
 		private:
-		SharedPtr<std::vector<KValueRef> > args;
+		SharedPtr<ArgVector> args;
 
 		static inline bool VerifyArg(KValueRef arg, char t);
 		static std::string GenerateSignature(const char* name, std::string& argSpec);
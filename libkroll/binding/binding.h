@@ -35,6 +35,9 @@ namespace kroll
 #include "k_accessor_method.h"
 #include "scope_method_delegate.h"
 #include "bytes.h"
+#include "bytes_builder.h"
+#include "bytes_reader.h"
+#include "compression_stream.h"
 #include "void_ptr.h"
 #include "event.h"
 #include "read_event.h"
@@ -12,13 +12,47 @@
 
 namespace kroll
 {
-	Bytes::Bytes() : StaticBoundObject("Bytes")
+	BytesStorage::BytesStorage(char* buffer, long length) :
+		buffer(buffer),
+		length(length)
+	{
+	}
+
+	BytesStorage::~BytesStorage()
+	{
+		delete [] this->buffer;
+	}
+
+	PooledBytesStorage::PooledBytesStorage(long length) :
+		BytesStorage(BufferPool::Allocate(length + 1), length)
+	{
+		this->buffer[length] = '\0';
+	}
+
+	PooledBytesStorage::~PooledBytesStorage()
+	{
+		BufferPool::Free(this->buffer);
+		this->buffer = 0;
+	}
+
+	void PooledBytesStorage::Truncate(long length)
+	{
+		this->length = length;
+		this->buffer[length] = '\0';
+	}
+
+	Bytes::Bytes() :
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		CreateWithCopy(NULL, 0);
 	}
 
 	Bytes::Bytes(char* bufferIn, long length, bool makeCopy) :
-		StaticBoundObject("Bytes")
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		if (makeCopy)
 		{
@@ -31,41 +65,77 @@ namespace kroll
 	}
 
 	Bytes::Bytes(const char* bufferIn, long length, bool makeCopy) :
-		StaticBoundObject("Bytes")
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		CreateWithCopy(bufferIn, length);
 	}
 
-	Bytes::Bytes(std::string str) : StaticBoundObject("Bytes")
+	Bytes::Bytes(std::string str) :
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		CreateWithCopy(str.c_str(), str.length());
 	}
 
-	Bytes::Bytes(std::string& str) : StaticBoundObject("Bytes")
+	Bytes::Bytes(std::string& str) :
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		CreateWithCopy(str.c_str(), str.length());
 	}
 
-	Bytes::Bytes(Poco::Data::BLOB *bytes) : StaticBoundObject("Bytes")
+	Bytes::Bytes(Poco::Data::BLOB *bytes) :
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
-		CreateWithReference((char *)&(bytes->content()[0]), bytes->size());
+		// The BLOB owns its content, so this cannot adopt it.
+		CreateWithCopy(&(bytes->content()[0]), bytes->size());
 	}
 
-	Bytes::Bytes(long byte) : StaticBoundObject("Bytes")
+	Bytes::Bytes(long byte) :
+		StaticBoundObject("Bytes"),
+		bound(false),
+		terminated(0)
 	{
 		CreateWithCopy((char *) &byte, 1);
 	}
 
+	Bytes::Bytes(BytesStorageRef storage) :
+		StaticBoundObject("Bytes"),
+		storage(storage),
+		buffer(storage->Get()),
+		length(storage->Length()),
+		bound(false),
+		terminated(0)
+	{
+	}
+
+	Bytes::Bytes(BytesStorageRef storage, char* buffer, long length) :
+		StaticBoundObject("Bytes"),
+		storage(storage),
+		buffer(buffer),
+		length(length),
+		bound(false),
+		terminated(0)
+	{
+	}
+
 	void Bytes::CreateWithCopy(const char* bufferIn, long length)
 	{
 		if (length > 0)
 		{
-			// Store the buffer with a null terminator so
-			// that we can use it like a string later on.
-			char* bufferCopy = new char[length + 1];
-			memcpy(bufferCopy, bufferIn, length);
-			bufferCopy[length] = '\0';
-			this->CreateWithReference(bufferCopy, length);
+			// The pooled storage keeps a null terminator after the
+			// copy so that we can use it like a string later on.
+			PooledBytesStorage* copy = new PooledBytesStorage(length);
+			memcpy(copy->Get(), bufferIn, length);
+			this->storage = copy;
+			this->buffer = copy->Get();
+			this->length = length;
 		}
 		else
 		{
@@ -75,8 +145,48 @@ namespace kroll
 
 	void Bytes::CreateWithReference(char* buffer, long length)
 	{
+		if (buffer)
+			this->storage = new BytesStorage(buffer, length);
 		this->buffer = buffer;
 		this->length = length;
+	}
+
+	const char* Bytes::Get()
+	{
+		if (this->terminated)
+			return this->terminated;
+		if (!this->buffer)
+			return 0;
+
+		// A view which ends inside its storage is terminated if the byte
+		// after it happens to be a NULL.
+		char* storageEnd = this->storage->Get() + this->storage->Length();
+		if (this->buffer + this->length < storageEnd ?
+			this->buffer[this->length] == '\0' : this->storage->IsTerminated())
+			return this->buffer;
+
+		ScopedLock lock(&this->mutex);
+		if (!this->terminated)
+		{
+			PooledBytesStorage* copy = new PooledBytesStorage(this->length);
+			memcpy(copy->Get(), this->buffer, this->length);
+			this->terminatedStorage = copy;
+			this->terminated = copy->Get();
+		}
+		return this->terminated;
+	}
+
+	void Bytes::Bind()
+	{
+		if (this->bound)
+			return;
+
+		// Other threads block on the mutex in StaticBoundObject until the
+		// methods are in place, while this one may already use them.
+		ScopedLock lock(&this->mutex);
+		if (this->bound)
+			return;
+		this->bound = true;
 
 		/**
 		 * @tiapi(method=True,name=Bytes.toString,since=0.3)
@@ -89,7 +199,8 @@ namespace kroll
 		// friendly when using a Bytes in JavaScript.
 		/**
 		 * @tiapi(method=True,name=Bytes.indexOf,since=0.3)
-		 * @tiapi Return the index of a String within this Bytes
+		 * @tiapi Return the index of a String within this Bytes. The search
+		 * @tiapi covers the whole contents, including any NUL bytes.
 		 * @tiarg[String, needle] The String to search for
 		 * @tiresult[Number] The integer index of the String or -1 if not found
 		 */
@@ -152,19 +263,45 @@ namespace kroll
 		 */
 		this->SetMethod("substr", &Bytes::Substr);
 
+		/**
+		 * @tiapi(method=True,name=Bytes.slice,since=0.9)
+		 * @tiapi Return a Bytes which shares the contents of this one between
+		 * @tiapi a start index and an end index. Negative indexes count from
+		 * @tiapi the end. No data is copied.
+		 * @tiarg[Number, startIndex] The starting index
+		 * @tiarg[Number, endIndex, optional=True] The ending index
+		 * @tiresult[Bytes] A view of the bytes between startIndex and endIndex
+		 */
+		this->SetMethod("slice", &Bytes::Slice);
+
 		/**
 		 * @tiapi(method=True,name=Bytes.toLowerCase,since=0.3)
 		 * @tiapi Convert characters in the Bytes to lower case as if it were a string.
-		 * @tiresult[String] The resulting String
+		 * @tiarg[Boolean, inPlace, optional=True] Change this Bytes instead when no
+		 * @tiarg other Bytes shares its data, and return it.
+		 * @tiresult[String|Bytes] The resulting String, or a Bytes if inPlace is true
 		 */
 		this->SetMethod("toLowerCase", &Bytes::ToLowerCase);
 
 		/**
 		 * @tiapi(method=True,name=Bytes.toUpperCase,since=0.3)
 		 * @tiapi Convert characters in the Bytes to upper case as if it were a string.
-		 * @tiresult[String] The resulting String
+		 * @tiarg[Boolean, inPlace, optional=True] Change this Bytes instead when no
+		 * @tiarg other Bytes shares its data, and return it.
+		 * @tiresult[String|Bytes] The resulting String, or a Bytes if inPlace is true
 		 */
 		this->SetMethod("toUpperCase", &Bytes::ToUpperCase);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.replace,since=0.9)
+		 * @tiapi Replace every occurrence of a string in the Bytes
+		 * @tiarg[String|Bytes, search] The data to search for
+		 * @tiarg[String|Bytes, replacement] The data to replace it with
+		 * @tiarg[Boolean, inPlace, optional=True] Change this Bytes instead when no
+		 * @tiarg other Bytes shares its data, and return it.
+		 * @tiresult[Bytes] The resulting Bytes
+		 */
+		this->SetMethod("replace", &Bytes::Replace);
 		
 		/**
 		 * @tiapi(method=True,name=Bytes.concat,since=0.7)
@@ -172,7 +309,69 @@ namespace kroll
 		 * @tiresult[Bytes] The resulting Bytes
 		 */
 		this->SetMethod("concat", &Bytes::Concat);
-		
+
+		/**
+		 * @tiapi(method=True,name=Bytes.encodeBase64,since=0.9)
+		 * @tiapi Encode the contents of this Bytes as base64
+		 * @tiresult[String] The base64 text
+		 */
+		this->SetMethod("encodeBase64", &Bytes::EncodeBase64);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.decodeBase64,since=0.9)
+		 * @tiapi Decode the base64 text in this Bytes. Whitespace is ignored.
+		 * @tiresult[Bytes] The decoded data
+		 */
+		this->SetMethod("decodeBase64", &Bytes::DecodeBase64);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.encodeHex,since=0.9)
+		 * @tiapi Encode the contents of this Bytes as lower case hex
+		 * @tiresult[String] The hex text
+		 */
+		this->SetMethod("encodeHex", &Bytes::EncodeHex);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.decodeHex,since=0.9)
+		 * @tiapi Decode the hex digits in this Bytes
+		 * @tiresult[Bytes] The decoded data
+		 */
+		this->SetMethod("decodeHex", &Bytes::DecodeHex);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.isValidUTF8,since=0.9)
+		 * @tiapi Check whether the contents of this Bytes are valid UTF-8
+		 * @tiresult[Boolean] True if they are valid
+		 */
+		this->SetMethod("isValidUTF8", &Bytes::IsValidUTF8);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.transcode,since=0.9)
+		 * @tiapi Convert the contents of this Bytes between text encodings:
+		 * @tiapi 'utf-8', 'utf-16le' and 'latin1'
+		 * @tiarg[String, from] The encoding of this Bytes
+		 * @tiarg[String, to] The encoding of the result
+		 * @tiresult[Bytes] The converted text
+		 */
+		this->SetMethod("transcode", &Bytes::Transcode);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.deflate,since=0.9)
+		 * @tiapi Compress the contents of this Bytes
+		 * @tiarg[String, format, optional=True] 'zlib' (the default) or 'gzip'
+		 * @tiarg[Number, level, optional=True] 0 (none) to 9 (best)
+		 * @tiresult[Bytes] The compressed data
+		 */
+		this->SetMethod("deflate", &Bytes::Deflate);
+
+		/**
+		 * @tiapi(method=True,name=Bytes.inflate,since=0.9)
+		 * @tiapi Decompress the contents of this Bytes
+		 * @tiarg[String, format, optional=True] 'zlib' (the default) or 'gzip'
+		 * @tiresult[Bytes] The decompressed data
+		 */
+		this->SetMethod("inflate", &Bytes::Inflate);
+
 		/**
 		 * @tiapi(property=True,name=Bytes.length,since=0.3) The number of bytes in this bytes
 		 */
@@ -181,13 +380,36 @@ namespace kroll
 
 	Bytes::~Bytes()
 	{
-		if (this->buffer!=NULL)
-		{
-			delete [] this->buffer;
-		}
-		
-		this->buffer = NULL;
-		this->length = 0;
+	}
+
+	bool Bytes::HasProperty(const char* name)
+	{
+		this->Bind();
+		return StaticBoundObject::HasProperty(name);
+	}
+
+	KValueRef Bytes::Get(const char* name)
+	{
+		this->Bind();
+		return StaticBoundObject::Get(name);
+	}
+
+	SharedStringList Bytes::GetPropertyNames()
+	{
+		this->Bind();
+		return StaticBoundObject::GetPropertyNames();
+	}
+
+	void Bytes::Set(const char* name, KValueRef value)
+	{
+		this->Bind();
+		StaticBoundObject::Set(name, value);
+	}
+
+	void Bytes::Unset(const char* name)
+	{
+		this->Bind();
+		StaticBoundObject::Unset(name);
 	}
 
 	void Bytes::ToString(const ValueList& args, KValueRef result)
@@ -198,7 +420,8 @@ namespace kroll
 		}
 		else
 		{
-			result->SetString(buffer);
+			std::string contents(this->buffer, this->length);
+			result->SetString(contents);
 		}
 	}
 
@@ -218,7 +441,6 @@ namespace kroll
 		}
 		else
 		{
-			std::string target = this->buffer;
 			std::string needle = args.at(0)->ToString();
 			long start = 0;
 			if (args.size() > 1)
@@ -229,7 +451,14 @@ namespace kroll
 					start = 0;
 				}
 			}
-			result->SetInt(target.find(needle, start));
+
+			const char* found = 0;
+			if (start <= this->length)
+			{
+				found = ByteKernels::Find(this->buffer + start,
+					this->buffer + this->length, needle.data(), needle.size());
+			}
+			result->SetInt(found ? found - this->buffer : -1);
 		}
 	}
 
@@ -244,9 +473,8 @@ namespace kroll
 		}
 		else
 		{
-			std::string target = this->buffer;
 			std::string needle = args.at(0)->ToString();
-			long start = target.size() + 1;
+			long start = this->length;
 			if (args.size() > 1)
 			{
 				start = args.GetNumber(1);
@@ -255,7 +483,15 @@ namespace kroll
 					start = 0;
 				}
 			}
-			result->SetInt(target.rfind(needle, start));
+
+			// A match may begin at start at the latest.
+			long end = this->length;
+			if (start < this->length - (long) needle.size())
+				end = start + needle.size();
+
+			const char* found = ByteKernels::FindLast(this->buffer,
+				this->buffer + end, needle.data(), needle.size());
+			result->SetInt(found ? found - this->buffer : -1);
 		}
 	}
 
@@ -284,6 +520,60 @@ namespace kroll
 		}
 	}
 
+	/**
+	 * Walk the segments of a buffer in one pass, following the semantics
+	 * of String.split. The sink is called with each segment in turn.
+	 */
+	template <class Sink>
+	static void SplitBuffer(const char* buffer, long length,
+		const char* separator, long separatorLength, int limit, Sink& sink)
+	{
+		const char* end = buffer + length;
+		if (separatorLength == 0)
+		{
+			for (const char* c = buffer; c < end && limit-- > 0; c++)
+				sink(c, 1);
+			return;
+		}
+
+		const char* start = buffer;
+		while (limit-- > 0)
+		{
+			const char* next = ByteKernels::Find(start, end, separator, separatorLength);
+			if (!next)
+			{
+				sink(start, end - start);
+				return;
+			}
+
+			sink(start, next - start);
+			start = next + separatorLength;
+		}
+	}
+
+	struct StringSegmentSink
+	{
+		StringSegmentSink(KListRef list) : list(list) {}
+		void operator()(const char* start, long length)
+		{
+			list->Append(Value::NewString(std::string(start, length)));
+		}
+		KListRef list;
+	};
+
+	struct SliceSegmentSink
+	{
+		SliceSegmentSink(Bytes* bytes, std::vector<BytesRef>& segments) :
+			bytes(bytes),
+			segments(segments) {}
+		void operator()(const char* start, long length)
+		{
+			segments.push_back(bytes->Slice(start - bytes->GetBuffer(), length));
+		}
+		Bytes* bytes;
+		std::vector<BytesRef>& segments;
+	};
+
 	void Bytes::Split(const ValueList& args, KValueRef result)
 	{
 		// This method now follows the spec located at:
@@ -294,55 +584,63 @@ namespace kroll
 		KListRef list = new StaticBoundList();
 		result->SetList(list);
 
-		std::string target = "";
-		if (this->length > 0)
-		{
-			target = this->buffer;
-		}
-		else
-		{
-			list->Append(Value::NewString(target));
-			return;
-		}
-
-		if (args.size() <= 0)
+		if (this->length <= 0 || args.size() <= 0)
 		{
-			list->Append(Value::NewString(target));
+			list->Append(Value::NewString(std::string(this->buffer, this->length)));
 			return;
 		}
 
 		std::string separator = args.GetString(0);
-
 		int limit = args.GetInt(1, INT_MAX);
 
 		// We could use Poco's tokenizer here, but it doesn't split strings
 		// like "abc,def,," -> ['abc', 'def', '', ''] correctly. It produces
 		// ['abc', 'def', ''] which is a different behavior than the JS split.
-		// So we roll our own for now -- it's not very efficient right now, but
-		// it should be correct.
-		size_t next = target.find(separator);
-		while (target.size() > 0 && next != std::string::npos)
-		{
-			std::string token;
-			if (separator.size() == 0)
-			{
-				token = target.substr(0, 1);
-			}
-			else
-			{
-				token = target.substr(0, next);
-			}
-			target = target.substr(next + 1);
-			next = target.find(separator);
+		StringSegmentSink sink(list);
+		SplitBuffer(this->buffer, this->length, separator.data(),
+			separator.size(), limit, sink);
+	}
 
-			if ((int) list->Size() >= limit)
-				return;
+	void Bytes::Split(const char* separator, long separatorLength,
+		std::vector<BytesRef>& segments, int limit)
+	{
+		SliceSegmentSink sink(this, segments);
+		SplitBuffer(this->buffer, this->length, separator, separatorLength,
+			limit, sink);
+	}
 
-			list->Append(Value::NewString(token));
-		}
+	BytesRef Bytes::Slice(long start, long length)
+	{
+		if (start < 0)
+			start = 0;
+		if (start > this->length)
+			start = this->length;
+		if (length < 0)
+			length = 0;
+		if (length > this->length - start)
+			length = this->length - start;
+
+		if (length == 0)
+			return new Bytes();
+		return new Bytes(this->storage, this->buffer + start, length);
+	}
+
+	void Bytes::Slice(const ValueList& args, KValueRef result)
+	{
+		// https://developer.mozilla.org/en/Core_JavaScript_1.5_Reference/Global_Objects/String/slice
+		args.VerifyException("Bytes.slice", "i,?i");
 
-		if ((int) list->Size() < limit && separator.size() != 0)
-			list->Append(Value::NewString(target));
+		long start = args.GetInt(0);
+		long end = this->length;
+		if (args.size() > 1)
+			end = args.GetInt(1);
+
+		if (start < 0)
+			start += this->length;
+		if (end < 0)
+			end += this->length;
+
+		result->SetObject(this->Slice(start, end - start));
 	}
 
 	void Bytes::Substr(const ValueList& args, KValueRef result)
@@ -350,11 +648,6 @@ namespace kroll
 		// This method now follows the spec located at:
 		// https://developer.mozilla.org/en/Core_JavaScript_1.5_Reference/Global_Objects/String/substr
 		args.VerifyException("Bytes.substr", "i,?i");
-		std::string target = "";
-		if (this->length > 0)
-		{
-			target = this->buffer;
-		}
 
 		long start = args.GetInt(0);
 		if (start > 0 && start >= this->length)
@@ -384,7 +677,10 @@ namespace kroll
 			return;
 		}
 
-		std::string r = target.substr(start, length);
+		if (length > this->length - start)
+			length = this->length - start;
+
+		std::string r(this->buffer + start, length);
 		result->SetString(r);
 	}
 
@@ -393,53 +689,93 @@ namespace kroll
 		// This method now follows the spec located at:
 		// https://developer.mozilla.org/en/Core_JavaScript_1.5_Reference/Global_Objects/String/substring
 		args.VerifyException("Bytes.substring", "i,?i");
-		std::string target = "";
-		if (this->length > 0)
-		{
-			target = this->buffer;
-		}
 
 		long indexA = args.GetInt(0);
 		if (indexA < 0)
 			indexA = 0;
-		if (indexA > (long) target.size())
-			indexA = target.size();
+		if (indexA > this->length)
+			indexA = this->length;
 
-		if (args.size() < 2)
-		{
-			std::string r = target.substr(indexA);
-			result->SetString(r);
-		}
-		else
+		long indexB = this->length;
+		if (args.size() > 1)
 		{
-			long indexB = args.GetInt(1);
+			indexB = args.GetInt(1);
 			if (indexB < 0)
 				indexB = 0;
-			if (indexB > (long) target.size())
-				indexB = target.size();
+			if (indexB > this->length)
+				indexB = this->length;
+		}
 
-			if (indexA == indexB)
-			{
-				result->SetString("");
-				return;
-			}
-			if (indexA > indexB)
-			{
-				long temp = indexA;
-				indexA = indexB;
-				indexB = temp;
-			}
-			std::string r = target.substr(indexA, indexB - indexA);
-			result->SetString(r);
+		if (indexA > indexB)
+		{
+			long temp = indexA;
+			indexA = indexB;
+			indexB = temp;
+		}
+
+		std::string r(this->buffer + indexA, indexB - indexA);
+		result->SetString(r);
+	}
+
+	bool Bytes::IsUniquelyOwned()
+	{
+		// Counts which are private to another thread may be stale, so
+		// storage with private references is treated as shared.
+		if (this->storage.isNull())
+			return true;
+		return this->storage->IsWritable() &&
+			!this->storage->HasPrivateReferences() &&
+			this->storage->referenceCount() == 1;
+	}
+
+	void Bytes::SetContents(BytesStorageRef storage, char* buffer, long length)
+	{
+		this->storage = storage;
+		this->buffer = buffer;
+		this->length = length;
+		this->terminated = 0;
+		this->terminatedStorage = 0;
+		if (this->bound)
+			StaticBoundObject::Set("length", Value::NewInt(length));
+	}
+
+	BytesRef Bytes::ToLowerCase(bool inPlace)
+	{
+		if (inPlace && this->IsUniquelyOwned())
+		{
+			ByteKernels::ToLowerASCII(this->buffer, this->buffer + this->length, this->buffer);
+			return BytesRef(this, true);
+		}
+
+		BytesStorageRef output(new PooledBytesStorage(this->length));
+		ByteKernels::ToLowerASCII(this->buffer, this->buffer + this->length, output->Get());
+		return new Bytes(output);
+	}
+
+	BytesRef Bytes::ToUpperCase(bool inPlace)
+	{
+		if (inPlace && this->IsUniquelyOwned())
+		{
+			ByteKernels::ToUpperASCII(this->buffer, this->buffer + this->length, this->buffer);
+			return BytesRef(this, true);
 		}
+
+		BytesStorageRef output(new PooledBytesStorage(this->length));
+		ByteKernels::ToUpperASCII(this->buffer, this->buffer + this->length, output->Get());
+		return new Bytes(output);
 	}
 
 	void Bytes::ToLowerCase(const ValueList& args, KValueRef result)
 	{
-		if (this->length > 0)
+		args.VerifyException("Bytes.toLowerCase", "?b");
+		if (args.GetBool(0, false))
 		{
-			std::string target = this->buffer;
-			std::string r = Poco::toLower(target);
+			result->SetObject(this->ToLowerCase(true));
+		}
+		else if (this->length > 0)
+		{
+			std::string r(this->length, '\0');
+			ByteKernels::ToLowerASCII(this->buffer, this->buffer + this->length, &r[0]);
 			result->SetString(r);
 		}
 		else
@@ -450,10 +786,15 @@ namespace kroll
 
 	void Bytes::ToUpperCase(const ValueList& args, KValueRef result)
 	{
-		if (this->length > 0)
+		args.VerifyException("Bytes.toUpperCase", "?b");
+		if (args.GetBool(0, false))
+		{
+			result->SetObject(this->ToUpperCase(true));
+		}
+		else if (this->length > 0)
 		{
-			std::string target = this->buffer;
-			std::string r = Poco::toUpper(target);
+			std::string r(this->length, '\0');
+			ByteKernels::ToUpperASCII(this->buffer, this->buffer + this->length, &r[0]);
 			result->SetString(r);
 		}
 		else
@@ -461,11 +802,116 @@ namespace kroll
 			result->SetNull();
 		}
 	}
+
+	BytesRef Bytes::Replace(const char* search, long searchLength,
+		const char* replacement, long replacementLength, bool inPlace)
+	{
+		// Find every match first, so the result is allocated only once.
+		std::vector<const char*> matches;
+		const char* end = this->buffer + this->length;
+		if (searchLength > 0)
+		{
+			const char* match = this->buffer;
+			while ((match = ByteKernels::Find(match, end, search, searchLength)))
+			{
+				matches.push_back(match);
+				match += searchLength;
+			}
+		}
+
+		if (matches.empty())
+			return this->Slice(0, this->length);
+
+		// Writing in place must not clobber a replacement taken from this buffer.
+		std::string replacementCopy;
+		if (replacement < end && replacement + replacementLength > this->buffer)
+		{
+			replacementCopy.assign(replacement, replacementLength);
+			replacement = replacementCopy.data();
+		}
+
+		long newLength = this->length +
+			(long) matches.size() * (replacementLength - searchLength);
+		bool unique = inPlace && this->IsUniquelyOwned();
+
+		// Results which are no longer than the original are compacted
+		// within the buffer, moving each run between matches forward.
+		BytesStorageRef storage;
+		char* output = this->buffer;
+		if (!unique || newLength > this->length)
+		{
+			storage = new PooledBytesStorage(newLength);
+			output = storage->Get();
+		}
+		char* out = output;
+		const char* in = this->buffer;
+		for (size_t i = 0; i < matches.size(); i++)
+		{
+			long run = matches[i] - in;
+			memmove(out, in, run);
+			out += run;
+			memcpy(out, replacement, replacementLength);
+			out += replacementLength;
+			in = matches[i] + searchLength;
+		}
+		memmove(out, in, end - in);
+
+		if (output == this->buffer)
+		{
+			if (newLength < this->length)
+				output[newLength] = '\0';
+			this->SetContents(this->storage, output, newLength);
+			return BytesRef(this, true);
+		}
+
+		if (unique)
+		{
+			this->SetContents(storage, output, newLength);
+			return BytesRef(this, true);
+		}
+		return new Bytes(storage);
+	}
+
+	// Strings and Bytes are both accepted wherever scripts pass data.
+	static const char* GetData(const ValueList& args, size_t i,
+		std::string& string, long& length)
+	{
+		if (args.at(i)->IsObject())
+		{
+			BytesRef bytes(args.GetObject(i).cast<Bytes>());
+			if (!bytes.isNull())
+			{
+				length = bytes->Length();
+				return bytes->GetBuffer();
+			}
+		}
+
+		string = args.GetString(i);
+		length = string.length();
+		return string.data();
+	}
+
+	void Bytes::Replace(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("Bytes.replace", "s|o s|o ?b");
+
+		// The Bytes arguments stay alive in args until this returns.
+		std::string search, replacement;
+		long searchLength, replacementLength;
+		const char* searchData = GetData(args, 0, search, searchLength);
+		const char* replacementData = GetData(args, 1, replacement, replacementLength);
+		result->SetObject(this->Replace(searchData, searchLength,
+			replacementData, replacementLength, args.GetBool(2, false)));
+	}
 	
 	BytesRef Bytes::Concat(std::vector<BytesRef>& bytes)
 	{
+		// The result shares the buffer when there is only one part to it.
+		// It is a slice, so that changing it in place copies the buffer.
 		if (bytes.size() == 0)
-			return BytesRef(this, true);
+			return this->Slice(0, this->length);
+		if (this->length == 0 && bytes.size() == 1)
+			return bytes[0]->Slice(0, bytes[0]->Length());
 
 		long size = this->Length();
 		for (size_t i = 0; i < bytes.size(); i++)
@@ -473,11 +919,9 @@ namespace kroll
 			size += bytes.at(i)->Length();
 		}
 
-		char* buffer = new char[size+1];
-		buffer[size] = '\0';
-
-		char* current = buffer;
-		memcpy(current, this->Get(), this->Length());
+		BytesStorageRef storage(new PooledBytesStorage(size));
+		char* current = storage->Get();
+		memcpy(current, this->GetBuffer(), this->Length());
 		current += this->Length();
 		
 		for (size_t i = 0; i < bytes.size(); i++)
@@ -485,12 +929,12 @@ namespace kroll
 			BytesRef bytesObject(bytes.at(i));
 			if (bytesObject->Length() > 0)
 			{
-				memcpy(current, bytesObject->Get(), bytesObject->Length());
+				memcpy(current, bytesObject->GetBuffer(), bytesObject->Length());
 				current += bytesObject->Length();
 			}
 		}
 
-		return new Bytes(buffer, size, false);
+		return new Bytes(storage);
 	}
 
 	void Bytes::Concat(const ValueList& args, KValueRef result)
@@ -501,7 +945,7 @@ namespace kroll
 			if (args.at(i)->IsObject())
 			{
 				BytesRef bytesObject(args.GetObject(i).cast<Bytes>());
-				if (!bytesObject.isNull());
+				if (!bytesObject.isNull())
 				{
 					bytes.push_back(bytesObject);
 				}
@@ -516,6 +960,175 @@ namespace kroll
 		result->SetObject(newBytes);
 	}
 
+	/**
+	 * Wrap the output of an encoder in a Bytes. Output buffers are sized
+	 * for the worst case, so one which ended up mostly empty is copied.
+	 */
+	static BytesRef AdoptOutput(PooledBytesStorageRef output, long length)
+	{
+		if (length < output->Length() / 2)
+			return new Bytes(const_cast<const char*>(output->Get()), length);
+
+		output->Truncate(length);
+		return new Bytes(BytesStorageRef(output.get(), true));
+	}
+
+	BytesRef Bytes::EncodeBase64()
+	{
+		long capacity = ByteKernels::Base64EncodedLength(this->length);
+		PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+		ByteKernels::Base64Encode(this->buffer, this->buffer + this->length, output->Get());
+		return AdoptOutput(output, capacity);
+	}
+
+	BytesRef Bytes::DecodeBase64()
+	{
+		long capacity = ByteKernels::Base64DecodedLength(this->length);
+		PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+		long decoded = ByteKernels::Base64Decode(this->buffer,
+			this->buffer + this->length, output->Get());
+		if (decoded < 0)
+			throw ValueException::FromString("Invalid base64 data");
+		return AdoptOutput(output, decoded);
+	}
+
+	BytesRef Bytes::EncodeHex()
+	{
+		long capacity = this->length * 2;
+		PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+		ByteKernels::HexEncode(this->buffer, this->buffer + this->length, output->Get());
+		return AdoptOutput(output, capacity);
+	}
+
+	BytesRef Bytes::DecodeHex()
+	{
+		long capacity = this->length / 2;
+		PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+		long decoded = ByteKernels::HexDecode(this->buffer,
+			this->buffer + this->length, output->Get());
+		if (decoded < 0)
+			throw ValueException::FromString("Invalid hex data");
+		return AdoptOutput(output, decoded);
+	}
+
+	bool Bytes::IsValidUTF8()
+	{
+		return !ByteKernels::FindInvalidUTF8(this->buffer, this->buffer + this->length);
+	}
+
+	enum TextEncoding { UTF8_ENCODING, UTF16LE_ENCODING, LATIN1_ENCODING };
+
+	static TextEncoding GetTextEncoding(const std::string& name)
+	{
+		std::string lowerName(Poco::toLower(name));
+		if (lowerName == "utf-8" || lowerName == "utf8")
+			return UTF8_ENCODING;
+		else if (lowerName == "utf-16le")
+			return UTF16LE_ENCODING;
+		else if (lowerName == "latin1" || lowerName == "iso-8859-1")
+			return LATIN1_ENCODING;
+		else
+			throw ValueException::FromFormat("Unsupported encoding: %s", name.c_str());
+	}
+
+	BytesRef Bytes::Transcode(const std::string& from, const std::string& to)
+	{
+		TextEncoding fromEncoding = GetTextEncoding(from);
+		TextEncoding toEncoding = GetTextEncoding(to);
+
+		// Everything goes through UTF-8.
+		BytesRef utf8;
+		if (fromEncoding == UTF8_ENCODING)
+		{
+			if (!this->IsValidUTF8())
+				throw ValueException::FromString("Invalid UTF-8 data");
+			utf8 = this->Slice(0, this->length);
+		}
+		else
+		{
+			long capacity = fromEncoding == LATIN1_ENCODING ?
+				this->length * 2 : this->length / 2 * 3;
+			PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+			const char* end = this->buffer + this->length;
+			long converted = fromEncoding == LATIN1_ENCODING ?
+				ByteKernels::Latin1ToUTF8(this->buffer, end, output->Get()) :
+				ByteKernels::UTF16LEToUTF8(this->buffer, end, output->Get());
+			if (converted < 0)
+				throw ValueException::FromFormat("Invalid %s data", from.c_str());
+			utf8 = AdoptOutput(output, converted);
+		}
+
+		if (toEncoding == UTF8_ENCODING)
+			return utf8;
+
+		long capacity = toEncoding == LATIN1_ENCODING ?
+			utf8->length : utf8->length * 2;
+		PooledBytesStorageRef output(new PooledBytesStorage(capacity));
+		const char* end = utf8->buffer + utf8->length;
+		long converted = toEncoding == LATIN1_ENCODING ?
+			ByteKernels::UTF8ToLatin1(utf8->buffer, end, output->Get()) :
+			ByteKernels::UTF8ToUTF16LE(utf8->buffer, end, output->Get());
+		if (converted < 0)
+		{
+			throw ValueException::FromFormat("Cannot represent this text in %s",
+				to.c_str());
+		}
+		return AdoptOutput(output, converted);
+	}
+
+	void Bytes::EncodeBase64(const ValueList& args, KValueRef result)
+	{
+		std::string encoded(ByteKernels::Base64EncodedLength(this->length), '\0');
+		if (!encoded.empty())
+			ByteKernels::Base64Encode(this->buffer, this->buffer + this->length, &encoded[0]);
+		result->SetString(encoded);
+	}
+
+	void Bytes::DecodeBase64(const ValueList& args, KValueRef result)
+	{
+		result->SetObject(this->DecodeBase64());
+	}
+
+	void Bytes::EncodeHex(const ValueList& args, KValueRef result)
+	{
+		std::string encoded(this->length * 2, '\0');
+		if (!encoded.empty())
+			ByteKernels::HexEncode(this->buffer, this->buffer + this->length, &encoded[0]);
+		result->SetString(encoded);
+	}
+
+	void Bytes::DecodeHex(const ValueList& args, KValueRef result)
+	{
+		result->SetObject(this->DecodeHex());
+	}
+
+	void Bytes::IsValidUTF8(const ValueList& args, KValueRef result)
+	{
+		result->SetBool(this->IsValidUTF8());
+	}
+
+	void Bytes::Transcode(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("Bytes.transcode", "s s");
+		result->SetObject(this->Transcode(args.GetString(0), args.GetString(1)));
+	}
+
+	void Bytes::Deflate(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("Bytes.deflate", "?s n");
+		result->SetObject(CompressionStream::Process(CompressionStream::DEFLATE,
+			CompressionStream::GetFormat(args.GetString(0, "zlib")),
+			this->buffer, this->length, (int) args.GetNumber(1, -1)));
+	}
+
+	void Bytes::Inflate(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("Bytes.inflate", "?s");
+		result->SetObject(CompressionStream::Process(CompressionStream::INFLATE,
+			CompressionStream::GetFormat(args.GetString(0, "zlib")),
+			this->buffer, this->length));
+	}
+
 	/*static*/
 	BytesRef Bytes::GlobBytes(std::vector<BytesRef>& bytes)
 	{
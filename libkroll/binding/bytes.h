@@ -12,16 +12,88 @@
 #include <string>
 #include <map>
 #include <cstring>
+#include <climits>
 #include <Poco/Data/BLOB.h>
 
 namespace kroll
 {
+	class BytesStorage;
+	typedef AutoPtr<BytesStorage> BytesStorageRef;
+
+	/**
+	 * The buffer behind one or more Bytes. Slices of a Bytes share its
+	 * storage instead of copying it, so the storage lives until the last
+	 * of them is destroyed.
+	 */
+	class KROLL_API BytesStorage : public ReferenceCounted
+	{
+	public:
+		/**
+		 * Take ownership of a buffer allocated with new[]. Subclasses which
+		 * wrap memory owned elsewhere release it and clear buffer in their
+		 * destructor.
+		 */
+		BytesStorage(char* buffer, long length);
+		virtual ~BytesStorage();
+
+		char* Get() { return buffer; }
+		long Length() { return length; }
+
+		/**
+		 * @return false if the buffer must never be written to, for
+		 * instance because it is a read-only file mapping
+		 */
+		virtual bool IsWritable() { return true; }
+
+		/**
+		 * @return whether a NULL follows the last byte of the buffer,
+		 * as it does for buffers adopted by Bytes
+		 */
+		virtual bool IsTerminated() { return true; }
+
+	protected:
+		char* buffer;
+		long length;
+
+	private:
+		DISALLOW_EVIL_CONSTRUCTORS(BytesStorage);
+	};
+
+	/**
+	 * Storage whose buffer comes from the BufferPool, so that streams of
+	 * similarly sized chunks reuse the same few buffers. The buffer has
+	 * room for length bytes and a NULL terminator.
+	 */
+	class KROLL_API PooledBytesStorage : public BytesStorage
+	{
+	public:
+		PooledBytesStorage(long length);
+		virtual ~PooledBytesStorage();
+
+		/**
+		 * Shorten the contents after writing less than was allocated
+		 * for, and NULL terminate them again.
+		 */
+		void Truncate(long length);
+
+	private:
+		DISALLOW_EVIL_CONSTRUCTORS(PooledBytesStorage);
+	};
+	typedef AutoPtr<PooledBytesStorage> PooledBytesStorageRef;
+
 	/**
 	 * An object that represents an arbitrary amount of binary data§
 	 */
 	class KROLL_API Bytes : public StaticBoundObject
 	{
 	public:
+		enum AccessPattern
+		{
+			NORMAL_ACCESS,
+			SEQUENTIAL_ACCESS,
+			RANDOM_ACCESS
+		};
+
 		/**
 		 * If makeCopy is false: create a Bytes from a heap-allocated
 		 * pointer. The bytes will keep the pointer to this string,
@@ -35,17 +107,124 @@ namespace kroll
 		Bytes(std::string&);
 		Bytes(Poco::Data::BLOB* bytes);
 		Bytes(long byte);
+
+		/**
+		 * Create a Bytes which views the whole of a storage. Subclasses
+		 * of BytesStorage can wrap memory owned by something else, such
+		 * as a file mapping or a script engine's string.
+		 */
+		Bytes(BytesStorageRef storage);
 		virtual ~Bytes();
 
 		BytesRef Concat(std::vector<BytesRef>& bytes);
-		const char* Get() { return buffer; }
+
+		/**
+		 * @return the contents of this Bytes, NULL terminated. A Bytes
+		 * which views part of a buffer, or memory it cannot terminate,
+		 * makes a terminated copy the first time it is asked. The pointer
+		 * is valid until this Bytes is changed or destroyed.
+		 */
+		const char* Get();
+
+		/**
+		 * @return the contents of this Bytes where they are, which need
+		 * not be NULL terminated. Never copies, so use it with Length()
+		 * wherever a terminator is not needed.
+		 */
+		const char* GetBuffer() { return buffer; }
 		const long Length() { return length; }
 
+		/**
+		 * @return a view of part of this Bytes which shares its buffer.
+		 * The range is clamped to the contents.
+		 */
+		BytesRef Slice(long start, long length);
+
+		/**
+		 * Split this Bytes into views of the segments between occurrences
+		 * of a separator, in the same way as the split script method.
+		 */
+		void Split(const char* separator, long separatorLength,
+			std::vector<BytesRef>& segments, int limit=INT_MAX);
+
 		static BytesRef GlobBytes(std::vector<BytesRef>& bytes);
 
+		/**
+		 * Case conversion only changes ASCII letters. Both this and
+		 * Replace return a new Bytes, unless inPlace is true and no other
+		 * Bytes shares this buffer. Then this Bytes is changed and
+		 * returned, which anything else holding it will also see.
+		 *
+		 * So that this never changes the source of a result, operations
+		 * which would hand back contents unchanged, such as a Replace
+		 * which matches nothing, return a slice of them instead of the
+		 * same Bytes, and BytesBuilder and BytesReader keep slices of
+		 * what they are given. A slice shares the buffer, so it is not
+		 * changed in place while its source lives.
+		 */
+		BytesRef ToLowerCase(bool inPlace=false);
+		BytesRef ToUpperCase(bool inPlace=false);
+
+		/**
+		 * Replace every occurrence of search. An empty search matches
+		 * nothing.
+		 */
+		BytesRef Replace(const char* search, long searchLength,
+			const char* replacement, long replacementLength, bool inPlace=false);
+
+		/**
+		 * Encode or decode the contents of this Bytes. The decoders throw
+		 * a ValueException when the contents are not valid input.
+		 */
+		BytesRef EncodeBase64();
+		BytesRef DecodeBase64();
+		BytesRef EncodeHex();
+		BytesRef DecodeHex();
+
+		bool IsValidUTF8();
+
+		/**
+		 * Convert the contents from one text encoding to another. The
+		 * encodings are "utf-8", "utf-16le" and "latin1" (or "iso-8859-1").
+		 * Input which is invalid in the source encoding, or which the
+		 * target cannot represent, is a ValueException.
+		 */
+		BytesRef Transcode(const std::string& from, const std::string& to);
+
+		/**
+		 * Map part of a file into memory read-only instead of reading it.
+		 * Pages are only read in as they are touched, and the mapping
+		 * lives as long as this Bytes or any slice of it.
+		 * @param offset where in the file to start, which may lie beyond
+		 * what a long can hold
+		 * @param length the number of bytes to map, or -1 for the rest.
+		 * A mapping longer than a Bytes can hold is refused, so larger
+		 * files have to be mapped in parts.
+		 * @param pattern a hint for the OS about how pages will be read
+		 */
+		static BytesRef MapFile(const std::string& path, Poco::Int64 offset=0,
+			Poco::Int64 length=-1, AccessPattern pattern=NORMAL_ACCESS);
+
+		// Script methods are only bound once a script looks at this
+		// object, so Bytes used natively (slices in particular) stay cheap.
+		virtual bool HasProperty(const char* name);
+		virtual KValueRef Get(const char* name);
+		virtual SharedStringList GetPropertyNames();
+		virtual void Set(const char* name, KValueRef value);
+		virtual void Unset(const char* name);
+
 	private:
+		BytesStorageRef storage;
 		char* buffer;
 		long length;
+		volatile bool bound;
+		BytesStorageRef terminatedStorage;
+		char* volatile terminated;
+
+		Bytes(BytesStorageRef storage, char* buffer, long length);
+		void Bind();
+		bool IsUniquelyOwned();
+		void SetContents(BytesStorageRef storage, char* buffer, long length);
 
 		void ToString(const ValueList& args, KValueRef result);
 		void Get(const ValueList& args, KValueRef result);
@@ -58,10 +237,19 @@ namespace kroll
 		void Split(const ValueList& args, KValueRef result);
 		void Substr(const ValueList& args, KValueRef result);
 		void Substring(const ValueList& args, KValueRef result);
+		void Slice(const ValueList& args, KValueRef result);
 		void ToLowerCase(const ValueList& args, KValueRef result);
 		void ToUpperCase(const ValueList& args, KValueRef result);
 		void Replace(const ValueList& args, KValueRef result);
 		void Concat(const ValueList& args, KValueRef result);
+		void EncodeBase64(const ValueList& args, KValueRef result);
+		void DecodeBase64(const ValueList& args, KValueRef result);
+		void EncodeHex(const ValueList& args, KValueRef result);
+		void DecodeHex(const ValueList& args, KValueRef result);
+		void IsValidUTF8(const ValueList& args, KValueRef result);
+		void Transcode(const ValueList& args, KValueRef result);
+		void Deflate(const ValueList& args, KValueRef result);
+		void Inflate(const ValueList& args, KValueRef result);
 
 		void CreateWithCopy(const char* buffer, long len);
 		void CreateWithReference(char* buffer, long len);
@@ -0,0 +1,231 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#include "bytes_builder.h"
+#include <cstring>
+
+// Appends smaller than this are copied into a shared chunk rather than
+// kept as a chunk of their own.
+#define PACKED_APPEND_LIMIT 512
+
+namespace kroll
+{
+	BytesBuilder::BytesBuilder() :
+		StaticBoundObject("BytesBuilder"),
+		length(0)
+	{
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.append,since=0.9)
+		 * @tiapi Append Bytes, Strings, other BytesBuilders or lists of them.
+		 * @tiapi Bytes are kept by reference rather than copied.
+		 */
+		this->SetMethod("append", &BytesBuilder::Append);
+
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.getLength,since=0.9)
+		 * @tiresult[Number] The number of bytes appended so far
+		 */
+		this->SetMethod("getLength", &BytesBuilder::GetLength);
+
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.getChunks,since=0.9)
+		 * @tiapi Get the contents as the list of chunks they are stored in,
+		 * @tiapi without flattening them.
+		 * @tiresult[Array<Bytes>] The chunks in order
+		 */
+		this->SetMethod("getChunks", &BytesBuilder::GetChunks);
+
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.toBytes,since=0.9)
+		 * @tiapi Flatten the contents into a single Bytes.
+		 * @tiresult[Bytes] The contents
+		 */
+		this->SetMethod("toBytes", &BytesBuilder::ToBytes);
+
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.toString,since=0.9)
+		 * @tiresult[String] The contents as a String
+		 */
+		this->SetMethod("toString", &BytesBuilder::ToString);
+
+		/**
+		 * @tiapi(method=True,name=BytesBuilder.clear,since=0.9)
+		 * @tiapi Drop the contents.
+		 */
+		this->SetMethod("clear", &BytesBuilder::Clear);
+	}
+
+	BytesBuilder::~BytesBuilder()
+	{
+	}
+
+	void BytesBuilder::SealPending()
+	{
+		if (this->pending.empty())
+			return;
+
+		this->chunks.push_back(new Bytes(this->pending));
+		this->pending.clear();
+	}
+
+	void BytesBuilder::Append(BytesRef bytes)
+	{
+		if (bytes.isNull() || bytes->Length() <= 0)
+			return;
+
+		ScopedLock lock(&this->mutex);
+		if (bytes->Length() < PACKED_APPEND_LIMIT)
+		{
+			this->pending.append(bytes->GetBuffer(), bytes->Length());
+		}
+		else
+		{
+			// Keep a slice, so that the appended Bytes is not changed in
+			// place while the builder shares its buffer.
+			this->SealPending();
+			this->chunks.push_back(bytes->Slice(0, bytes->Length()));
+		}
+		this->length += bytes->Length();
+	}
+
+	void BytesBuilder::Append(const char* data, long length)
+	{
+		if (length <= 0)
+			return;
+
+		ScopedLock lock(&this->mutex);
+		if (length < PACKED_APPEND_LIMIT)
+		{
+			this->pending.append(data, length);
+		}
+		else
+		{
+			this->SealPending();
+			this->chunks.push_back(new Bytes(data, length));
+		}
+		this->length += length;
+	}
+
+	long BytesBuilder::Length()
+	{
+		ScopedLock lock(&this->mutex);
+		return this->length;
+	}
+
+	void BytesBuilder::Clear()
+	{
+		ScopedLock lock(&this->mutex);
+		this->chunks.clear();
+		this->pending.clear();
+		this->length = 0;
+	}
+
+	void BytesBuilder::GetChunks(std::vector<BytesRef>& chunks)
+	{
+		// The chunks are handed out as slices, so that changing one in
+		// place does not change the contents of the builder.
+		ScopedLock lock(&this->mutex);
+		this->SealPending();
+		for (size_t i = 0; i < this->chunks.size(); i++)
+			chunks.push_back(this->chunks[i]->Slice(0, this->chunks[i]->Length()));
+	}
+
+	BytesRef BytesBuilder::Flatten()
+	{
+		ScopedLock lock(&this->mutex);
+		this->SealPending();
+		if (this->chunks.empty())
+			return new Bytes();
+		if (this->chunks.size() == 1)
+			return this->chunks[0]->Slice(0, this->length);
+
+		// Pooled storage keeps the buffer NULL terminated like the other
+		// Bytes which own their whole buffer.
+		BytesStorageRef storage(new PooledBytesStorage(this->length));
+		char* current = storage->Get();
+		for (size_t i = 0; i < this->chunks.size(); i++)
+		{
+			memcpy(current, this->chunks[i]->GetBuffer(), this->chunks[i]->Length());
+			current += this->chunks[i]->Length();
+		}
+
+		BytesRef flattened(new Bytes(storage));
+		this->chunks.clear();
+		this->chunks.push_back(flattened);
+		return flattened->Slice(0, this->length);
+	}
+
+	void BytesBuilder::AppendValue(KValueRef value)
+	{
+		if (value->IsString())
+		{
+			const char* string = value->ToString();
+			this->Append(string, strlen(string));
+		}
+		else if (value->IsObject())
+		{
+			KObjectRef object(value->ToObject());
+			BytesBuilderRef builder(object.cast<BytesBuilder>());
+			if (!builder.isNull() && builder.get() != this)
+			{
+				std::vector<BytesRef> chunks;
+				builder->GetChunks(chunks);
+				for (size_t i = 0; i < chunks.size(); i++)
+					this->Append(chunks[i]);
+			}
+			else
+			{
+				this->Append(object.cast<Bytes>());
+			}
+		}
+		else if (value->IsList())
+		{
+			KListRef list(value->ToList());
+			for (size_t i = 0; i < list->Size(); i++)
+				this->AppendValue(list->At(i));
+		}
+	}
+
+	void BytesBuilder::Append(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("BytesBuilder.append", "s|o|l");
+		for (size_t i = 0; i < args.size(); i++)
+			this->AppendValue(args.at(i));
+	}
+
+	void BytesBuilder::GetLength(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->Length());
+	}
+
+	void BytesBuilder::GetChunks(const ValueList& args, KValueRef result)
+	{
+		std::vector<BytesRef> chunks;
+		this->GetChunks(chunks);
+
+		KListRef list(new StaticBoundList());
+		for (size_t i = 0; i < chunks.size(); i++)
+			list->Append(Value::NewObject(chunks[i]));
+		result->SetList(list);
+	}
+
+	void BytesBuilder::ToBytes(const ValueList& args, KValueRef result)
+	{
+		result->SetObject(this->Flatten());
+	}
+
+	void BytesBuilder::ToString(const ValueList& args, KValueRef result)
+	{
+		BytesRef bytes(this->Flatten());
+		std::string contents(bytes->GetBuffer(), bytes->Length());
+		result->SetString(contents);
+	}
+
+	void BytesBuilder::Clear(const ValueList& args, KValueRef result)
+	{
+		this->Clear();
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#ifndef _KR_BYTES_BUILDER_H_
+#define _KR_BYTES_BUILDER_H_
+
+#include "../kroll.h"
+#include <vector>
+#include <string>
+
+namespace kroll
+{
+	class BytesBuilder;
+	typedef AutoPtr<BytesBuilder> BytesBuilderRef;
+
+	/**
+	 * Accumulates binary data without copying it over and over. Appended
+	 * Bytes are kept by reference as chunks and only flattened into one
+	 * contiguous Bytes on demand, so building up a stream piece by piece
+	 * stays linear. Small appends are packed together into shared chunks.
+	 */
+	class KROLL_API BytesBuilder : public StaticBoundObject
+	{
+	public:
+		BytesBuilder();
+		virtual ~BytesBuilder();
+
+		void Append(BytesRef bytes);
+		void Append(const char* data, long length);
+		long Length();
+		void Clear();
+
+		/**
+		 * Get the chunks which make up the contents, in order. Writers can
+		 * consume these directly instead of flattening first.
+		 */
+		void GetChunks(std::vector<BytesRef>& chunks);
+
+		/**
+		 * @return the contents as a single Bytes. The result replaces the
+		 * chunks, so flattening again without appending is free.
+		 */
+		BytesRef Flatten();
+
+	private:
+		std::vector<BytesRef> chunks;
+		std::string pending;
+		long length;
+
+		void SealPending();
+
+		void Append(const ValueList& args, KValueRef result);
+		void GetLength(const ValueList& args, KValueRef result);
+		void GetChunks(const ValueList& args, KValueRef result);
+		void ToBytes(const ValueList& args, KValueRef result);
+		void ToString(const ValueList& args, KValueRef result);
+		void Clear(const ValueList& args, KValueRef result);
+		void AppendValue(KValueRef value);
+
+		DISALLOW_EVIL_CONSTRUCTORS(BytesBuilder);
+	};
+}
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#include "bytes_reader.h"
+#include <cstring>
+#include <algorithm>
+
+namespace kroll
+{
+	BytesReader::BytesReader(BytesRef bytes) :
+		StaticBoundObject("BytesReader"),
+		bytes(bytes.isNull() ? BytesRef(new Bytes()) : bytes->Slice(0, bytes->Length())),
+		position(0)
+	{
+		/**
+		 * @tiapi(method=True,name=BytesReader.hasMore,since=0.9)
+		 * @tiresult[Boolean] True if there is anything left to read
+		 */
+		this->SetMethod("hasMore", &BytesReader::HasMore);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.getPosition,since=0.9)
+		 * @tiresult[Number] The offset of the cursor
+		 */
+		this->SetMethod("getPosition", &BytesReader::GetPosition);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.remaining,since=0.9)
+		 * @tiresult[Number] The number of bytes left to read
+		 */
+		this->SetMethod("remaining", &BytesReader::Remaining);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.seek,since=0.9)
+		 * @tiapi Move the cursor to an offset.
+		 * @tiarg[Number, position] The new offset
+		 */
+		this->SetMethod("seek", &BytesReader::Seek);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.skip,since=0.9)
+		 * @tiapi Move the cursor forward.
+		 * @tiarg[Number, count] The number of bytes to skip
+		 */
+		this->SetMethod("skip", &BytesReader::Skip);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.readLine,since=0.9)
+		 * @tiapi Read up to the next line ending, which may be "\n" or "\r\n".
+		 * @tiresult[Bytes] The line without its ending, or null at the end
+		 */
+		this->SetMethod("readLine", &BytesReader::ReadLine);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.readUntil,since=0.9)
+		 * @tiapi Read up to the next delimiter and skip past it.
+		 * @tiarg[String|Bytes, delimiter] The delimiter
+		 * @tiresult[Bytes] The data before the delimiter, or null at the end
+		 */
+		this->SetMethod("readUntil", &BytesReader::ReadUntil);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.read,since=0.9)
+		 * @tiarg[Number, count] The most bytes to read
+		 * @tiresult[Bytes] The bytes read, or null at the end
+		 */
+		this->SetMethod("read", &BytesReader::Read);
+
+		/**
+		 * @tiapi(method=True,name=BytesReader.readInt8,since=0.9)
+		 * @tiapi Read a number. There are signed and unsigned versions of
+		 * @tiapi readInt8, readInt16, readInt32 and float versions of
+		 * @tiapi readFloat and readDouble, the multi-byte ones with LE
+		 * @tiapi (little endian) and BE (big endian) suffixes.
+		 * @tiresult[Number] The number
+		 */
+		this->SetMethod("readInt8", &BytesReader::ReadInt8);
+		this->SetMethod("readUInt8", &BytesReader::ReadUInt8);
+		this->SetMethod("readInt16LE", &BytesReader::ReadInt16LE);
+		this->SetMethod("readInt16BE", &BytesReader::ReadInt16BE);
+		this->SetMethod("readUInt16LE", &BytesReader::ReadUInt16LE);
+		this->SetMethod("readUInt16BE", &BytesReader::ReadUInt16BE);
+		this->SetMethod("readInt32LE", &BytesReader::ReadInt32LE);
+		this->SetMethod("readInt32BE", &BytesReader::ReadInt32BE);
+		this->SetMethod("readUInt32LE", &BytesReader::ReadUInt32LE);
+		this->SetMethod("readUInt32BE", &BytesReader::ReadUInt32BE);
+		this->SetMethod("readFloatLE", &BytesReader::ReadFloatLE);
+		this->SetMethod("readFloatBE", &BytesReader::ReadFloatBE);
+		this->SetMethod("readDoubleLE", &BytesReader::ReadDoubleLE);
+		this->SetMethod("readDoubleBE", &BytesReader::ReadDoubleBE);
+	}
+
+	BytesReader::~BytesReader()
+	{
+	}
+
+	bool BytesReader::HasMore()
+	{
+		ScopedLock lock(&this->mutex);
+		return this->position < this->bytes->Length();
+	}
+
+	long BytesReader::GetPosition()
+	{
+		ScopedLock lock(&this->mutex);
+		return this->position;
+	}
+
+	long BytesReader::Remaining()
+	{
+		ScopedLock lock(&this->mutex);
+		return this->bytes->Length() - this->position;
+	}
+
+	void BytesReader::Seek(long position)
+	{
+		ScopedLock lock(&this->mutex);
+		this->position = std::max(0L, std::min(position, this->bytes->Length()));
+	}
+
+	void BytesReader::Skip(long count)
+	{
+		ScopedLock lock(&this->mutex);
+		this->position = std::max(0L, std::min(this->position + count,
+			this->bytes->Length()));
+	}
+
+	BytesRef BytesReader::ReadLine()
+	{
+		ScopedLock lock(&this->mutex);
+		long length = this->bytes->Length();
+		if (this->position >= length)
+			return 0;
+
+		const char* start = this->bytes->GetBuffer() + this->position;
+		const char* newline = static_cast<const char*>(
+			memchr(start, '\n', length - this->position));
+
+		long lineLength = newline ? newline - start : length - this->position;
+		this->position += newline ? lineLength + 1 : lineLength;
+		if (newline && lineLength > 0 && start[lineLength - 1] == '\r')
+			lineLength--;
+		return this->bytes->Slice(start - this->bytes->GetBuffer(), lineLength);
+	}
+
+	BytesRef BytesReader::ReadUntil(const char* delimiter, long delimiterLength)
+	{
+		ScopedLock lock(&this->mutex);
+		long length = this->bytes->Length();
+		if (this->position >= length)
+			return 0;
+
+		const char* start = this->bytes->GetBuffer() + this->position;
+		const char* end = this->bytes->GetBuffer() + length;
+		const char* match = delimiterLength > 0 ?
+			ByteKernels::Find(start, end, delimiter, delimiterLength) : 0;
+
+		long segmentLength = match ? match - start : end - start;
+		BytesRef segment(this->bytes->Slice(this->position, segmentLength));
+		this->position += match ? segmentLength + delimiterLength : segmentLength;
+		return segment;
+	}
+
+	BytesRef BytesReader::Read(long count)
+	{
+		ScopedLock lock(&this->mutex);
+		long length = this->bytes->Length();
+		if (this->position >= length)
+			return 0;
+
+		count = std::max(0L, std::min(count, length - this->position));
+		BytesRef result(this->bytes->Slice(this->position, count));
+		this->position += count;
+		return result;
+	}
+
+	Poco::UInt64 BytesReader::ReadUnsigned(int size, bool littleEndian)
+	{
+		ScopedLock lock(&this->mutex);
+		if (this->bytes->Length() - this->position < size)
+		{
+			throw ValueException::FromFormat("Cannot read %i bytes at offset %li",
+				size, this->position);
+		}
+
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(
+			this->bytes->GetBuffer() + this->position);
+		Poco::UInt64 value = 0;
+		for (int i = 0; i < size; i++)
+		{
+			int shift = littleEndian ? i * 8 : (size - i - 1) * 8;
+			value |= (Poco::UInt64) data[i] << shift;
+		}
+		this->position += size;
+		return value;
+	}
+
+	Poco::Int8 BytesReader::ReadInt8()
+	{
+		return (Poco::Int8) this->ReadUnsigned(1, true);
+	}
+
+	Poco::UInt8 BytesReader::ReadUInt8()
+	{
+		return (Poco::UInt8) this->ReadUnsigned(1, true);
+	}
+
+	Poco::Int16 BytesReader::ReadInt16(bool littleEndian)
+	{
+		return (Poco::Int16) this->ReadUnsigned(2, littleEndian);
+	}
+
+	Poco::UInt16 BytesReader::ReadUInt16(bool littleEndian)
+	{
+		return (Poco::UInt16) this->ReadUnsigned(2, littleEndian);
+	}
+
+	Poco::Int32 BytesReader::ReadInt32(bool littleEndian)
+	{
+		return (Poco::Int32) this->ReadUnsigned(4, littleEndian);
+	}
+
+	Poco::UInt32 BytesReader::ReadUInt32(bool littleEndian)
+	{
+		return (Poco::UInt32) this->ReadUnsigned(4, littleEndian);
+	}
+
+	float BytesReader::ReadFloat(bool littleEndian)
+	{
+		Poco::UInt32 bits = (Poco::UInt32) this->ReadUnsigned(4, littleEndian);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	double BytesReader::ReadDouble(bool littleEndian)
+	{
+		Poco::UInt64 bits = this->ReadUnsigned(8, littleEndian);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	void BytesReader::SetResult(BytesRef bytes, KValueRef result)
+	{
+		if (bytes.isNull())
+			result->SetNull();
+		else
+			result->SetObject(bytes);
+	}
+
+	void BytesReader::HasMore(const ValueList& args, KValueRef result)
+	{
+		result->SetBool(this->HasMore());
+	}
+
+	void BytesReader::GetPosition(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->GetPosition());
+	}
+
+	void BytesReader::Remaining(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->Remaining());
+	}
+
+	void BytesReader::Seek(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("BytesReader.seek", "n");
+		this->Seek((long) args.GetNumber(0));
+	}
+
+	void BytesReader::Skip(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("BytesReader.skip", "n");
+		this->Skip((long) args.GetNumber(0));
+	}
+
+	void BytesReader::ReadLine(const ValueList& args, KValueRef result)
+	{
+		SetResult(this->ReadLine(), result);
+	}
+
+	void BytesReader::ReadUntil(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("BytesReader.readUntil", "s|o");
+
+		// A Bytes delimiter stays alive in args until this returns.
+		BytesRef delimiterBytes(args.GetObject(0).cast<Bytes>());
+		if (!delimiterBytes.isNull())
+		{
+			SetResult(this->ReadUntil(delimiterBytes->GetBuffer(),
+				delimiterBytes->Length()), result);
+		}
+		else
+		{
+			std::string delimiter(args.GetString(0));
+			SetResult(this->ReadUntil(delimiter.data(), delimiter.length()), result);
+		}
+	}
+
+	void BytesReader::Read(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("BytesReader.read", "n");
+		SetResult(this->Read((long) args.GetNumber(0)), result);
+	}
+
+	void BytesReader::ReadInt8(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadInt8());
+	}
+
+	void BytesReader::ReadUInt8(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadUInt8());
+	}
+
+	void BytesReader::ReadInt16LE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadInt16(true));
+	}
+
+	void BytesReader::ReadInt16BE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadInt16(false));
+	}
+
+	void BytesReader::ReadUInt16LE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadUInt16(true));
+	}
+
+	void BytesReader::ReadUInt16BE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadUInt16(false));
+	}
+
+	void BytesReader::ReadInt32LE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadInt32(true));
+	}
+
+	void BytesReader::ReadInt32BE(const ValueList& args, KValueRef result)
+	{
+		result->SetInt(this->ReadInt32(false));
+	}
+
+	// Unsigned 32-bit values do not fit in an int.
+	void BytesReader::ReadUInt32LE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadUInt32(true));
+	}
+
+	void BytesReader::ReadUInt32BE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadUInt32(false));
+	}
+
+	void BytesReader::ReadFloatLE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadFloat(true));
+	}
+
+	void BytesReader::ReadFloatBE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadFloat(false));
+	}
+
+	void BytesReader::ReadDoubleLE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadDouble(true));
+	}
+
+	void BytesReader::ReadDoubleBE(const ValueList& args, KValueRef result)
+	{
+		result->SetDouble(this->ReadDouble(false));
+	}
+}
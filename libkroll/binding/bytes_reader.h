@@ -0,0 +1,104 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#ifndef _KR_BYTES_READER_H_
+#define _KR_BYTES_READER_H_
+
+#include "../kroll.h"
+#include <Poco/Types.h>
+
+namespace kroll
+{
+	class BytesReader;
+	typedef AutoPtr<BytesReader> BytesReaderRef;
+
+	/**
+	 * A cursor over a Bytes. Everything it returns is a slice which
+	 * shares the buffer, so reading a large Bytes line by line or record
+	 * by record takes constant memory, unlike split.
+	 */
+	class KROLL_API BytesReader : public StaticBoundObject
+	{
+	public:
+		BytesReader(BytesRef bytes);
+		virtual ~BytesReader();
+
+		bool HasMore();
+		long GetPosition();
+		long Remaining();
+
+		/**
+		 * Move the cursor, clamping it to the contents.
+		 */
+		void Seek(long position);
+		void Skip(long count);
+
+		/**
+		 * @return the next line without its "\n" or "\r\n", or a null
+		 * reference if nothing is left
+		 */
+		BytesRef ReadLine();
+
+		/**
+		 * @return the data before the next delimiter, which is skipped,
+		 * or everything that is left if there is none. Returns a null
+		 * reference if nothing is left.
+		 */
+		BytesRef ReadUntil(const char* delimiter, long delimiterLength);
+
+		/**
+		 * @return up to count of the next bytes
+		 */
+		BytesRef Read(long count);
+
+		/**
+		 * The number readers throw a ValueException if there are not
+		 * enough bytes left, and leave the cursor where it was.
+		 */
+		Poco::Int8 ReadInt8();
+		Poco::UInt8 ReadUInt8();
+		Poco::Int16 ReadInt16(bool littleEndian);
+		Poco::UInt16 ReadUInt16(bool littleEndian);
+		Poco::Int32 ReadInt32(bool littleEndian);
+		Poco::UInt32 ReadUInt32(bool littleEndian);
+		float ReadFloat(bool littleEndian);
+		double ReadDouble(bool littleEndian);
+
+	private:
+		BytesRef bytes;
+		long position;
+
+		Poco::UInt64 ReadUnsigned(int size, bool littleEndian);
+
+		void HasMore(const ValueList& args, KValueRef result);
+		void GetPosition(const ValueList& args, KValueRef result);
+		void Remaining(const ValueList& args, KValueRef result);
+		void Seek(const ValueList& args, KValueRef result);
+		void Skip(const ValueList& args, KValueRef result);
+		void ReadLine(const ValueList& args, KValueRef result);
+		void ReadUntil(const ValueList& args, KValueRef result);
+		void Read(const ValueList& args, KValueRef result);
+		void ReadInt8(const ValueList& args, KValueRef result);
+		void ReadUInt8(const ValueList& args, KValueRef result);
+		void ReadInt16LE(const ValueList& args, KValueRef result);
+		void ReadInt16BE(const ValueList& args, KValueRef result);
+		void ReadUInt16LE(const ValueList& args, KValueRef result);
+		void ReadUInt16BE(const ValueList& args, KValueRef result);
+		void ReadInt32LE(const ValueList& args, KValueRef result);
+		void ReadInt32BE(const ValueList& args, KValueRef result);
+		void ReadUInt32LE(const ValueList& args, KValueRef result);
+		void ReadUInt32BE(const ValueList& args, KValueRef result);
+		void ReadFloatLE(const ValueList& args, KValueRef result);
+		void ReadFloatBE(const ValueList& args, KValueRef result);
+		void ReadDoubleLE(const ValueList& args, KValueRef result);
+		void ReadDoubleBE(const ValueList& args, KValueRef result);
+		static void SetResult(BytesRef bytes, KValueRef result);
+
+		DISALLOW_EVIL_CONSTRUCTORS(BytesReader);
+	};
+}
+
+#endif
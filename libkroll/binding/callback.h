@@ -170,6 +170,16 @@ namespace kroll
 		virtual ~CallbackRunner() {}
 		virtual void RunWithParams(const Params& params) = 0;
 
+		// Callbacks are small and created for every bound method, so
+		// they come from the slab allocator.
+		static void* operator new(size_t size) {
+			return SlabAllocator::Allocate(size, &SlabAllocator::callbackStats);
+		}
+
+		static void operator delete(void* pointer, size_t size) {
+			SlabAllocator::Free(pointer, size, &SlabAllocator::callbackStats);
+		}
+
 		// Convenience functions so callers don't have to deal with Tuples.
 		inline void Run() {
 			RunWithParams(Tuple0());
@@ -0,0 +1,194 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#include "compression_stream.h"
+#include <Poco/DeflatingStream.h>
+#include <Poco/InflatingStream.h>
+#include <Poco/Exception.h>
+#include <Poco/String.h>
+#include <algorithm>
+
+// Process feeds its input to the stream in chunks of this size.
+#define COMPRESSION_CHUNK_SIZE 65536
+
+namespace kroll
+{
+	int CompressionStream::OutputBuffer::overflow(int c)
+	{
+		if (c != EOF)
+			this->contents.push_back((char) c);
+		return c;
+	}
+
+	std::streamsize CompressionStream::OutputBuffer::xsputn(
+		const char* data, std::streamsize length)
+	{
+		this->contents.append(data, (size_t) length);
+		return length;
+	}
+
+	CompressionStream::CompressionStream(Mode mode, Format format, int level) :
+		StaticBoundObject("CompressionStream"),
+		outputStream(&output),
+		deflater(0),
+		inflater(0),
+		finished(false)
+	{
+		if (level < -1 || level > 9)
+			throw ValueException::FromFormat("Invalid compression level: %i", level);
+
+		if (mode == DEFLATE)
+		{
+			this->deflater = new Poco::DeflatingOutputStream(this->outputStream,
+				format == GZIP ? Poco::DeflatingStreamBuf::STREAM_GZIP :
+				Poco::DeflatingStreamBuf::STREAM_ZLIB, level);
+		}
+		else
+		{
+			this->inflater = new Poco::InflatingOutputStream(this->outputStream,
+				format == GZIP ? Poco::InflatingStreamBuf::STREAM_GZIP :
+				Poco::InflatingStreamBuf::STREAM_ZLIB);
+		}
+
+		// Let zlib errors reach Write instead of just failing the stream.
+		this->GetStream().exceptions(std::ios::badbit);
+
+		/**
+		 * @tiapi(method=True,name=CompressionStream.write,since=0.9)
+		 * @tiapi Feed the next chunk of input to the stream.
+		 * @tiarg[Bytes|String, chunk] The input
+		 * @tiresult[Bytes] The output produced so far, which may be empty
+		 */
+		this->SetMethod("write", &CompressionStream::Write);
+
+		/**
+		 * @tiapi(method=True,name=CompressionStream.finish,since=0.9)
+		 * @tiapi End the stream. It cannot be written to afterward.
+		 * @tiresult[Bytes] The rest of the output
+		 */
+		this->SetMethod("finish", &CompressionStream::Finish);
+	}
+
+	CompressionStream::~CompressionStream()
+	{
+		delete this->deflater;
+		delete this->inflater;
+	}
+
+	std::ostream& CompressionStream::GetStream()
+	{
+		if (this->deflater)
+			return *this->deflater;
+		return *this->inflater;
+	}
+
+	static std::string ExceptionMessage(std::exception& e)
+	{
+		Poco::Exception* pocoException = dynamic_cast<Poco::Exception*>(&e);
+		if (pocoException)
+			return pocoException->displayText();
+		return e.what();
+	}
+
+	BytesRef CompressionStream::TakeOutput()
+	{
+		BytesRef bytes(new Bytes(this->output.contents));
+		this->output.contents.clear();
+		return bytes;
+	}
+
+	BytesRef CompressionStream::Write(const char* data, long length)
+	{
+		ScopedLock lock(&this->mutex);
+		if (this->finished)
+			throw ValueException::FromString("The compression stream is finished");
+
+		try
+		{
+			this->GetStream().write(data, length);
+		}
+		catch (std::exception& e)
+		{
+			this->finished = true;
+			throw ValueException::FromFormat("Could not %s data: %s",
+				this->deflater ? "compress" : "decompress", ExceptionMessage(e).c_str());
+		}
+		return this->TakeOutput();
+	}
+
+	BytesRef CompressionStream::Finish()
+	{
+		ScopedLock lock(&this->mutex);
+		if (this->finished)
+			return new Bytes();
+
+		this->finished = true;
+		try
+		{
+			if (this->deflater)
+				this->deflater->close();
+			else
+				this->inflater->close();
+		}
+		catch (std::exception& e)
+		{
+			throw ValueException::FromFormat("Could not %s data: %s",
+				this->deflater ? "compress" : "decompress", ExceptionMessage(e).c_str());
+		}
+		return this->TakeOutput();
+	}
+
+	/*static*/
+	BytesRef CompressionStream::Process(Mode mode, Format format,
+		const char* data, long length, int level)
+	{
+		CompressionStreamRef stream(new CompressionStream(mode, format, level));
+		std::vector<BytesRef> chunks;
+		for (long offset = 0; offset < length; offset += COMPRESSION_CHUNK_SIZE)
+		{
+			long chunkLength = std::min((long) COMPRESSION_CHUNK_SIZE, length - offset);
+			BytesRef chunk(stream->Write(data + offset, chunkLength));
+			if (chunk->Length() > 0)
+				chunks.push_back(chunk);
+		}
+		chunks.push_back(stream->Finish());
+		return Bytes::GlobBytes(chunks);
+	}
+
+	/*static*/
+	CompressionStream::Format CompressionStream::GetFormat(const std::string& name)
+	{
+		std::string lowerName(Poco::toLower(name));
+		if (lowerName == "zlib")
+			return ZLIB;
+		else if (lowerName == "gzip")
+			return GZIP;
+		else
+			throw ValueException::FromFormat("Unknown compression format: %s", name.c_str());
+	}
+
+	void CompressionStream::Write(const ValueList& args, KValueRef result)
+	{
+		args.VerifyException("CompressionStream.write", "s|o");
+
+		// A Bytes chunk stays alive in args until this returns.
+		BytesRef bytes(args.GetObject(0).cast<Bytes>());
+		if (!bytes.isNull())
+		{
+			result->SetObject(this->Write(bytes->GetBuffer(), bytes->Length()));
+		}
+		else
+		{
+			std::string chunk(args.GetString(0));
+			result->SetObject(this->Write(chunk.data(), chunk.length()));
+		}
+	}
+
+	void CompressionStream::Finish(const ValueList& args, KValueRef result)
+	{
+		result->SetObject(this->Finish());
+	}
+}
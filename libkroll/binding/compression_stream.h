@@ -0,0 +1,104 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#ifndef _KR_COMPRESSION_STREAM_H_
+#define _KR_COMPRESSION_STREAM_H_
+
+#include "../kroll.h"
+#include <string>
+#include <ostream>
+#include <vector>
+
+namespace Poco
+{
+	class DeflatingOutputStream;
+	class InflatingOutputStream;
+}
+
+namespace kroll
+{
+	class CompressionStream;
+	typedef AutoPtr<CompressionStream> CompressionStreamRef;
+
+	/**
+	 * Incremental deflate or inflate, with zlib or gzip framing. Each
+	 * chunk written returns whatever output it produced, so only one
+	 * chunk and the compressor's window are held in memory at a time.
+	 */
+	class KROLL_API CompressionStream : public StaticBoundObject
+	{
+	public:
+		enum Mode
+		{
+			DEFLATE,
+			INFLATE
+		};
+
+		enum Format
+		{
+			ZLIB,
+			GZIP
+		};
+
+		/**
+		 * @param level 0 (none) to 9 (best), or -1 for the zlib default.
+		 * It is ignored when inflating.
+		 */
+		CompressionStream(Mode mode, Format format, int level=-1);
+		virtual ~CompressionStream();
+
+		/**
+		 * Feed the next chunk of input. Throws a ValueException if the
+		 * input is corrupt or the stream is already finished.
+		 * @return the output produced so far, which may be empty
+		 */
+		BytesRef Write(const char* data, long length);
+
+		/**
+		 * End the stream.
+		 * @return the rest of the output
+		 */
+		BytesRef Finish();
+
+		/**
+		 * Run a whole buffer through a stream, a chunk at a time.
+		 */
+		static BytesRef Process(Mode mode, Format format,
+			const char* data, long length, int level=-1);
+
+		/**
+		 * @return the format named by a script, "zlib" or "gzip"
+		 */
+		static Format GetFormat(const std::string& name);
+
+	private:
+		class OutputBuffer : public std::streambuf
+		{
+		public:
+			std::string contents;
+
+		protected:
+			virtual int overflow(int c);
+			virtual std::streamsize xsputn(const char* data, std::streamsize length);
+		};
+
+		OutputBuffer output;
+		std::ostream outputStream;
+		Poco::DeflatingOutputStream* deflater;
+		Poco::InflatingOutputStream* inflater;
+		bool finished;
+
+		std::ostream& GetStream();
+		BytesRef TakeOutput();
+
+		void Write(const ValueList& args, KValueRef result);
+		void Finish(const ValueList& args, KValueRef result);
+
+		DISALLOW_EVIL_CONSTRUCTORS(CompressionStream);
+	};
+}
+
+#endif
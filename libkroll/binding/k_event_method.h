@@ -13,8 +13,10 @@ namespace kroll
 	{
 		public:
 		KEventMethod(const char* name = "") :
-			KEventObject(name),
-			count(1) {}
+			KEventObject(name)
+		{
+			this->KMethod::ForwardReferenceCount(static_cast<KEventObject*>(this));
+		}
 
 		// @see KMethod::Call
 		virtual KValueRef Call(const ValueList& args) = 0;
@@ -58,32 +60,16 @@ namespace kroll
 		{
 			MethodCallback* callback = NewCallback<T, const ValueList&, KValueRef>(static_cast<T*>(this), method);
 
-			KMethodRef bound_method = new StaticBoundMethod(callback);
+			KMethodRef bound_method = new StaticBoundMethod(callback, "StaticBoundMethod", name);
 			KValueRef method_value = Value::NewMethod(bound_method);
 			KEventObject::Set(name, method_value);
 		}
 
-		virtual void duplicate()
-		{
-			++count;
-		}
-
-		virtual void release()
-		{
-			int value = --count;
-			if (value <= 0) {
-				delete this;
-			}
-		}
-
-		virtual int referenceCount() const
-		{
-			return count.value();
-		}
-
-		private:
-		Poco::AtomicCounter count;
-
+		// Both bases inherit ReferenceCounted, so the KMethod base
+		// forwards its count to the KEventObject one.
+		void duplicate() { KEventObject::duplicate(); }
+		void release() { KEventObject::release(); }
+		int referenceCount() const { return KEventObject::referenceCount(); }
 	};
 
 }
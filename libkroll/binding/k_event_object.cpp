@@ -19,7 +19,7 @@ namespace kroll
 		}
 		catch (ValueException& e)
 		{
-			Logger* logger = Logger::Get("KEventObject");
+			static LoggerHandle logger = { "KEventObject" };
 			SharedString ss = e.DisplayString();
 			logger->Error("Exception caught during event callback (target=[%s]): %s",
 				event->target->GetType().c_str(), ss->c_str());
@@ -9,6 +9,18 @@
 
 namespace kroll
 {
+	void* KObject::operator new(size_t size)
+	{
+		void* pointer = ::operator new(size);
+		if (ObjectAccounting::IsEnabled())
+			ObjectAccounting::NoteAllocation(pointer, size);
+		return pointer;
+	}
+
+	void KObject::operator delete(void* pointer, size_t size)
+	{
+		::operator delete(pointer);
+	}
 
 	bool KObject::Equals(KObjectRef other)
 	{
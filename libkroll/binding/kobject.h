@@ -28,8 +28,26 @@ namespace kroll
 	class KROLL_API KObject : public ReferenceCounted
 	{
 	public:
-		KObject(std::string type = "KObject") : type(type) {}
-		virtual ~KObject() {}
+		KObject(std::string type = "KObject") :
+			type(type),
+			typeCounter(0),
+			accountedSize(0)
+		{
+			if (ObjectAccounting::IsEnabled())
+				typeCounter = ObjectAccounting::Add(this, this->type, accountedSize);
+		}
+
+		virtual ~KObject()
+		{
+			if (typeCounter)
+				ObjectAccounting::Remove(typeCounter, accountedSize);
+		}
+
+		/**
+		 * Allocate objects so that ObjectAccounting can tell their size.
+		 */
+		static void* operator new(size_t size);
+		static void operator delete(void* pointer, size_t size);
 
 	public:
 
@@ -330,6 +348,9 @@ namespace kroll
 		std::string type;
 
 	private:
+		ObjectTypeCounter* typeCounter;
+		unsigned int accountedSize;
+
 		DISALLOW_EVIL_CONSTRUCTORS(KObject);
 	};
 
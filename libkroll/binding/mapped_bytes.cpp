@@ -0,0 +1,204 @@
+/*
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+
+#include "bytes.h"
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+// The longest mapping a Bytes can hold, leaving room for aligning its
+// start, which adds less than 64KB on any platform. A long is never wider
+// than a size_t, so this also fits in the address space.
+#define MAX_MAPPED_LENGTH \
+	((Poco::Int64) std::numeric_limits<long>::max() - (Poco::Int64) (1 << 16))
+
+#ifdef OS_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace kroll
+{
+	/**
+	 * A read-only file mapping. The mapping starts at a page boundary, so
+	 * the contents may begin a little way into it.
+	 */
+	class MappedBytesStorage : public BytesStorage
+	{
+	public:
+		MappedBytesStorage(void* mapping, size_t mappingLength, size_t offset,
+			long length) :
+			BytesStorage(static_cast<char*>(mapping) + offset, length),
+			mapping(mapping),
+			mappingLength(mappingLength)
+		{
+		}
+
+		virtual ~MappedBytesStorage()
+		{
+#ifdef OS_WIN32
+			UnmapViewOfFile(this->mapping);
+#else
+			munmap(this->mapping, this->mappingLength);
+#endif
+			// Nothing for BytesStorage to delete.
+			this->buffer = 0;
+		}
+
+		virtual bool IsWritable() { return false; }
+		virtual bool IsTerminated() { return false; }
+
+	private:
+		void* mapping;
+		size_t mappingLength;
+	};
+
+	/**
+	 * Work out how much of a file to map.
+	 * @return false if the offset lies outside of the file
+	 */
+	static bool GetMappedLength(Poco::Int64 fileSize, Poco::Int64 offset,
+		Poco::Int64& length)
+	{
+		if (offset < 0 || offset > fileSize)
+			return false;
+
+		if (length < 0 || length > fileSize - offset)
+			length = fileSize - offset;
+		return true;
+	}
+
+	static void ThrowTooLong(const std::string& path, Poco::Int64 length)
+	{
+		throw ValueException::FromFormat("Cannot map %lld bytes of %s at once; "
+			"map it in parts", (long long) length, path.c_str());
+	}
+
+#ifdef OS_WIN32
+	/*static*/
+	BytesRef Bytes::MapFile(const std::string& path, Poco::Int64 offset,
+		Poco::Int64 length, AccessPattern pattern)
+	{
+		DWORD flags = FILE_ATTRIBUTE_NORMAL;
+		if (pattern == SEQUENTIAL_ACCESS)
+			flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+		else if (pattern == RANDOM_ACCESS)
+			flags |= FILE_FLAG_RANDOM_ACCESS;
+
+		HANDLE file = CreateFileW(UTF8ToWide(path).c_str(), GENERIC_READ,
+			FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			throw ValueException::FromFormat("Could not open %s (%i)",
+				path.c_str(), GetLastError());
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) ||
+			!GetMappedLength(fileSize.QuadPart, offset, length))
+		{
+			CloseHandle(file);
+			throw ValueException::FromFormat("Could not map %s at offset %lld",
+				path.c_str(), (long long) offset);
+		}
+
+		if (length > MAX_MAPPED_LENGTH)
+		{
+			CloseHandle(file);
+			ThrowTooLong(path, length);
+		}
+
+		if (length == 0)
+		{
+			CloseHandle(file);
+			return new Bytes();
+		}
+
+		HANDLE mappingHandle = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (!mappingHandle)
+			throw ValueException::FromFormat("Could not map %s (%i)",
+				path.c_str(), GetLastError());
+
+		// Views must start at a multiple of the allocation granularity.
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		Poco::Int64 alignedOffset = offset - offset % systemInfo.dwAllocationGranularity;
+		size_t mappingLength = (size_t) (length + (offset - alignedOffset));
+
+		void* mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ,
+			(DWORD) (alignedOffset >> 32), (DWORD) (alignedOffset & 0xFFFFFFFF),
+			mappingLength);
+		CloseHandle(mappingHandle);
+		if (!mapping)
+			throw ValueException::FromFormat("Could not map %s (%i)",
+				path.c_str(), GetLastError());
+
+		BytesStorageRef storage(new MappedBytesStorage(mapping, mappingLength,
+			(size_t) (offset - alignedOffset), (long) length));
+		return new Bytes(storage, storage->Get(), (long) length);
+	}
+#else
+	/*static*/
+	BytesRef Bytes::MapFile(const std::string& path, Poco::Int64 offset,
+		Poco::Int64 length, AccessPattern pattern)
+	{
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw ValueException::FromFormat("Could not open %s: %s",
+				path.c_str(), strerror(errno));
+
+		struct stat fileInfo;
+		if (fstat(file, &fileInfo) != 0 ||
+			!GetMappedLength((Poco::Int64) fileInfo.st_size, offset, length))
+		{
+			close(file);
+			throw ValueException::FromFormat("Could not map %s at offset %lld",
+				path.c_str(), (long long) offset);
+		}
+
+		if (length > MAX_MAPPED_LENGTH)
+		{
+			close(file);
+			ThrowTooLong(path, length);
+		}
+
+		if (length == 0)
+		{
+			close(file);
+			return new Bytes();
+		}
+
+		// Mappings must start at a page boundary.
+		// The file is no larger than off_t can describe, so neither is the
+		// offset, which lies within it.
+		long pageSize = sysconf(_SC_PAGESIZE);
+		Poco::Int64 alignedOffset = offset - offset % pageSize;
+		size_t mappingLength = (size_t) (length + (offset - alignedOffset));
+
+		void* mapping = mmap(0, mappingLength, PROT_READ, MAP_PRIVATE,
+			file, (off_t) alignedOffset);
+		int mapError = errno;
+		close(file);
+		if (mapping == MAP_FAILED)
+			throw ValueException::FromFormat("Could not map %s: %s",
+				path.c_str(), strerror(mapError));
+
+		int advice = MADV_NORMAL;
+		if (pattern == SEQUENTIAL_ACCESS)
+			advice = MADV_SEQUENTIAL;
+		else if (pattern == RANDOM_ACCESS)
+			advice = MADV_RANDOM;
+		madvise(mapping, mappingLength, advice);
+
+		BytesStorageRef storage(new MappedBytesStorage(mapping, mappingLength,
+			(size_t) (offset - alignedOffset), (long) length));
+		return new Bytes(storage, storage->Get(), (long) length);
+	}
+#endif
+}
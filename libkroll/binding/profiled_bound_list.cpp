@@ -12,9 +12,9 @@ namespace kroll
 {
 	ProfiledBoundList::ProfiledBoundList(KListRef delegate) :
 		ProfiledBoundObject(delegate),
-		list(delegate),
-		count(1)
+		list(delegate)
 	{
+		this->KList::ForwardReferenceCount(static_cast<ProfiledBoundObject*>(this));
 	}
 
 	ProfiledBoundList::~ProfiledBoundList()
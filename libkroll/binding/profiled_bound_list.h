@@ -41,27 +41,14 @@ namespace kroll
 		 * @return the delegate of this profiled bound object
 		 */
 		KListRef GetDelegate() { return list; }
-		virtual void duplicate()
-		{
-			++count;
-		}
-
-		virtual void release()
-		{
-			int value = --count;
-			if (value <= 0) {
-				delete this;
-			}
-		}
-
-		virtual int referenceCount() const
-		{
-			return count.value();
-		}
+		// Both bases inherit ReferenceCounted, so the KList base
+		// forwards its count to the ProfiledBoundObject one.
+		void duplicate() { ProfiledBoundObject::duplicate(); }
+		void release() { ProfiledBoundObject::release(); }
+		int referenceCount() const { return ProfiledBoundObject::referenceCount(); }
 
 	private:
 		KListRef list;
-		Poco::AtomicCounter count;
 
 	};
 }
@@ -14,9 +14,9 @@ namespace kroll
 	ProfiledBoundMethod::ProfiledBoundMethod(KMethodRef delegate, std::string& type) :
 		ProfiledBoundObject(delegate),
 		method(delegate),
-		fullType(type),
-		count(1)
+		fullType(type)
 	{
+		this->KMethod::ForwardReferenceCount(static_cast<ProfiledBoundObject*>(this));
 	}
 
 	ProfiledBoundMethod::~ProfiledBoundMethod()
@@ -25,7 +25,13 @@ namespace kroll
 
 	KValueRef ProfiledBoundMethod::Call(const ValueList& args)
 	{
-		std::string type = this->GetType();
+		if (!Profiler::IsEnabled())
+			return method->Call(args);
+
+		std::string& type = this->GetType();
+		unsigned int weight = Profiler::Sample();
+		if (!weight)
+			return this->Wrap(method->Call(args), type);
 
 		KValueRef value;
 		Poco::Stopwatch sw;
@@ -34,12 +40,12 @@ namespace kroll
 			value = method->Call(args);
 		} catch (...) {
 			sw.stop();
-			this->Log("call", type, sw.elapsed());
+			this->Log("call", type, sw.elapsed(), weight);
 			throw;
 		}
 
 		sw.stop();
-		this->Log("call", type, sw.elapsed());
+		this->Log("call", type, sw.elapsed(), weight);
 		return this->Wrap(value, type);
 	}
 
@@ -35,28 +35,15 @@ namespace kroll
 		 * @return the delegate of this profiled bound method
 		 */
 		KMethodRef GetDelegate() { return method; }
-		virtual void duplicate()
-		{
-			++count;
-		}
-
-		virtual void release()
-		{
-			int value = --count;
-			if (value <= 0) {
-				delete this;
-			}
-		}
-
-		virtual int referenceCount() const
-		{
-			return count.value();
-		}
+		// Both bases inherit ReferenceCounted, so the KMethod base
+		// forwards its count to the ProfiledBoundObject one.
+		void duplicate() { ProfiledBoundObject::duplicate(); }
+		void release() { ProfiledBoundObject::release(); }
+		int referenceCount() const { return ProfiledBoundObject::referenceCount(); }
 
 	private:
 		KMethodRef method;
 		std::string fullType;
-		Poco::AtomicCounter count;
 
 	};
 }
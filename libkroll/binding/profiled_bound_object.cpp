@@ -7,29 +7,84 @@
 #include "../kroll.h"
 #include <cstdio>
 #include <cstring>
-#include <iostream>
-#include <sstream>
+#include <algorithm>
 #include <Poco/Stopwatch.h>
+#include <Poco/Mutex.h>
 #include <Poco/ScopedLock.h>
 
+#define PROFILER_MIN_WRAPPER_CACHE 1024
+
 namespace kroll
 {
-	Poco::FileOutputStream* ProfiledBoundObject::stream = 0;
-	Poco::Mutex ProfiledBoundObject::logMutex;
-	void ProfiledBoundObject::SetStream(Poco::FileOutputStream* stream)
+	Poco::AtomicCounter ProfiledBoundObject::wrappers;
+
+	// The wrapper handed out for each object, so that an object which is
+	// reached often is not wrapped again every time. Entries do not keep
+	// wrappers alive, and a live wrapper keeps its delegate alive, so an
+	// entry whose wrapper can still be locked always belongs to the object
+	// at that address.
+	typedef std::map<KObject*, KWeakRef<ProfiledBoundObject> > WrapperCache;
+	static Poco::FastMutex wrapperCacheMutex;
+	static WrapperCache wrapperCache;
+	static size_t pruneWrapperCacheAt = PROFILER_MIN_WRAPPER_CACHE;
+
+	static AutoPtr<ProfiledBoundObject> FindWrapper(KObject* delegate)
+	{
+		Poco::FastMutex::ScopedLock lock(wrapperCacheMutex);
+		WrapperCache::iterator i = wrapperCache.find(delegate);
+		if (i == wrapperCache.end())
+			return 0;
+		return i->second.Lock();
+	}
+
+	static void AddWrapper(KObject* delegate, ProfiledBoundObject* wrapper)
+	{
+		Poco::FastMutex::ScopedLock lock(wrapperCacheMutex);
+		wrapperCache[delegate] = KWeakRef<ProfiledBoundObject>(wrapper);
+		if (wrapperCache.size() < pruneWrapperCacheAt)
+			return;
+
+		// Forget the wrappers which have been destroyed.
+		WrapperCache::iterator i = wrapperCache.begin();
+		while (i != wrapperCache.end())
+		{
+			if (i->second.IsAlive())
+				i++;
+			else
+				wrapperCache.erase(i++);
+		}
+		pruneWrapperCacheAt = std::max((size_t) PROFILER_MIN_WRAPPER_CACHE,
+			wrapperCache.size() * 2);
+	}
+
+	/**
+	 * Whether a cached wrapper can stand for value. The same delegate can
+	 * be reached as an object in one place and as a list or a method in
+	 * another, and each needs its own kind of wrapper.
+	 */
+	static bool IsWrapperFor(AutoPtr<ProfiledBoundObject> wrapped, KValueRef value)
 	{
-		ProfiledBoundObject::stream = stream;
+		bool isMethod = !wrapped.cast<ProfiledBoundMethod>().isNull();
+		bool isList = !wrapped.cast<ProfiledBoundList>().isNull();
+		if (value->IsMethod())
+			return isMethod;
+		else if (value->IsList())
+			return isList;
+		else
+			return !isMethod && !isList;
 	}
 
 	ProfiledBoundObject::ProfiledBoundObject(KObjectRef delegate) :
 		KObject(delegate->GetType()),
 		delegate(delegate),
-		count(1)
+		counted(false)
 	{
 	}
 
 	ProfiledBoundObject::~ProfiledBoundObject()
 	{
+		if (counted)
+			--wrappers;
 	}
 
 	bool ProfiledBoundObject::AlreadyWrapped(KValueRef value)
@@ -60,51 +115,94 @@ namespace kroll
 		{
 			return value;
 		}
+
+		KObjectRef toWrap = value->ToObject();
+		AutoPtr<ProfiledBoundObject> wrapped = FindWrapper(toWrap.get());
+
+		// Methods are profiled under the name they were reached by. A
+		// wrapper which does not fit is replaced in the cache below.
+		if (!wrapped.isNull() && IsWrapperFor(wrapped, value) &&
+			(!value->IsMethod() || wrapped->GetType() == type))
+		{
+			// Fall through to hand out the cached wrapper.
+		}
 		else if (value->IsMethod())
 		{
-			KMethodRef toWrap = value->ToMethod();
-			KMethodRef wrapped = new ProfiledBoundMethod(toWrap, type);
-			return Value::NewMethod(wrapped);
+			wrapped = new ProfiledBoundMethod(value->ToMethod(), type);
 		}
 		else if (value->IsList())
 		{
-			KListRef wrapped = new ProfiledBoundList(value->ToList());
-			return Value::NewList(wrapped);
+			wrapped = new ProfiledBoundList(value->ToList());
 		}
-		else if (value->IsObject())
+		else
 		{
-			KObjectRef wrapped = new ProfiledBoundObject(value->ToObject());
-			return Value::NewObject(wrapped);
+			wrapped = new ProfiledBoundObject(toWrap);
+		}
+
+		if (!wrapped->counted)
+		{
+			wrapped->counted = true;
+			++wrappers;
+			AddWrapper(toWrap.get(), wrapped.get());
+		}
+
+		if (value->IsMethod())
+		{
+			AutoPtr<ProfiledBoundMethod> method = wrapped.cast<ProfiledBoundMethod>();
+			return Value::NewMethod(KMethodRef(method.get(), true));
+		}
+		else if (value->IsList())
+		{
+			AutoPtr<ProfiledBoundList> list = wrapped.cast<ProfiledBoundList>();
+			return Value::NewList(KListRef(list.get(), true));
 		}
 		else
 		{
-			return value;
+			return Value::NewObject(wrapped);
 		}
 	}
 
 	void ProfiledBoundObject::Set(const char *name, KValueRef value)
 	{
+		if (!Profiler::IsEnabled())
+		{
+			delegate->Set(name, value);
+			return;
+		}
+
 		std::string type = this->GetSubType(name);
 		KValueRef result = ProfiledBoundObject::Wrap(value, type);
+		unsigned int weight = Profiler::Sample();
+		if (!weight)
+		{
+			delegate->Set(name, result);
+			return;
+		}
 
 		Poco::Stopwatch sw;
 		sw.start();
 		delegate->Set(name, result);
 		sw.stop();
 
-		this->Log("set", type, sw.elapsed());
+		this->Log("set", type, sw.elapsed(), weight);
 	}
 
 	KValueRef ProfiledBoundObject::Get(const char *name)
 	{
+		if (!Profiler::IsEnabled())
+			return delegate->Get(name);
+
 		std::string type = this->GetSubType(name);
+		unsigned int weight = Profiler::Sample();
+		if (!weight)
+			return ProfiledBoundObject::Wrap(delegate->Get(name), type);
 
 		Poco::Stopwatch sw;
 		sw.start();
 		KValueRef value = delegate->Get(name);
 		sw.stop();
 
-		this->Log("get", type, sw.elapsed());
+		this->Log("get", type, sw.elapsed(), weight);
 		return ProfiledBoundObject::Wrap(value, type);
 	}
 
@@ -113,16 +211,10 @@ namespace kroll
 		return delegate->GetPropertyNames();
 	}
 
-	void ProfiledBoundObject::Log(
-		const char* eventType, std::string& name, Poco::Timestamp::TimeDiff elapsedTime)
+	void ProfiledBoundObject::Log(const char* eventType, std::string& name,
+		Poco::Timestamp::TimeDiff elapsedTime, unsigned int weight)
 	{
-		Poco::ScopedLock<Poco::Mutex> lock(logMutex);
-		if ((*ProfiledBoundObject::stream)) {
-			*ProfiledBoundObject::stream << Host::GetInstance()->GetElapsedTime() << ",";
-			*ProfiledBoundObject::stream << eventType << ",";
-			*ProfiledBoundObject::stream << name << ",";
-			*ProfiledBoundObject::stream << elapsedTime << "," << std::endl;
-		}
+		Profiler::Record(eventType, name, elapsedTime, weight);
 	}
 
 	SharedString ProfiledBoundObject::DisplayString(int levels)
@@ -6,21 +6,22 @@
 
 #ifndef _KR_PROFILED_BOUND_OBJECT_H_
 #define _KR_PROFILED_BOUND_OBJECT_H_
-#include <Poco/FileStream.h>
-#include <Poco/Mutex.h>
+#include <Poco/Timestamp.h>
+#include <Poco/AtomicCounter.h>
 
 namespace kroll
 {
 	/**
 	 * The ProfiledBoundObject is a wrapped KObject that does profiling on a 
-	 * wrapped KObject
+	 * wrapped KObject. Timings are aggregated by the Profiler. While the
+	 * Profiler is disabled, it forwards to the wrapped KObject and hands
+	 * out values without wrapping them.
 	 */
 	class KROLL_API ProfiledBoundObject : public KObject
 	{
 		public:
 		ProfiledBoundObject(KObjectRef delegate);
 		virtual ~ProfiledBoundObject();
-		static void SetStream(Poco::FileOutputStream*);
 
 		public:
 		// @see KObject::Set
@@ -40,33 +41,24 @@ namespace kroll
 		 * @return the delegate of this profiled bound object
 		 */
 		KObjectRef GetDelegate() { return delegate; }
-		virtual void duplicate()
-		{
-			++count;
-		}
 
-		virtual void release()
-		{
-			int value = --count;
-			if (value <= 0) {
-				delete this;
-			}
-		}
-
-		virtual int referenceCount() const
-		{
-			return count.value();
-		}
+		/**
+		 * @return true if values handed out by profiled objects may still
+		 * be alive and need to be unwrapped before use
+		 */
+		static bool HasWrappers() { return wrappers.value() > 0; }
 
 	protected:
 		KObjectRef delegate;
 		KValueRef Wrap(KValueRef value, std::string type);
 		std::string GetSubType(std::string name);
-		void Log(const char* eventType, std::string& name, Poco::Timestamp::TimeDiff);
+		void Log(const char* eventType, std::string& name,
+			Poco::Timestamp::TimeDiff, unsigned int weight);
 		static bool AlreadyWrapped(KValueRef);
-		static Poco::FileOutputStream *stream;
-		static Poco::Mutex logMutex;
-		Poco::AtomicCounter count;
+
+		private:
+		bool counted;
+		static Poco::AtomicCounter wrappers;
 	};
 }
 
@@ -8,8 +8,11 @@
 
 namespace kroll
 {
-	StaticBoundMethod::StaticBoundMethod(MethodCallback* callback, const char *type)
-		: KMethod(type), callback(callback)
+	KROLL_SLAB_ALLOCATOR_IMPL(StaticBoundMethod)
+
+	StaticBoundMethod::StaticBoundMethod(MethodCallback* callback, const char *type,
+		const char *name)
+		: KMethod(type), callback(callback), name(*name ? name : type)
 	{
 		this->object = new StaticBoundObject();
 	}
@@ -20,6 +23,7 @@ namespace kroll
 
 	KValueRef StaticBoundMethod::Call(const ValueList& args)
 	{
+		TraceSpan span("Native", this->name.c_str());
 		KValueRef tv = Value::NewUndefined();
 		if (this->callback)
 		{
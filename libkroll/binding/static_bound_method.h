@@ -14,9 +14,16 @@ namespace kroll
 	{
 	public:
 
-		StaticBoundMethod(MethodCallback* callback, const char *type = "StaticBoundMethod");
+		/**
+		 * @param name the name of the property which holds this method,
+		 * which is what traces call it. The type is used if it is empty.
+		 */
+		StaticBoundMethod(MethodCallback* callback, const char *type = "StaticBoundMethod",
+			const char *name = "");
 		virtual ~StaticBoundMethod();
 
+		KROLL_SLAB_ALLOCATED
+
 		/**
 		 * @see KMethod::Call
 		 */
@@ -46,7 +53,7 @@ namespace kroll
 		{
 			MethodCallback* callback = NewCallback<T, const ValueList&, KValueRef>(static_cast<T*>(this), method);
 
-			KMethodRef bound_method = new StaticBoundMethod(callback);
+			KMethodRef bound_method = new StaticBoundMethod(callback, "StaticBoundMethod", name);
 			KValueRef method_value = Value::NewMethod(bound_method);
 			this->Set(name, method_value);
 		}
@@ -62,6 +69,7 @@ namespace kroll
 		SharedPtr<MethodCallback> callback;
 		AutoPtr<StaticBoundObject> object;
 		std::map<std::string, KValueRef > properties;
+		std::string name;
 
 	private:
 		DISALLOW_EVIL_CONSTRUCTORS(StaticBoundMethod);
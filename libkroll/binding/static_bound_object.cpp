@@ -20,6 +20,7 @@ namespace kroll
 
 	bool StaticBoundObject::HasProperty(const char* name)
 	{
+		ScopedLock lock(&mutex);
 		return properties.find(name) != properties.end();
 	}
 	
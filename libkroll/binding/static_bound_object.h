@@ -57,7 +57,8 @@ namespace kroll
 		void SetMethod(const char* name, void (T::*method)(const ValueList&, KValueRef))
 		{
 			this->Set(name, Value::NewMethod(new StaticBoundMethod(
-				NewCallback<T, const ValueList&, KValueRef>(static_cast<T*>(this), method))));
+				NewCallback<T, const ValueList&, KValueRef>(static_cast<T*>(this), method),
+				"StaticBoundMethod", name)));
 		}
 
 
@@ -8,11 +8,29 @@
 #include <sstream>
 #include <cstring>
 
+// Integers in this range are handed out as shared, immortal values.
+#define IMMORTAL_INT_MIN -128
+#define IMMORTAL_INT_MAX 1023
+
 namespace kroll
 {
+	KROLL_SLAB_ALLOCATOR_IMPL(Value)
+
+	static bool immortalsInitialized = false;
+	static Value* immortalInts[IMMORTAL_INT_MAX - IMMORTAL_INT_MIN + 1];
+	static Value* immortalTrue = 0;
+	static Value* immortalFalse = 0;
+	static Value* immortalNull = 0;
+	static Value* immortalEmptyString = 0;
 
 	void Value::reset()
 	{
+		if (this->IsImmortal())
+		{
+			throw ValueException::FromString(
+				"Cannot modify an immortal Value; create a new one instead");
+		}
+
 		if (this->IsString() && this->stringValue)
 		{
 			free(this->stringValue);
@@ -54,6 +72,48 @@ namespace kroll
 		reset();
 	}
 
+	/*static*/
+	KValueRef Value::Immortal(Value* value)
+	{
+		value->MakeImmortal();
+		return KValueRef(value);
+	}
+
+	/*static*/
+	void Value::InitializeImmortals()
+	{
+		// This first happens while the library is being loaded (when
+		// Value::Null is initialized), so there is no other thread around.
+		if (immortalsInitialized)
+			return;
+
+		for (int i = IMMORTAL_INT_MIN; i <= IMMORTAL_INT_MAX; i++)
+		{
+			Value* v = new Value();
+			v->SetInt(i);
+			Immortal(v);
+			immortalInts[i - IMMORTAL_INT_MIN] = v;
+		}
+
+		immortalTrue = new Value();
+		immortalTrue->SetBool(true);
+		Immortal(immortalTrue);
+
+		immortalFalse = new Value();
+		immortalFalse->SetBool(false);
+		Immortal(immortalFalse);
+
+		immortalNull = new Value();
+		immortalNull->SetNull();
+		Immortal(immortalNull);
+
+		immortalEmptyString = new Value();
+		immortalEmptyString->SetString("");
+		Immortal(immortalEmptyString);
+
+		immortalsInitialized = true;
+	}
+
 	KValueRef Value::NewUndefined()
 	{
 		KValueRef v(new Value());
@@ -62,13 +122,18 @@ namespace kroll
 
 	KValueRef Value::NewNull()
 	{
-		KValueRef v(new Value());
-		v->SetNull();
-		return v;
+		InitializeImmortals();
+		return KValueRef(immortalNull);
 	}
 
 	KValueRef Value::NewInt(int value)
 	{
+		if (value >= IMMORTAL_INT_MIN && value <= IMMORTAL_INT_MAX)
+		{
+			InitializeImmortals();
+			return KValueRef(immortalInts[value - IMMORTAL_INT_MIN]);
+		}
+
 		KValueRef v(new Value());
 		v->SetInt(value);
 		return v;
@@ -83,13 +148,18 @@ namespace kroll
 
 	KValueRef Value::NewBool(bool value)
 	{
-		KValueRef v(new Value());
-		v->SetBool(value);
-		return v;
+		InitializeImmortals();
+		return KValueRef(value ? immortalTrue : immortalFalse);
 	}
 
 	KValueRef Value::NewString(const char* value)
 	{
+		if (value && value[0] == '\0')
+		{
+			InitializeImmortals();
+			return KValueRef(immortalEmptyString);
+		}
+
 		KValueRef v(new Value());
 		v->SetString(value);
 		return v;
@@ -97,16 +167,12 @@ namespace kroll
 
 	KValueRef Value::NewString(std::string value)
 	{
-		KValueRef v(new Value());
-		v->SetString(value.c_str());
-		return v;
+		return NewString(value.c_str());
 	}
 
 	KValueRef Value::NewString(SharedString value)
 	{
-		KValueRef v(new Value());
-		v->SetString(value.get()->c_str());
-		return v;
+		return NewString(value.get()->c_str());
 	}
 
 	KValueRef Value::NewList(KListRef value)
@@ -130,7 +196,7 @@ namespace kroll
 		return v;
 	}
 
-	KValueRef Value::Undefined = NewUndefined();
+	KValueRef Value::Undefined = Immortal(new Value());
 	KValueRef Value::Null = NewNull();
 
 	bool Value::IsInt() const { return type == INT || (type == DOUBLE && ((int) numberValue) == numberValue); }
@@ -383,7 +449,7 @@ namespace kroll
 
 	void Value::Unwrap(KValueRef value)
 	{
-		if (!Host::GetInstance()->ProfilingEnabled())
+		if (!ProfiledBoundObject::HasWrappers())
 		{
 			return;
 		}
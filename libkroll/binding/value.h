@@ -46,11 +46,24 @@ namespace kroll
 		 */
 		static KValueRef Null;
 
+		/**
+		 * Construct a new, mutable \link #Value::Type::UNDEFINED undefined\endlink
+		 * value. This is the value handed to bound methods as their result, so
+		 * it is never shared.
+		 */
 		static KValueRef NewUndefined();
+
+		/**
+		 * Return the immortal \link #Value::Type::NULLV null\endlink value.
+		 * Immortal values are shared between all callers, so they skip
+		 * reference counting entirely. Calling any of the setters on an
+		 * immortal value throws a ValueException.
+		 */
 		static KValueRef NewNull();
 
 		/**
 		 * Construct a new \link #Value::Type::INT integer\endlink value.
+		 * Integers in the small range are shared, immortal instances.
 		 * @param value The integer value
 		 */
 		static KValueRef NewInt(int value);
@@ -62,7 +75,7 @@ namespace kroll
 		static KValueRef NewDouble(double value);
 
 		/**
-		 * Construct a new \link #Value::Type::BOOL boolean\endlink value.
+		 * Return the immortal \link #Value::Type::BOOL boolean\endlink value.
 		 * @param value The boolean value
 		 */
 		static KValueRef NewBool(bool value);
@@ -105,6 +118,8 @@ namespace kroll
 
 		virtual ~Value();
 
+		KROLL_SLAB_ALLOCATED
+
 	public:
 		/**
 		 * Test underlying value's equality to another Value
@@ -301,6 +316,8 @@ namespace kroll
 		KObjectRef objectValue;
 
 		void reset();
+		static KValueRef Immortal(Value* value);
+		static void InitializeImmortals();
 
 		Value();
 		Value(KValueRef value);
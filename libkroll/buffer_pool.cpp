@@ -0,0 +1,303 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstdlib>
+#include <new>
+#include <Poco/AtomicCounter.h>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+
+#define BUFFER_POOL_MIN_SHIFT 12
+#define BUFFER_POOL_SIZE_CLASSES 9
+#define BUFFER_POOL_SLACK 64
+#define BUFFER_POOL_HEADER_SIZE 16
+#define BUFFER_POOL_UNPOOLED ((size_t) -1)
+#define BUFFER_POOL_THREAD_CACHE_BYTES (256 * 1024)
+#define BUFFER_POOL_DEFAULT_RETENTION (16 * 1024 * 1024)
+
+namespace kroll
+{
+	struct FreeBuffer
+	{
+		FreeBuffer* next;
+	};
+
+	struct BufferSizeClass
+	{
+		Poco::FastMutex mutex;
+		FreeBuffer* freeList;
+		size_t freeCount;
+		Poco::AtomicCounter allocations;
+		Poco::AtomicCounter reused;
+		Poco::AtomicCounter liveBlocks;
+	};
+
+	struct BufferThreadCache
+	{
+		FreeBuffer* freeList[BUFFER_POOL_SIZE_CLASSES];
+		size_t count[BUFFER_POOL_SIZE_CLASSES];
+	};
+
+	static BufferSizeClass* depot = 0;
+	static volatile AtomicWord retainedBytes = 0;
+	static volatile AtomicWord retentionLimit = BUFFER_POOL_DEFAULT_RETENTION;
+	static Poco::AtomicCounter discardedBlocks;
+	static Poco::AtomicCounter unpooledAllocations;
+
+	static inline size_t BlockSize(size_t sizeClass)
+	{
+		return ((size_t) 1 << (BUFFER_POOL_MIN_SHIFT + sizeClass)) + BUFFER_POOL_SLACK;
+	}
+
+	static inline size_t ThreadCacheLimit(size_t sizeClass)
+	{
+		size_t limit = BUFFER_POOL_THREAD_CACHE_BYTES / BlockSize(sizeClass);
+		return limit < 2 ? 2 : limit;
+	}
+
+	static size_t GetSizeClass(size_t size)
+	{
+		if (size <= BlockSize(0) / 2 || size > BlockSize(BUFFER_POOL_SIZE_CLASSES - 1))
+			return BUFFER_POOL_UNPOOLED;
+
+		size_t sizeClass = 0;
+		while (BlockSize(sizeClass) < size)
+			sizeClass++;
+		return sizeClass;
+	}
+
+	static inline size_t& SizeClassOf(char* buffer)
+	{
+		return *reinterpret_cast<size_t*>(buffer - BUFFER_POOL_HEADER_SIZE);
+	}
+
+	static void ReturnBuffers(size_t sizeClass, FreeBuffer*& list, size_t& count, size_t toReturn)
+	{
+		if (toReturn == 0)
+			return;
+
+		BufferSizeClass& c = depot[sizeClass];
+		Poco::FastMutex::ScopedLock lock(c.mutex);
+		for (size_t i = 0; i < toReturn && list; i++)
+		{
+			FreeBuffer* buffer = list;
+			list = buffer->next;
+			buffer->next = c.freeList;
+			c.freeList = buffer;
+			c.freeCount++;
+			count--;
+		}
+	}
+
+	static void DestroyThreadCache(void* data)
+	{
+		BufferThreadCache* cache = static_cast<BufferThreadCache*>(data);
+		for (size_t i = 0; i < BUFFER_POOL_SIZE_CLASSES; i++)
+		{
+			ReturnBuffers(i, cache->freeList[i], cache->count[i], cache->count[i]);
+		}
+		free(cache);
+	}
+
+	// Buffers cached by threads which exit on Windows stay counted as
+	// retained and are never reused.
+	static ThreadLocal<BufferThreadCache> threadCache = { &DestroyThreadCache };
+
+	static void InitializePool()
+	{
+		if (depot)
+			return;
+
+		void* memory = malloc(sizeof(BufferSizeClass) * BUFFER_POOL_SIZE_CLASSES);
+		BufferSizeClass* classes = static_cast<BufferSizeClass*>(memory);
+		for (size_t i = 0; i < BUFFER_POOL_SIZE_CLASSES; i++)
+		{
+			BufferSizeClass* sizeClass = new (&classes[i]) BufferSizeClass;
+			sizeClass->freeList = 0;
+			sizeClass->freeCount = 0;
+		}
+		depot = classes;
+	}
+
+	// Create the depot while the library loads, so that threads never
+	// race to do it later. Buffers allocated during the static
+	// initialization of other translation units create it on demand.
+	static struct BufferPoolInitializer
+	{
+		BufferPoolInitializer() { InitializePool(); }
+	} bufferPoolInitializer;
+
+	static BufferThreadCache* GetThreadCache()
+	{
+		BufferThreadCache* cache = threadCache.Get();
+		if (!cache)
+		{
+			cache = static_cast<BufferThreadCache*>(calloc(1, sizeof(BufferThreadCache)));
+			threadCache.Set(cache);
+		}
+		return cache;
+	}
+
+	static void FetchBuffers(size_t sizeClass, BufferThreadCache* cache)
+	{
+		BufferSizeClass& c = depot[sizeClass];
+		size_t wanted = ThreadCacheLimit(sizeClass) / 2;
+
+		Poco::FastMutex::ScopedLock lock(c.mutex);
+		while (c.freeList && cache->count[sizeClass] < wanted)
+		{
+			FreeBuffer* buffer = c.freeList;
+			c.freeList = buffer->next;
+			c.freeCount--;
+
+			buffer->next = cache->freeList[sizeClass];
+			cache->freeList[sizeClass] = buffer;
+			cache->count[sizeClass]++;
+		}
+	}
+
+	static char* AllocateFromSystem(size_t size, size_t sizeClass)
+	{
+		char* block = static_cast<char*>(malloc(size + BUFFER_POOL_HEADER_SIZE));
+		if (!block)
+			throw std::bad_alloc();
+
+		char* buffer = block + BUFFER_POOL_HEADER_SIZE;
+		SizeClassOf(buffer) = sizeClass;
+		return buffer;
+	}
+
+	/*static*/
+	char* BufferPool::Allocate(size_t size)
+	{
+		size_t sizeClass = GetSizeClass(size);
+		if (sizeClass == BUFFER_POOL_UNPOOLED)
+		{
+			++unpooledAllocations;
+			return AllocateFromSystem(size == 0 ? 1 : size, sizeClass);
+		}
+
+		InitializePool();
+		BufferSizeClass& c = depot[sizeClass];
+		++c.allocations;
+		++c.liveBlocks;
+
+		BufferThreadCache* cache = GetThreadCache();
+		if (!cache->freeList[sizeClass])
+			FetchBuffers(sizeClass, cache);
+
+		FreeBuffer* freeBuffer = cache->freeList[sizeClass];
+		if (!freeBuffer)
+			return AllocateFromSystem(BlockSize(sizeClass), sizeClass);
+
+		cache->freeList[sizeClass] = freeBuffer->next;
+		cache->count[sizeClass]--;
+		AtomicAdd(&retainedBytes, -((AtomicWord) BlockSize(sizeClass)));
+		++c.reused;
+
+		return reinterpret_cast<char*>(freeBuffer);
+	}
+
+	/*static*/
+	void BufferPool::Free(char* buffer)
+	{
+		if (!buffer)
+			return;
+
+		size_t sizeClass = SizeClassOf(buffer);
+		if (sizeClass == BUFFER_POOL_UNPOOLED)
+		{
+			free(buffer - BUFFER_POOL_HEADER_SIZE);
+			return;
+		}
+
+		--depot[sizeClass].liveBlocks;
+
+		// Reserve room within the limit before keeping the buffer.
+		AtomicWord blockSize = (AtomicWord) BlockSize(sizeClass);
+		if (AtomicAdd(&retainedBytes, blockSize) > retentionLimit)
+		{
+			AtomicAdd(&retainedBytes, -blockSize);
+			++discardedBlocks;
+			free(buffer - BUFFER_POOL_HEADER_SIZE);
+			return;
+		}
+
+		// Free buffers use their first bytes as the list link, which
+		// leaves the size class in front of them intact.
+		BufferThreadCache* cache = GetThreadCache();
+		FreeBuffer* freeBuffer = reinterpret_cast<FreeBuffer*>(buffer);
+		freeBuffer->next = cache->freeList[sizeClass];
+		cache->freeList[sizeClass] = freeBuffer;
+		cache->count[sizeClass]++;
+
+		size_t limit = ThreadCacheLimit(sizeClass);
+		if (cache->count[sizeClass] > limit)
+		{
+			ReturnBuffers(sizeClass, cache->freeList[sizeClass],
+				cache->count[sizeClass], limit / 2);
+		}
+	}
+
+	/*static*/
+	void BufferPool::SetRetentionLimit(size_t bytes)
+	{
+		retentionLimit = (AtomicWord) bytes;
+	}
+
+	/*static*/
+	size_t BufferPool::GetRetentionLimit()
+	{
+		return (size_t) retentionLimit;
+	}
+
+	/*static*/
+	void BufferPool::GetStatistics(BufferPoolStats& stats)
+	{
+		InitializePool();
+		stats.retainedBytes = (size_t) retainedBytes;
+		stats.retentionLimit = (size_t) retentionLimit;
+		stats.discardedBlocks = discardedBlocks.value();
+		stats.unpooledAllocations = unpooledAllocations.value();
+
+		for (size_t i = 0; i < BUFFER_POOL_SIZE_CLASSES; i++)
+		{
+			BufferSizeClass& c = depot[i];
+			Poco::FastMutex::ScopedLock lock(c.mutex);
+
+			BufferPoolSizeClassStats s;
+			s.blockSize = BlockSize(i);
+			s.allocations = c.allocations.value();
+			s.reused = c.reused.value();
+			s.liveBlocks = c.liveBlocks.value();
+			s.depotBlocks = c.freeCount;
+			stats.sizeClasses.push_back(s);
+		}
+	}
+
+	/*static*/
+	void BufferPool::LogStatistics(Logger* logger)
+	{
+		BufferPoolStats stats;
+		GetStatistics(stats);
+		logger->Debug("Buffer pool: %i bytes retained of %i, %i buffers "
+			"discarded, %i unpooled allocations", (int) stats.retainedBytes,
+			(int) stats.retentionLimit, (int) stats.discardedBlocks,
+			(int) stats.unpooledAllocations);
+
+		for (size_t i = 0; i < stats.sizeClasses.size(); i++)
+		{
+			BufferPoolSizeClassStats& s = stats.sizeClasses[i];
+			if (s.allocations == 0)
+				continue;
+
+			double reuse = (double) s.reused / (double) s.allocations;
+			logger->Debug("%i byte buffers: %i allocations, %.1f%% reused, "
+				"%i live, %i in depot", (int) s.blockSize, (int) s.allocations,
+				reuse * 100.0, (int) s.liveBlocks, (int) s.depotBlocks);
+		}
+	}
+}
@@ -0,0 +1,71 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_BUFFER_POOL_H_
+#define _KR_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace kroll
+{
+	/**
+	 * A snapshot of the state of one buffer pool size class.
+	 */
+	struct KROLL_API BufferPoolSizeClassStats
+	{
+		size_t blockSize;
+		size_t allocations;
+		size_t reused;
+		size_t liveBlocks;
+		size_t depotBlocks;
+	};
+
+	struct KROLL_API BufferPoolStats
+	{
+		size_t retainedBytes;
+		size_t retentionLimit;
+		size_t discardedBlocks;
+		size_t unpooledAllocations;
+		std::vector<BufferPoolSizeClassStats> sizeClasses;
+	};
+
+	/**
+	 * A pool of large buffers, such as the backing stores of Bytes, in
+	 * power-of-two size classes from 4 KB to 1 MB. Each class has room for
+	 * a few bytes more than its power of two, so that a chunk of exactly
+	 * that size and its NULL terminator still fit.
+	 *
+	 * Like the SlabAllocator, each thread keeps a few free buffers per
+	 * size class and exchanges them with a shared depot. Unlike slabs,
+	 * free buffers are handed back to the system once the pool retains
+	 * more than the retention limit, counting both the thread caches and
+	 * the depot. Buffers smaller than half the smallest class or larger
+	 * than the biggest one are not pooled.
+	 */
+	class KROLL_API BufferPool
+	{
+		public:
+		/**
+		 * @return a buffer of at least size bytes, which must be released
+		 * with Free and never with delete.
+		 */
+		static char* Allocate(size_t size);
+		static void Free(char* buffer);
+
+		/**
+		 * Change the number of free bytes the pool may hold on to. After
+		 * lowering it, buffers are handed back to the system as they are
+		 * freed until the pool is within the new limit.
+		 */
+		static void SetRetentionLimit(size_t bytes);
+		static size_t GetRetentionLimit();
+
+		static void GetStatistics(BufferPoolStats& stats);
+		static void LogStatistics(Logger* logger);
+	};
+}
+
+#endif
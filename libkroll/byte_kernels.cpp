@@ -0,0 +1,1152 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KROLL_X86 1
+#endif
+
+#if defined(KROLL_X86) && (defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define KROLL_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled with a per-function target, so the rest of
+// the library does not require AVX2 from the CPU.
+#if defined(KROLL_HAVE_SSE2) && (defined(__clang__) || (defined(__GNUC__) && \
+	(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+	(defined(_MSC_VER) && _MSC_VER >= 1800))
+#define KROLL_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define KROLL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define KROLL_TARGET_AVX2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(KROLL_HAVE_AVX2)
+#include <cpuid.h>
+#endif
+
+// Needles longer than this are searched for with the two-way algorithm,
+// which is linear in the worst case.
+#define TWO_WAY_THRESHOLD 32
+
+namespace kroll
+{
+namespace ByteKernels
+{
+	typedef const char* (*SearchKernel)(const char*, const char*, const char*, long);
+
+	static inline int LowestBit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (int) index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	static inline int HighestBit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, mask);
+		return (int) index;
+#else
+		return 31 - __builtin_clz(mask);
+#endif
+	}
+
+	// The vector kernels only compare the first and last byte of the
+	// needle, so a candidate still needs its middle checked.
+	static inline bool MiddleMatches(const char* candidate, const char* needle,
+		long needleLength)
+	{
+		return needleLength <= 2 ||
+			memcmp(candidate + 1, needle + 1, needleLength - 2) == 0;
+	}
+
+	static const char* FindScalar(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		const char* last = end - needleLength;
+		while (start <= last)
+		{
+			start = static_cast<const char*>(memchr(start, needle[0], last - start + 1));
+			if (!start)
+				return 0;
+			if (memcmp(start, needle, needleLength) == 0)
+				return start;
+			start++;
+		}
+		return 0;
+	}
+
+	static const char* FindLastScalar(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		for (const char* c = end - needleLength; c >= start; c--)
+		{
+			if (c[needleLength - 1] == needle[needleLength - 1] &&
+				c[0] == needle[0] && MiddleMatches(c, needle, needleLength))
+				return c;
+		}
+		return 0;
+	}
+
+	/**
+	 * The two-way algorithm of Crochemore and Perrin. The needle is split
+	 * at its critical factorization: the right half is matched first, and
+	 * the period of the needle bounds how far a mismatch may shift.
+	 */
+	static const char* TwoWayFind(const char* start, const char* end,
+		const char* needleChars, long needleLength)
+	{
+		const unsigned char* haystack = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* haystackEnd = reinterpret_cast<const unsigned char*>(end);
+		const unsigned char* needle = reinterpret_cast<const unsigned char*>(needleChars);
+		size_t length = needleLength;
+
+		// Maximal suffix for the usual ordering...
+		size_t ip = (size_t) -1, jp = 0, k = 1, p = 1;
+		while (jp + k < length)
+		{
+			if (needle[ip + k] == needle[jp + k])
+			{
+				if (k == p)
+				{
+					jp += p;
+					k = 1;
+				}
+				else
+				{
+					k++;
+				}
+			}
+			else if (needle[ip + k] > needle[jp + k])
+			{
+				jp += k;
+				k = 1;
+				p = jp - ip;
+			}
+			else
+			{
+				ip = jp++;
+				k = p = 1;
+			}
+		}
+		size_t split = ip;
+		size_t period = p;
+
+		// ...and for the reversed one. The later of the two is critical.
+		ip = (size_t) -1;
+		jp = 0;
+		k = p = 1;
+		while (jp + k < length)
+		{
+			if (needle[ip + k] == needle[jp + k])
+			{
+				if (k == p)
+				{
+					jp += p;
+					k = 1;
+				}
+				else
+				{
+					k++;
+				}
+			}
+			else if (needle[ip + k] < needle[jp + k])
+			{
+				jp += k;
+				k = 1;
+				p = jp - ip;
+			}
+			else
+			{
+				ip = jp++;
+				k = p = 1;
+			}
+		}
+		if (ip + 1 > split + 1)
+		{
+			split = ip;
+			period = p;
+		}
+
+		// A periodic needle remembers how much of its left half matched.
+		size_t memory0;
+		if (memcmp(needle, needle + period, split + 1) != 0)
+		{
+			memory0 = 0;
+			period = (split > length - split - 1 ? split : length - split - 1) + 1;
+		}
+		else
+		{
+			memory0 = length - period;
+		}
+
+		size_t memory = 0;
+		while ((size_t) (haystackEnd - haystack) >= length)
+		{
+			k = split + 1 > memory ? split + 1 : memory;
+			while (k < length && needle[k] == haystack[k])
+				k++;
+			if (k < length)
+			{
+				haystack += k - split;
+				memory = 0;
+				continue;
+			}
+
+			k = split + 1;
+			while (k > memory && needle[k - 1] == haystack[k - 1])
+				k--;
+			if (k <= memory)
+				return reinterpret_cast<const char*>(haystack);
+
+			haystack += period;
+			memory = memory0;
+		}
+		return 0;
+	}
+
+	typedef long (*PrefixKernel)(const char*, const char*);
+	typedef void (*EncodeKernel)(const char*, const char*, char*);
+	typedef long (*DecodeKernel)(const char*, const char*, char*);
+
+	static const char base64Alphabet[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	static const char hexDigits[] = "0123456789abcdef";
+
+	static inline int Base64Value(unsigned char c)
+	{
+		if (c >= 'A' && c <= 'Z')
+			return c - 'A';
+		if (c >= 'a' && c <= 'z')
+			return c - 'a' + 26;
+		if (c >= '0' && c <= '9')
+			return c - '0' + 52;
+		if (c == '+')
+			return 62;
+		if (c == '/')
+			return 63;
+		return -1;
+	}
+
+	static inline int HexValue(unsigned char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		c |= 0x20;
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		return -1;
+	}
+
+	static inline bool IsSpace(unsigned char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	/**
+	 * Decode the UTF-8 sequence at c into codePoint.
+	 * @return its length or 0 if it is invalid
+	 */
+	static inline int DecodeUTF8(const unsigned char* c, const unsigned char* end,
+		unsigned int& codePoint)
+	{
+		unsigned char lead = c[0];
+		if (lead < 0x80)
+		{
+			codePoint = lead;
+			return 1;
+		}
+
+		int length;
+		unsigned int minimum;
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+			codePoint = lead & 0x1F;
+			minimum = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 3;
+			codePoint = lead & 0x0F;
+			minimum = 0x800;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			codePoint = lead & 0x07;
+			minimum = 0x10000;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (end - c < length)
+			return 0;
+		for (int i = 1; i < length; i++)
+		{
+			if ((c[i] & 0xC0) != 0x80)
+				return 0;
+			codePoint = (codePoint << 6) | (c[i] & 0x3F);
+		}
+
+		if (codePoint < minimum || codePoint > 0x10FFFF ||
+			(codePoint >= 0xD800 && codePoint <= 0xDFFF))
+			return 0;
+		return length;
+	}
+
+	static inline char* EncodeUTF8(unsigned int codePoint, char* out)
+	{
+		if (codePoint < 0x80)
+		{
+			*out++ = (char) codePoint;
+		}
+		else if (codePoint < 0x800)
+		{
+			*out++ = (char) (0xC0 | (codePoint >> 6));
+			*out++ = (char) (0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			*out++ = (char) (0xE0 | (codePoint >> 12));
+			*out++ = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+			*out++ = (char) (0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			*out++ = (char) (0xF0 | (codePoint >> 18));
+			*out++ = (char) (0x80 | ((codePoint >> 12) & 0x3F));
+			*out++ = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+			*out++ = (char) (0x80 | (codePoint & 0x3F));
+		}
+		return out;
+	}
+
+	static inline char* EncodeUTF16LE(unsigned int unit, char* out)
+	{
+		*out++ = (char) (unit & 0xFF);
+		*out++ = (char) (unit >> 8);
+		return out;
+	}
+
+	static long AsciiPrefixScalar(const char* start, const char* end)
+	{
+		const char* c = start;
+		while (c < end && !(*c & 0x80))
+			c++;
+		return c - start;
+	}
+
+	static void Base64EncodeScalar(const char* start, const char* end, char* out)
+	{
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* inEnd = reinterpret_cast<const unsigned char*>(end);
+		for (; inEnd - in >= 3; in += 3, out += 4)
+		{
+			unsigned int quantum = (in[0] << 16) | (in[1] << 8) | in[2];
+			out[0] = base64Alphabet[quantum >> 18];
+			out[1] = base64Alphabet[(quantum >> 12) & 0x3F];
+			out[2] = base64Alphabet[(quantum >> 6) & 0x3F];
+			out[3] = base64Alphabet[quantum & 0x3F];
+		}
+
+		if (inEnd - in == 1)
+		{
+			out[0] = base64Alphabet[in[0] >> 2];
+			out[1] = base64Alphabet[(in[0] & 0x03) << 4];
+			out[2] = '=';
+			out[3] = '=';
+		}
+		else if (inEnd - in == 2)
+		{
+			out[0] = base64Alphabet[in[0] >> 2];
+			out[1] = base64Alphabet[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+			out[2] = base64Alphabet[(in[1] & 0x0F) << 2];
+			out[3] = '=';
+		}
+	}
+
+	static long Base64DecodeScalar(const char* start, const char* end, char* outStart)
+	{
+		char* out = outStart;
+		unsigned int quantum = 0;
+		int count = 0;
+		const char* c = start;
+		for (; c < end && *c != '='; c++)
+		{
+			if (IsSpace(*c))
+				continue;
+
+			int value = Base64Value(*c);
+			if (value < 0)
+				return -1;
+
+			quantum = (quantum << 6) | value;
+			if (++count == 4)
+			{
+				out[0] = (char) (quantum >> 16);
+				out[1] = (char) (quantum >> 8);
+				out[2] = (char) quantum;
+				out += 3;
+				quantum = 0;
+				count = 0;
+			}
+		}
+
+		// Only padding and whitespace may follow the first padding character.
+		for (; c < end; c++)
+		{
+			if (*c != '=' && !IsSpace(*c))
+				return -1;
+		}
+
+		if (count == 1)
+		{
+			return -1;
+		}
+		else if (count == 2)
+		{
+			*out++ = (char) (quantum >> 4);
+		}
+		else if (count == 3)
+		{
+			*out++ = (char) (quantum >> 10);
+			*out++ = (char) (quantum >> 2);
+		}
+		return out - outStart;
+	}
+
+	static void HexEncodeScalar(const char* start, const char* end, char* out)
+	{
+		for (const char* c = start; c < end; c++)
+		{
+			unsigned char byte = *c;
+			*out++ = hexDigits[byte >> 4];
+			*out++ = hexDigits[byte & 0x0F];
+		}
+	}
+
+	static long HexDecodeScalar(const char* start, const char* end, char* out)
+	{
+		if ((end - start) % 2 != 0)
+			return -1;
+
+		for (const char* c = start; c < end; c += 2)
+		{
+			int high = HexValue(c[0]);
+			int low = HexValue(c[1]);
+			if (high < 0 || low < 0)
+				return -1;
+			*out++ = (char) ((high << 4) | low);
+		}
+		return (end - start) / 2;
+	}
+
+	static inline char FlipCase(char c, char first, char last)
+	{
+		return (c >= first && c <= last) ? (char) (c ^ 0x20) : c;
+	}
+
+	static void ToLowerASCIIScalar(const char* start, const char* end, char* out)
+	{
+		for (const char* c = start; c < end; c++)
+			*out++ = FlipCase(*c, 'A', 'Z');
+	}
+
+	static void ToUpperASCIIScalar(const char* start, const char* end, char* out)
+	{
+		for (const char* c = start; c < end; c++)
+			*out++ = FlipCase(*c, 'a', 'z');
+	}
+
+#ifdef KROLL_HAVE_SSE2
+	static const char* FindSSE2(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		const __m128i first = _mm_set1_epi8(needle[0]);
+		const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+		const char* candidatesEnd = end - needleLength + 1;
+		const char* block = start;
+		for (; candidatesEnd - block >= 16; block += 16)
+		{
+			__m128i firstMatches = _mm_cmpeq_epi8(first,
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+			__m128i lastMatches = _mm_cmpeq_epi8(last,
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + needleLength - 1)));
+			unsigned int mask = _mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+			while (mask)
+			{
+				const char* candidate = block + LowestBit(mask);
+				if (MiddleMatches(candidate, needle, needleLength))
+					return candidate;
+				mask &= mask - 1;
+			}
+		}
+		return FindScalar(block, end, needle, needleLength);
+	}
+
+	static const char* FindLastSSE2(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		const __m128i first = _mm_set1_epi8(needle[0]);
+		const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+		const char* block = end - needleLength + 1;
+		while (block - start >= 16)
+		{
+			block -= 16;
+			__m128i firstMatches = _mm_cmpeq_epi8(first,
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+			__m128i lastMatches = _mm_cmpeq_epi8(last,
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + needleLength - 1)));
+			unsigned int mask = _mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+			while (mask)
+			{
+				int bit = HighestBit(mask);
+				if (MiddleMatches(block + bit, needle, needleLength))
+					return block + bit;
+				mask &= ~(1u << bit);
+			}
+		}
+		return FindLastScalar(start, block + needleLength - 1, needle, needleLength);
+	}
+
+	static long AsciiPrefixSSE2(const char* start, const char* end)
+	{
+		const char* c = start;
+		for (; end - c >= 16; c += 16)
+		{
+			unsigned int mask = _mm_movemask_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(c)));
+			if (mask)
+				return c - start + LowestBit(mask);
+		}
+		return c - start + AsciiPrefixScalar(c, end);
+	}
+
+	static inline __m128i HexDigitsSSE2(__m128i nibbles)
+	{
+		__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+			_mm_set1_epi8('a' - '0' - 10));
+		return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+	}
+
+	static void HexEncodeSSE2(const char* start, const char* end, char* out)
+	{
+		const __m128i lowNibble = _mm_set1_epi8(0x0F);
+		const char* c = start;
+		for (; end - c >= 16; c += 16, out += 32)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+			__m128i high = HexDigitsSSE2(_mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble));
+			__m128i low = HexDigitsSSE2(_mm_and_si128(bytes, lowNibble));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+		}
+		HexEncodeScalar(c, end, out);
+	}
+
+	// Turn 16 hex digits into 8 bytes, each in the low half of a 16-bit
+	// lane. Lanes holding anything but hex digits are flagged in invalid.
+	static inline __m128i HexValuesSSE2(__m128i digits, __m128i& valid)
+	{
+		__m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8('0' - 1)),
+			_mm_cmplt_epi8(digits, _mm_set1_epi8('9' + 1)));
+		__m128i lower = _mm_or_si128(digits, _mm_set1_epi8(0x20));
+		__m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+			_mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+		valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isLetter));
+
+		__m128i values = _mm_or_si128(
+			_mm_and_si128(isDigit, _mm_sub_epi8(digits, _mm_set1_epi8('0'))),
+			_mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+
+		// The first digit of each pair is the high nibble.
+		__m128i high = _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4);
+		return _mm_or_si128(high, _mm_srli_epi16(values, 8));
+	}
+
+	static long HexDecodeSSE2(const char* start, const char* end, char* out)
+	{
+		if ((end - start) % 2 != 0)
+			return -1;
+
+		const char* c = start;
+		for (; end - c >= 32; c += 32, out += 16)
+		{
+			__m128i valid = _mm_set1_epi8(-1);
+			__m128i first = HexValuesSSE2(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(c)), valid);
+			__m128i second = HexValuesSSE2(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(c + 16)), valid);
+			if (_mm_movemask_epi8(valid) != 0xFFFF)
+				return -1;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(first, second));
+		}
+
+		if (HexDecodeScalar(c, end, out) < 0)
+			return -1;
+		return (end - start) / 2;
+	}
+
+	// Letters only differ from their other case in bit 5. Bytes above
+	// 0x7F are negative in the signed comparisons, so they never match.
+	static inline __m128i FlipCaseSSE2(__m128i characters, char first, char last)
+	{
+		__m128i inRange = _mm_and_si128(
+			_mm_cmpgt_epi8(characters, _mm_set1_epi8(first - 1)),
+			_mm_cmplt_epi8(characters, _mm_set1_epi8(last + 1)));
+		return _mm_xor_si128(characters, _mm_and_si128(inRange, _mm_set1_epi8(0x20)));
+	}
+
+	static void ToLowerASCIISSE2(const char* start, const char* end, char* out)
+	{
+		const char* c = start;
+		for (; end - c >= 16; c += 16, out += 16)
+		{
+			__m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+				FlipCaseSSE2(characters, 'A', 'Z'));
+		}
+		ToLowerASCIIScalar(c, end, out);
+	}
+
+	static void ToUpperASCIISSE2(const char* start, const char* end, char* out)
+	{
+		const char* c = start;
+		for (; end - c >= 16; c += 16, out += 16)
+		{
+			__m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+				FlipCaseSSE2(characters, 'a', 'z'));
+		}
+		ToUpperASCIIScalar(c, end, out);
+	}
+#endif
+
+#ifdef KROLL_HAVE_AVX2
+	KROLL_TARGET_AVX2
+	static const char* FindAVX2(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		const __m256i first = _mm256_set1_epi8(needle[0]);
+		const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+		const char* candidatesEnd = end - needleLength + 1;
+		const char* block = start;
+		for (; candidatesEnd - block >= 32; block += 32)
+		{
+			__m256i firstMatches = _mm256_cmpeq_epi8(first,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)));
+			__m256i lastMatches = _mm256_cmpeq_epi8(last,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + needleLength - 1)));
+			unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+				_mm256_and_si256(firstMatches, lastMatches));
+			while (mask)
+			{
+				const char* candidate = block + LowestBit(mask);
+				if (MiddleMatches(candidate, needle, needleLength))
+					return candidate;
+				mask &= mask - 1;
+			}
+		}
+		return FindSSE2(block, end, needle, needleLength);
+	}
+
+	KROLL_TARGET_AVX2
+	static const char* FindLastAVX2(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		const __m256i first = _mm256_set1_epi8(needle[0]);
+		const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+		const char* block = end - needleLength + 1;
+		while (block - start >= 32)
+		{
+			block -= 32;
+			__m256i firstMatches = _mm256_cmpeq_epi8(first,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)));
+			__m256i lastMatches = _mm256_cmpeq_epi8(last,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + needleLength - 1)));
+			unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+				_mm256_and_si256(firstMatches, lastMatches));
+			while (mask)
+			{
+				int bit = HighestBit(mask);
+				if (MiddleMatches(block + bit, needle, needleLength))
+					return block + bit;
+				mask &= ~(1u << bit);
+			}
+		}
+		return FindLastSSE2(start, block + needleLength - 1, needle, needleLength);
+	}
+
+	KROLL_TARGET_AVX2
+	static long AsciiPrefixAVX2(const char* start, const char* end)
+	{
+		const char* c = start;
+		for (; end - c >= 32; c += 32)
+		{
+			unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(c)));
+			if (mask)
+				return c - start + LowestBit(mask);
+		}
+		return c - start + AsciiPrefixSSE2(c, end);
+	}
+
+	/**
+	 * Base64 with AVX2 after Muła and Lemire, "Faster Base64 Encoding and
+	 * Decoding Using AVX2 Instructions". Each 128-bit lane encodes 12
+	 * bytes: a shuffle spreads every 3 bytes over 4, multiplies move the
+	 * 6-bit fields into place and a small table maps them to characters.
+	 */
+	KROLL_TARGET_AVX2
+	static void Base64EncodeAVX2(const char* start, const char* end, char* out)
+	{
+		const __m256i spread = _mm256_setr_epi8(
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+		const __m256i offsets = _mm256_setr_epi8(
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+
+		// Each lane loads 16 bytes to use 12 of them.
+		const char* c = start;
+		for (; end - c >= 28; c += 24, out += 32)
+		{
+			__m256i input = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(c))),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(c + 12)), 1);
+			input = _mm256_shuffle_epi8(input, spread);
+
+			__m256i high = _mm256_mulhi_epu16(
+				_mm256_and_si256(input, _mm256_set1_epi32(0x0FC0FC00)),
+				_mm256_set1_epi32(0x04000040));
+			__m256i low = _mm256_mullo_epi16(
+				_mm256_and_si256(input, _mm256_set1_epi32(0x003F03F0)),
+				_mm256_set1_epi32(0x01000010));
+			__m256i values = _mm256_or_si256(high, low);
+
+			__m256i ranges = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+			ranges = _mm256_sub_epi8(ranges, _mm256_cmpgt_epi8(values, _mm256_set1_epi8(25)));
+			__m256i characters = _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, ranges));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), characters);
+		}
+		Base64EncodeScalar(c, end, out);
+	}
+
+	KROLL_TARGET_AVX2
+	static long Base64DecodeAVX2(const char* start, const char* end, char* outStart)
+	{
+		// Every valid character has disjoint bits in the tables for its
+		// high and low nibble, so a non-zero AND flags invalid input.
+		const __m256i lowTable = _mm256_setr_epi8(
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m256i highTable = _mm256_setr_epi8(
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m256i shiftTable = _mm256_setr_epi8(
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i slash = _mm256_set1_epi8(0x2F);
+		const __m256i pack = _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+		// Each block stores 32 bytes to write 24. Leaving 16 characters
+		// for the scalar tail keeps the extra 8 within the output buffer,
+		// and keeps any padding out of the vector loop.
+		char* out = outStart;
+		const char* c = start;
+		for (; end - c >= 48; c += 32, out += 24)
+		{
+			__m256i characters = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c));
+			__m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(characters, 4), slash);
+			__m256i lowNibbles = _mm256_and_si256(characters, slash);
+			__m256i high = _mm256_shuffle_epi8(highTable, highNibbles);
+			__m256i low = _mm256_shuffle_epi8(lowTable, lowNibbles);
+
+			// Whitespace and anything else unusual goes to the scalar decoder.
+			if (!_mm256_testz_si256(low, high))
+				break;
+
+			__m256i shift = _mm256_shuffle_epi8(shiftTable,
+				_mm256_add_epi8(_mm256_cmpeq_epi8(characters, slash), highNibbles));
+			__m256i values = _mm256_add_epi8(characters, shift);
+
+			__m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+			__m256i quanta = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+			__m256i bytes = _mm256_shuffle_epi8(quanta, pack);
+			bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), bytes);
+		}
+
+		long tail = Base64DecodeScalar(c, end, out);
+		if (tail < 0)
+			return -1;
+		return out - outStart + tail;
+	}
+
+	KROLL_TARGET_AVX2
+	static inline __m256i FlipCaseAVX2(__m256i characters, char first, char last)
+	{
+		__m256i inRange = _mm256_and_si256(
+			_mm256_cmpgt_epi8(characters, _mm256_set1_epi8(first - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(last + 1), characters));
+		return _mm256_xor_si256(characters, _mm256_and_si256(inRange, _mm256_set1_epi8(0x20)));
+	}
+
+	KROLL_TARGET_AVX2
+	static void ToLowerASCIIAVX2(const char* start, const char* end, char* out)
+	{
+		const char* c = start;
+		for (; end - c >= 32; c += 32, out += 32)
+		{
+			__m256i characters = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+				FlipCaseAVX2(characters, 'A', 'Z'));
+		}
+		ToLowerASCIISSE2(c, end, out);
+	}
+
+	KROLL_TARGET_AVX2
+	static void ToUpperASCIIAVX2(const char* start, const char* end, char* out)
+	{
+		const char* c = start;
+		for (; end - c >= 32; c += 32, out += 32)
+		{
+			__m256i characters = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+				FlipCaseAVX2(characters, 'a', 'z'));
+		}
+		ToUpperASCIISSE2(c, end, out);
+	}
+
+	static void Cpuid(unsigned int leaf, unsigned int registers[4])
+	{
+#ifdef _MSC_VER
+		int values[4];
+		__cpuidex(values, leaf, 0);
+		for (int i = 0; i < 4; i++)
+			registers[i] = (unsigned int) values[i];
+#else
+		__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	static bool CPUSupportsAVX2()
+	{
+		unsigned int registers[4];
+		Cpuid(0, registers);
+		if (registers[0] < 7)
+			return false;
+
+		// The OS must also save the YMM registers on context switches.
+		Cpuid(1, registers);
+		bool osxsave = (registers[2] & (1u << 27)) != 0;
+		bool avx = (registers[2] & (1u << 28)) != 0;
+		if (!osxsave || !avx)
+			return false;
+
+#ifdef _MSC_VER
+		unsigned long long xcr0 = _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+		unsigned long long xcr0 = ((unsigned long long) edx << 32) | eax;
+#endif
+		if ((xcr0 & 6) != 6)
+			return false;
+
+		Cpuid(7, registers);
+		return (registers[1] & (1u << 5)) != 0;
+	}
+#endif
+
+	// Selecting twice from different threads is harmless, since both
+	// arrive at the same kernels. The search kernel is stored last, as
+	// it is the one which is checked.
+	static SearchKernel findKernel = 0;
+	static SearchKernel findLastKernel = 0;
+	static PrefixKernel asciiPrefixKernel = AsciiPrefixScalar;
+	static EncodeKernel base64EncodeKernel = Base64EncodeScalar;
+	static DecodeKernel base64DecodeKernel = Base64DecodeScalar;
+	static EncodeKernel hexEncodeKernel = HexEncodeScalar;
+	static DecodeKernel hexDecodeKernel = HexDecodeScalar;
+	static EncodeKernel toLowerKernel = ToLowerASCIIScalar;
+	static EncodeKernel toUpperKernel = ToUpperASCIIScalar;
+	static const char* instructionSet = "scalar";
+
+	static void SelectKernels()
+	{
+		SearchKernel find = FindScalar;
+		SearchKernel findLast = FindLastScalar;
+		const char* name = "scalar";
+#ifdef KROLL_HAVE_SSE2
+		find = FindSSE2;
+		findLast = FindLastSSE2;
+		asciiPrefixKernel = AsciiPrefixSSE2;
+		hexEncodeKernel = HexEncodeSSE2;
+		hexDecodeKernel = HexDecodeSSE2;
+		toLowerKernel = ToLowerASCIISSE2;
+		toUpperKernel = ToUpperASCIISSE2;
+		name = "sse2";
+#endif
+#ifdef KROLL_HAVE_AVX2
+		if (CPUSupportsAVX2())
+		{
+			find = FindAVX2;
+			findLast = FindLastAVX2;
+			asciiPrefixKernel = AsciiPrefixAVX2;
+			base64EncodeKernel = Base64EncodeAVX2;
+			base64DecodeKernel = Base64DecodeAVX2;
+			toLowerKernel = ToLowerASCIIAVX2;
+			toUpperKernel = ToUpperASCIIAVX2;
+			name = "avx2";
+		}
+#endif
+		instructionSet = name;
+		findLastKernel = findLast;
+		findKernel = find;
+	}
+
+	static inline void EnsureKernels()
+	{
+		if (!findKernel)
+			SelectKernels();
+	}
+
+	const char* Find(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		if (needleLength <= 0)
+			return start;
+		if (end - start < needleLength)
+			return 0;
+		if (needleLength > TWO_WAY_THRESHOLD)
+			return TwoWayFind(start, end, needle, needleLength);
+
+		EnsureKernels();
+		return findKernel(start, end, needle, needleLength);
+	}
+
+	const char* FindLast(const char* start, const char* end,
+		const char* needle, long needleLength)
+	{
+		if (needleLength <= 0)
+			return end;
+		if (end - start < needleLength)
+			return 0;
+
+		EnsureKernels();
+		return findLastKernel(start, end, needle, needleLength);
+	}
+
+	long Base64EncodedLength(long length)
+	{
+		return (length + 2) / 3 * 4;
+	}
+
+	void Base64Encode(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		base64EncodeKernel(start, end, out);
+	}
+
+	long Base64DecodedLength(long length)
+	{
+		return length / 4 * 3 + 3;
+	}
+
+	long Base64Decode(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		return base64DecodeKernel(start, end, out);
+	}
+
+	void HexEncode(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		hexEncodeKernel(start, end, out);
+	}
+
+	long HexDecode(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		return hexDecodeKernel(start, end, out);
+	}
+
+	// The UTF-8 routines skip runs of ASCII with the vector kernels and
+	// only decode the sequences in between one at a time.
+	const char* FindInvalidUTF8(const char* start, const char* end)
+	{
+		EnsureKernels();
+		const unsigned char* c = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* inEnd = reinterpret_cast<const unsigned char*>(end);
+		while (c < inEnd)
+		{
+			c += asciiPrefixKernel(reinterpret_cast<const char*>(c), end);
+			while (c < inEnd && *c >= 0x80)
+			{
+				unsigned int codePoint;
+				int length = DecodeUTF8(c, inEnd, codePoint);
+				if (!length)
+					return reinterpret_cast<const char*>(c);
+				c += length;
+			}
+		}
+		return 0;
+	}
+
+	long Latin1ToUTF8(const char* start, const char* end, char* outStart)
+	{
+		EnsureKernels();
+		char* out = outStart;
+		const char* c = start;
+		while (c < end)
+		{
+			long ascii = asciiPrefixKernel(c, end);
+			memcpy(out, c, ascii);
+			out += ascii;
+			c += ascii;
+			for (; c < end && (*c & 0x80); c++)
+				out = EncodeUTF8(static_cast<unsigned char>(*c), out);
+		}
+		return out - outStart;
+	}
+
+	long UTF8ToLatin1(const char* start, const char* end, char* outStart)
+	{
+		EnsureKernels();
+		char* out = outStart;
+		const unsigned char* c = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* inEnd = reinterpret_cast<const unsigned char*>(end);
+		while (c < inEnd)
+		{
+			long ascii = asciiPrefixKernel(reinterpret_cast<const char*>(c), end);
+			memcpy(out, c, ascii);
+			out += ascii;
+			c += ascii;
+			while (c < inEnd && *c >= 0x80)
+			{
+				unsigned int codePoint;
+				int length = DecodeUTF8(c, inEnd, codePoint);
+				if (!length || codePoint > 0xFF)
+					return -1;
+				*out++ = (char) codePoint;
+				c += length;
+			}
+		}
+		return out - outStart;
+	}
+
+	long UTF16LEToUTF8(const char* start, const char* end, char* outStart)
+	{
+		if ((end - start) % 2 != 0)
+			return -1;
+
+		char* out = outStart;
+		const unsigned char* c = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* inEnd = reinterpret_cast<const unsigned char*>(end);
+		while (c < inEnd)
+		{
+			unsigned int codePoint = c[0] | (c[1] << 8);
+			c += 2;
+			if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+			{
+				if (c == inEnd)
+					return -1;
+				unsigned int trail = c[0] | (c[1] << 8);
+				if (trail < 0xDC00 || trail > 0xDFFF)
+					return -1;
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (trail - 0xDC00);
+				c += 2;
+			}
+			else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+			{
+				return -1;
+			}
+			out = EncodeUTF8(codePoint, out);
+		}
+		return out - outStart;
+	}
+
+	long UTF8ToUTF16LE(const char* start, const char* end, char* outStart)
+	{
+		EnsureKernels();
+		char* out = outStart;
+		const unsigned char* c = reinterpret_cast<const unsigned char*>(start);
+		const unsigned char* inEnd = reinterpret_cast<const unsigned char*>(end);
+		while (c < inEnd)
+		{
+			long ascii = asciiPrefixKernel(reinterpret_cast<const char*>(c), end);
+			for (const unsigned char* asciiEnd = c + ascii; c < asciiEnd; c++)
+			{
+				*out++ = (char) *c;
+				*out++ = 0;
+			}
+
+			while (c < inEnd && *c >= 0x80)
+			{
+				unsigned int codePoint;
+				int length = DecodeUTF8(c, inEnd, codePoint);
+				if (!length)
+					return -1;
+				if (codePoint >= 0x10000)
+				{
+					codePoint -= 0x10000;
+					out = EncodeUTF16LE(0xD800 | (codePoint >> 10), out);
+					out = EncodeUTF16LE(0xDC00 | (codePoint & 0x3FF), out);
+				}
+				else
+				{
+					out = EncodeUTF16LE(codePoint, out);
+				}
+				c += length;
+			}
+		}
+		return out - outStart;
+	}
+
+	void ToLowerASCII(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		toLowerKernel(start, end, out);
+	}
+
+	void ToUpperASCII(const char* start, const char* end, char* out)
+	{
+		EnsureKernels();
+		toUpperKernel(start, end, out);
+	}
+
+	const char* GetInstructionSet()
+	{
+		EnsureKernels();
+		return instructionSet;
+	}
+}
+}
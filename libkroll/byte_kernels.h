@@ -0,0 +1,104 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_BYTE_KERNELS_H_
+#define _KR_BYTE_KERNELS_H_
+
+namespace kroll
+{
+	/**
+	 * Vectorized routines over raw byte ranges, used by Bytes. Every kernel
+	 * has a scalar version and, on x86, SSE2 and AVX2 versions. The best
+	 * one the CPU supports is picked the first time a kernel is used.
+	 * Ranges are binary: NUL bytes have no special meaning.
+	 */
+	namespace ByteKernels
+	{
+		/**
+		 * @return the first occurrence of needle in [start, end), start
+		 * for an empty needle, or NULL if there is none
+		 */
+		KROLL_API const char* Find(const char* start, const char* end,
+			const char* needle, long needleLength);
+
+		/**
+		 * @return the last occurrence of needle in [start, end), end for
+		 * an empty needle, or NULL if there is none
+		 */
+		KROLL_API const char* FindLast(const char* start, const char* end,
+			const char* needle, long needleLength);
+
+		/**
+		 * @return the number of characters Base64Encode writes for
+		 * length bytes
+		 */
+		KROLL_API long Base64EncodedLength(long length);
+
+		/**
+		 * Encode [start, end) as padded base64 with the standard alphabet.
+		 */
+		KROLL_API void Base64Encode(const char* start, const char* end, char* out);
+
+		/**
+		 * @return the most bytes Base64Decode may write for length
+		 * characters. The output buffer must be at least this long.
+		 */
+		KROLL_API long Base64DecodedLength(long length);
+
+		/**
+		 * Decode base64 with the standard alphabet. Whitespace is skipped
+		 * and padding is optional.
+		 * @return the number of bytes written or -1 if the input is invalid
+		 */
+		KROLL_API long Base64Decode(const char* start, const char* end, char* out);
+
+		/**
+		 * Encode [start, end) as lower case hex, writing two characters
+		 * for every byte.
+		 */
+		KROLL_API void HexEncode(const char* start, const char* end, char* out);
+
+		/**
+		 * Decode hex digits of either case, writing half as many bytes.
+		 * @return the number of bytes written or -1 if the input is invalid
+		 */
+		KROLL_API long HexDecode(const char* start, const char* end, char* out);
+
+		/**
+		 * @return the start of the first malformed, overlong, surrogate or
+		 * truncated sequence in [start, end), or NULL if it is valid UTF-8
+		 */
+		KROLL_API const char* FindInvalidUTF8(const char* start, const char* end);
+
+		/**
+		 * The transcoders write to a buffer which is large enough for the
+		 * worst case: twice the input for Latin1ToUTF8 and UTF8ToUTF16LE,
+		 * the input length for UTF8ToLatin1 and one and a half times it
+		 * for UTF16LEToUTF8. Invalid input, including code points which
+		 * Latin-1 cannot represent and unpaired surrogates, is an error.
+		 * @return the number of bytes written or -1 on an error
+		 */
+		KROLL_API long Latin1ToUTF8(const char* start, const char* end, char* out);
+		KROLL_API long UTF8ToLatin1(const char* start, const char* end, char* out);
+		KROLL_API long UTF16LEToUTF8(const char* start, const char* end, char* out);
+		KROLL_API long UTF8ToUTF16LE(const char* start, const char* end, char* out);
+
+		/**
+		 * Convert the ASCII letters in [start, end) to lower or upper case,
+		 * writing the result to out, which may be start itself. All other
+		 * bytes are copied unchanged.
+		 */
+		KROLL_API void ToLowerASCII(const char* start, const char* end, char* out);
+		KROLL_API void ToUpperASCII(const char* start, const char* end, char* out);
+
+		/**
+		 * @return the name of the instruction set the kernels use:
+		 * "scalar", "sse2" or "avx2"
+		 */
+		KROLL_API const char* GetInstructionSet();
+	}
+}
+
+#endif
@@ -0,0 +1,488 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <set>
+#include <algorithm>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/Timer.h>
+#include <Poco/Timestamp.h>
+
+#define CYCLE_COLLECTOR_SLICE 64
+#define CYCLE_COLLECTOR_HISTORY 32
+
+namespace kroll
+{
+	struct Participant
+	{
+		CycleCollectable* collectable;
+		KObjectRef object;
+		int references;
+		bool root;
+		std::vector<size_t> edges;
+	};
+
+	class CollectorTimer
+	{
+		public:
+		void OnTimer(Poco::Timer& timer);
+	};
+
+	static Poco::Mutex registryMutex;
+	static std::set<CycleCollectable*> registry;
+	static std::vector<CycleCollectorHeap*> heaps;
+
+	// The state of the current pass is only touched on the main thread.
+	static std::vector<Participant> participants;
+	static std::map<KObject*, size_t> participantIndex;
+	static std::vector<size_t> heldByWrappers;
+	static size_t nextToTraverse = 0;
+	static bool passActive = false;
+	static Poco::Timestamp::TimeDiff passTime = 0;
+
+	// Only the main thread changes the statistics, but scripts may read
+	// them from any thread.
+	static Poco::Mutex statisticsMutex;
+	static CycleCollectorStatistics statistics;
+
+	static Poco::Mutex timerMutex;
+	static Poco::Timer* timer = 0;
+	static CollectorTimer timerTarget;
+	static bool stepScheduled = false;
+	static LoggerHandle logger = { "CycleCollector" };
+
+	volatile bool CycleCollector::enabled = false;
+
+	CycleCollectorTraversal::CycleCollectorTraversal(std::vector<KObject*>& edges) :
+		edges(edges)
+	{
+	}
+
+	void CycleCollectorTraversal::NoteValue(Value* value)
+	{
+		if (!value || value->referenceCount() != 1)
+			return;
+
+		if (value->IsMethod())
+			edges.push_back(value->ToMethod().get());
+		else if (value->IsList())
+			edges.push_back(value->ToList().get());
+		else if (value->IsObject())
+			edges.push_back(value->ToObject().get());
+	}
+
+	/*static*/
+	void CycleCollector::Add(CycleCollectable* collectable)
+	{
+		if (!enabled)
+			return;
+
+		Poco::Mutex::ScopedLock lock(registryMutex);
+		registry.insert(collectable);
+	}
+
+	/*static*/
+	void CycleCollector::Remove(CycleCollectable* collectable)
+	{
+		Poco::Mutex::ScopedLock lock(registryMutex);
+		registry.erase(collectable);
+	}
+
+	/*static*/
+	void CycleCollector::AddHeap(CycleCollectorHeap* heap)
+	{
+		Poco::Mutex::ScopedLock lock(registryMutex);
+		heaps.push_back(heap);
+	}
+
+	static void StartPass()
+	{
+		Poco::Mutex::ScopedLock lock(registryMutex);
+		std::set<CycleCollectable*>::iterator i = registry.begin();
+		while (i != registry.end())
+		{
+			// Objects which are already being destroyed can't be revived.
+			// Their destructors wait for registryMutex in Remove, so they
+			// are still in one piece here. Going through a KWeakRef instead
+			// would give every tracked object a control block for the rest
+			// of its life.
+			CycleCollectable* collectable = *i++;
+			KObject* candidate = collectable->GetCollectableObject();
+			if (!candidate->TryDuplicate())
+				continue;
+			KObjectRef object(candidate);
+
+			Participant participant;
+			participant.collectable = collectable;
+			participant.object = object;
+			participant.references = 0;
+			participant.root = false;
+			participantIndex[object.get()] = participants.size();
+			participants.push_back(participant);
+		}
+
+		nextToTraverse = 0;
+		passTime = 0;
+		passActive = true;
+	}
+
+	static void MapEdges(std::vector<KObject*>& edges, std::vector<size_t>& indices)
+	{
+		indices.clear();
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			std::map<KObject*, size_t>::iterator found = participantIndex.find(edges[i]);
+			if (found != participantIndex.end())
+				indices.push_back(found->second);
+		}
+	}
+
+	static void TraverseParticipant(Participant& participant)
+	{
+		std::vector<KObject*> edges;
+		CycleCollectorTraversal traversal(edges);
+		participant.collectable->Traverse(traversal);
+		MapEdges(edges, participant.edges);
+
+		// The reference held by the pass itself does not count.
+		participant.references = participant.object->referenceCount() - 1;
+	}
+
+	static void TraverseWrappers()
+	{
+		std::vector<KObject*> edges;
+		CycleCollectorTraversal traversal(edges);
+		for (size_t i = 0; i < heaps.size(); i++)
+			heaps[i]->TraverseWrappers(traversal);
+		MapEdges(edges, heldByWrappers);
+	}
+
+	/**
+	 * Trial deletion over a subset of the participants: anything which has
+	 * references from outside the subset, or which is reachable from such
+	 * an object, is alive. Everything else only keeps itself alive. When
+	 * countWrappers is set, references from script wrappers count as
+	 * internal, because the heaps will settle them later.
+	 */
+	static void FindGarbage(const std::vector<size_t>& members,
+		bool countWrappers, std::vector<size_t>& garbage)
+	{
+		std::vector<char> inSubset(participants.size(), 0);
+		std::vector<char> alive(participants.size(), 0);
+		std::vector<int> internal(participants.size(), 0);
+		for (size_t i = 0; i < members.size(); i++)
+			inSubset[members[i]] = 1;
+
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			std::vector<size_t>& edges = participants[members[i]].edges;
+			for (size_t j = 0; j < edges.size(); j++)
+			{
+				if (inSubset[edges[j]])
+					internal[edges[j]]++;
+			}
+		}
+
+		for (size_t i = 0; countWrappers && i < heldByWrappers.size(); i++)
+		{
+			if (inSubset[heldByWrappers[i]])
+				internal[heldByWrappers[i]]++;
+		}
+
+		std::vector<size_t> stack;
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			Participant& participant = participants[members[i]];
+			if (participant.root || participant.references > internal[members[i]])
+			{
+				alive[members[i]] = 1;
+				stack.push_back(members[i]);
+			}
+		}
+
+		while (!stack.empty())
+		{
+			std::vector<size_t>& edges = participants[stack.back()].edges;
+			stack.pop_back();
+			for (size_t j = 0; j < edges.size(); j++)
+			{
+				if (inSubset[edges[j]] && !alive[edges[j]])
+				{
+					alive[edges[j]] = 1;
+					stack.push_back(edges[j]);
+				}
+			}
+		}
+
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			if (!alive[members[i]])
+				garbage.push_back(members[i]);
+		}
+	}
+
+	/**
+	 * Find the members of heap which are reachable from a garbage object
+	 * through the edges between garbage objects.
+	 */
+	static void FindReachable(size_t start, CycleCollectorHeap* heap,
+		const std::vector<char>& isGarbage, std::vector<CycleCollectable*>& found)
+	{
+		std::vector<char> visited(participants.size(), 0);
+		std::vector<size_t> stack(1, start);
+		visited[start] = 1;
+		while (!stack.empty())
+		{
+			Participant& participant = participants[stack.back()];
+			stack.pop_back();
+			if (participant.collectable->GetHeap() == heap)
+				found.push_back(participant.collectable);
+
+			for (size_t j = 0; j < participant.edges.size(); j++)
+			{
+				size_t next = participant.edges[j];
+				if (isGarbage[next] && !visited[next])
+				{
+					visited[next] = 1;
+					stack.push_back(next);
+				}
+			}
+		}
+	}
+
+	static void CollectWithHeaps(std::vector<size_t>& garbage)
+	{
+		std::map<CycleCollectorHeap*, std::vector<CycleCollectable*> > members;
+		for (size_t i = 0; i < garbage.size(); i++)
+		{
+			CycleCollectable* collectable = participants[garbage[i]].collectable;
+			CycleCollectorHeap* heap = collectable->GetHeap();
+			if (heap)
+				members[heap].push_back(collectable);
+		}
+
+		std::vector<char> isGarbage(participants.size(), 0);
+		for (size_t i = 0; i < garbage.size(); i++)
+			isGarbage[garbage[i]] = 1;
+
+		std::vector<CycleCollectable*> survivors;
+		std::map<CycleCollectorHeap*, std::vector<CycleCollectable*> >::iterator i =
+			members.begin();
+		while (i != members.end())
+		{
+			// The heap cannot see the edges which run through Kroll and the
+			// other heaps, so hand it the part of the graph which its
+			// wrappers lead into.
+			std::map<KObject*, std::vector<CycleCollectable*> > reachable;
+			for (size_t j = 0; j < heldByWrappers.size(); j++)
+			{
+				size_t held = heldByWrappers[j];
+				KObject* object = participants[held].object.get();
+				if (isGarbage[held] && reachable.find(object) == reachable.end())
+					FindReachable(held, i->first, isGarbage, reachable[object]);
+			}
+
+			i->first->Collect(i->second, reachable, survivors);
+			i++;
+		}
+
+		std::set<CycleCollectable*> survived(survivors.begin(), survivors.end());
+		for (size_t i = 0; i < garbage.size(); i++)
+		{
+			if (survived.find(participants[garbage[i]].collectable) != survived.end())
+				participants[garbage[i]].root = true;
+		}
+	}
+
+	static void EndPass()
+	{
+		heldByWrappers.clear();
+		participantIndex.clear();
+		participants.clear();
+		nextToTraverse = 0;
+		passActive = false;
+	}
+
+	static void FinishPass()
+	{
+		std::vector<size_t> everything;
+		for (size_t i = 0; i < participants.size(); i++)
+			everything.push_back(i);
+
+		TraverseWrappers();
+		std::vector<size_t> candidates;
+		FindGarbage(everything, true, candidates);
+
+		// The candidates were traversed over several main thread jobs, so
+		// the heaps may have changed since. Traverse them again in one go
+		// and only trust the edges within this subset.
+		for (size_t i = 0; i < candidates.size(); i++)
+			TraverseParticipant(participants[candidates[i]]);
+		TraverseWrappers();
+
+		std::vector<size_t> garbage;
+		FindGarbage(candidates, true, garbage);
+
+		// Running the heaps' collectors settles the references held by
+		// their wrappers: dead wrappers have dropped theirs by now and live
+		// ones are roots. Whatever is still garbage after that is certain.
+		std::vector<size_t> confirmed;
+		if (!garbage.empty())
+		{
+			CollectWithHeaps(garbage);
+			for (size_t i = 0; i < garbage.size(); i++)
+				TraverseParticipant(participants[garbage[i]]);
+			FindGarbage(garbage, false, confirmed);
+		}
+
+		for (size_t i = 0; i < confirmed.size(); i++)
+			participants[confirmed[i]].collectable->Unlink();
+
+		{
+			Poco::Mutex::ScopedLock lock(statisticsMutex);
+			statistics.passes++;
+			statistics.lastScanned = participants.size();
+			statistics.lastCandidates = candidates.size();
+			statistics.lastReclaimed = confirmed.size();
+			statistics.totalReclaimed += confirmed.size();
+			statistics.lastMilliseconds = passTime / 1000.0;
+			statistics.reclaimedPerPass.push_back(confirmed.size());
+			if (statistics.reclaimedPerPass.size() > CYCLE_COLLECTOR_HISTORY)
+				statistics.reclaimedPerPass.erase(statistics.reclaimedPerPass.begin());
+		}
+
+		// Dropping the references held by the pass is what actually
+		// destroys the unlinked objects.
+		EndPass();
+	}
+
+	/*static*/
+	bool CycleCollector::Step()
+	{
+		Poco::Timestamp start;
+		if (!passActive)
+			StartPass();
+
+		size_t end = std::min(nextToTraverse + CYCLE_COLLECTOR_SLICE, participants.size());
+		for (; nextToTraverse < end; nextToTraverse++)
+			TraverseParticipant(participants[nextToTraverse]);
+
+		if (nextToTraverse < participants.size())
+		{
+			passTime += start.elapsed();
+			return false;
+		}
+
+		// Record the time before the references are dropped, since
+		// destroying objects is not part of the collector's work.
+		passTime += start.elapsed();
+		FinishPass();
+		return true;
+	}
+
+	/*static*/
+	int CycleCollector::Collect()
+	{
+		while (!Step()) {}
+
+		logger->Debug(
+			"Pass %i: %i bridge objects, %i candidates, %i reclaimed in %.2fms",
+			statistics.passes, statistics.lastScanned, statistics.lastCandidates,
+			statistics.lastReclaimed, statistics.lastMilliseconds);
+		return statistics.lastReclaimed;
+	}
+
+	static KValueRef StepOnMainThread(const ValueList& args)
+	{
+		// A step which was queued before the collector was disabled must
+		// not start a new pass.
+		if (!CycleCollector::IsEnabled())
+		{
+			Poco::Mutex::ScopedLock lock(timerMutex);
+			stepScheduled = false;
+			return Value::Undefined;
+		}
+
+		bool complete = CycleCollector::Step();
+
+		Poco::Mutex::ScopedLock lock(timerMutex);
+		stepScheduled = false;
+		if (!complete && timer)
+		{
+			// Yield to other main thread jobs between slices.
+			stepScheduled = true;
+			RunOnMainThread(new KFunctionPtrMethod(&StepOnMainThread),
+				ValueList(), false);
+		}
+		else if (complete && statistics.lastReclaimed > 0)
+		{
+			logger->Debug("Reclaimed %i objects in %.2fms",
+				statistics.lastReclaimed, statistics.lastMilliseconds);
+		}
+		return Value::Undefined;
+	}
+
+	void CollectorTimer::OnTimer(Poco::Timer&)
+	{
+		Poco::Mutex::ScopedLock lock(timerMutex);
+		if (stepScheduled)
+			return;
+
+		stepScheduled = true;
+		RunOnMainThread(new KFunctionPtrMethod(&StepOnMainThread),
+			ValueList(), false);
+	}
+
+	/*static*/
+	bool CycleCollector::Enable(long interval)
+	{
+#ifdef KROLL_BIASED_REFCOUNT
+		// References which a thread counts privately can neither be read
+		// reliably nor revived without the owner's cooperation, so the
+		// collector would see every object as a root and collect nothing.
+		return false;
+#endif
+		Poco::Mutex::ScopedLock lock(timerMutex);
+		if (timer)
+			return true;
+
+		enabled = true;
+		timer = new Poco::Timer(interval, interval);
+		timer->start(Poco::TimerCallback<CollectorTimer>(
+			timerTarget, &CollectorTimer::OnTimer));
+		return true;
+	}
+
+	/*static*/
+	void CycleCollector::Disable()
+	{
+		Poco::Timer* stopping = 0;
+		{
+			Poco::Mutex::ScopedLock lock(timerMutex);
+			stopping = timer;
+			timer = 0;
+			enabled = false;
+		}
+
+		// Stopping waits for a running callback, which takes timerMutex.
+		if (stopping)
+		{
+			stopping->stop();
+			delete stopping;
+		}
+
+		// Release the objects held by an unfinished pass now, while the
+		// interpreters which own their wrappers are still running.
+		EndPass();
+	}
+
+	/*static*/
+	CycleCollectorStatistics CycleCollector::GetStatistics()
+	{
+		Poco::Mutex::ScopedLock lock(statisticsMutex);
+		return statistics;
+	}
+}
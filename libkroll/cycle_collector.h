@@ -0,0 +1,182 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_CYCLE_COLLECTOR_H_
+#define _KR_CYCLE_COLLECTOR_H_
+
+#include <vector>
+#include <map>
+
+namespace kroll
+{
+	class CycleCollectable;
+
+	/**
+	 * Receives the edges which a bridge object reports during a pass.
+	 */
+	class KROLL_API CycleCollectorTraversal
+	{
+		public:
+		CycleCollectorTraversal(std::vector<KObject*>& edges);
+
+		/**
+		 * Report that the traversed object keeps this value alive through
+		 * its foreign heap, and that nothing but the traversed object can
+		 * reach it there. Values which are also held elsewhere are ignored,
+		 * which conservatively keeps the object they contain alive.
+		 */
+		void NoteValue(Value* value);
+
+		private:
+		std::vector<KObject*>& edges;
+	};
+
+	/**
+	 * A script heap whose own collector has the final say on whether the
+	 * values pinned by a set of garbage candidates are still reachable.
+	 */
+	class KROLL_API CycleCollectorHeap
+	{
+		public:
+		virtual ~CycleCollectorHeap() {}
+
+		/**
+		 * Report the Kroll values which are kept alive by wrapper objects
+		 * in this heap. The collector treats these references as internal
+		 * until the heap has been asked to confirm.
+		 */
+		virtual void TraverseWrappers(CycleCollectorTraversal& traversal) = 0;
+
+		/**
+		 * Unpin the values of these candidates and let the heap collect
+		 * them. While doing so, every wrapper of an object in reachable must
+		 * keep alive the values of the candidates listed for that object.
+		 * Candidates whose values were collected must never touch them
+		 * again; those which survived must pin them again and be added to
+		 * survivors.
+		 */
+		virtual void Collect(std::vector<CycleCollectable*>& candidates,
+			std::map<KObject*, std::vector<CycleCollectable*> >& reachable,
+			std::vector<CycleCollectable*>& survivors) = 0;
+	};
+
+	/**
+	 * A Kroll object which pins a value in a foreign heap, such as a
+	 * JavaScript object or a Python callable. Implementations add
+	 * themselves to the CycleCollector at the end of their constructor
+	 * and remove themselves at the start of their destructor.
+	 */
+	class KROLL_API CycleCollectable
+	{
+		public:
+		CycleCollectable(KObject* self) : self(self) {}
+		virtual ~CycleCollectable() {}
+
+		/**
+		 * Report every Kroll value which is reachable from the pinned
+		 * foreign value, but not from the foreign heap's own roots.
+		 */
+		virtual void Traverse(CycleCollectorTraversal& traversal) = 0;
+
+		/**
+		 * Release the pinned foreign value. This is only called on objects
+		 * which nothing outside of a garbage cycle can reach.
+		 */
+		virtual void Unlink() = 0;
+
+		/**
+		 * @return the heap which must confirm that this object is garbage,
+		 * or NULL if its traversal already sees everything.
+		 */
+		virtual CycleCollectorHeap* GetHeap() { return 0; }
+
+		KObject* GetCollectableObject() { return self; }
+
+		private:
+		KObject* self;
+	};
+
+	struct KROLL_API CycleCollectorStatistics
+	{
+		int passes;
+		int lastScanned;
+		int lastCandidates;
+		int lastReclaimed;
+		int totalReclaimed;
+		double lastMilliseconds;
+		std::vector<int> reclaimedPerPass;
+	};
+
+	/**
+	 * An opt-in collector for reference cycles which run through more than
+	 * one script heap, for instance a JavaScript object holding a Python
+	 * callback which closes over that object. Neither heap's collector can
+	 * see through the Kroll reference counts, so they never free it.
+	 *
+	 * The collector only looks at bridge objects (CycleCollectable). A pass
+	 * snapshots them and traverses a few per main thread job, building the
+	 * graph of Kroll references which they keep alive through their foreign
+	 * heaps. Objects whose reference counts are fully explained by edges
+	 * from other bridge objects and script wrappers, and which no externally
+	 * referenced object reaches, are candidates. Those are traversed again
+	 * in one step to validate the result. Script heaps then run their own
+	 * collector to decide whether the candidates they pin are reachable, and
+	 * whatever is left after a final traversal is unlinked.
+	 *
+	 * The collector cannot read reference counts which a thread keeps
+	 * privately, so it is not available when libkroll is built with
+	 * KROLL_BIASED_REFCOUNT. Enable does nothing there and returns false.
+	 */
+	class KROLL_API CycleCollector
+	{
+		public:
+		/**
+		 * Track a bridge object. Objects created while the collector is
+		 * disabled are not tracked, which keeps everything they reach alive.
+		 */
+		static void Add(CycleCollectable* collectable);
+		static void Remove(CycleCollectable* collectable);
+		static void AddHeap(CycleCollectorHeap* heap);
+
+		/**
+		 * Start running a pass incrementally on the main thread, beginning
+		 * a new one every interval milliseconds. Does not log, so it may be
+		 * called before the logger is initialized.
+		 * @return false if the collector is not available in this build
+		 */
+		static bool Enable(long interval);
+
+		/**
+		 * Stop running passes and drop the references held by the pass in
+		 * progress, if any. This must be called on the main thread.
+		 */
+		static void Disable();
+		static bool IsEnabled() { return enabled; }
+
+		/**
+		 * Run a whole pass right away. This must be called on the main
+		 * thread.
+		 * @return the number of objects reclaimed
+		 */
+		static int Collect();
+
+		/**
+		 * Do the next slice of the current pass. This must be called on
+		 * the main thread.
+		 * @return true if the pass is complete
+		 */
+		static bool Step();
+
+		/**
+		 * May be called from any thread.
+		 */
+		static CycleCollectorStatistics GetStatistics();
+
+		private:
+		static volatile bool enabled;
+	};
+}
+
+#endif
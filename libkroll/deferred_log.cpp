@@ -0,0 +1,789 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/Thread.h>
+#include <Poco/Runnable.h>
+#include <Poco/Event.h>
+#include <Poco/Timestamp.h>
+
+#define DEFERRED_LOG_ALIGNMENT 8
+#define DEFERRED_LOG_MAX_STRING 4096
+#define DEFERRED_LOG_NULL_STRING 0xFFFFFFFF
+#define DEFERRED_LOG_DRAIN_INTERVAL 50
+
+namespace kroll
+{
+	enum ArgumentType
+	{
+		ARG_INT,
+		ARG_UNSIGNED,
+		ARG_CHAR,
+		ARG_DOUBLE,
+		ARG_STRING,
+		ARG_POINTER,
+		ARG_IGNORED_POINTER,
+		ARG_NONE
+	};
+
+	enum LengthModifier
+	{
+		LENGTH_NONE,
+		LENGTH_CHAR,
+		LENGTH_SHORT,
+		LENGTH_LONG,
+		LENGTH_LONG_LONG,
+		LENGTH_SIZE,
+		LENGTH_LONG_DOUBLE
+	};
+
+	/**
+	 * One conversion of a format string and the literal text before it.
+	 * The conversion is rewritten so that every integer is formatted from
+	 * a long long, which is how records store them.
+	 */
+	struct FormatSegment
+	{
+		std::string literal;
+		std::string conversion;
+		ArgumentType type;
+		LengthModifier length;
+		int stars;
+	};
+
+	struct ParsedFormat
+	{
+		unsigned int id;
+		std::vector<FormatSegment> segments;
+		std::string trailing;
+	};
+
+	struct RecordHeader
+	{
+		unsigned int size; // 0 marks the unused end of the buffer
+		unsigned int formatId;
+		Poco::Int64 time;
+		Logger* logger;
+		int level;
+	};
+
+	/**
+	 * The records of one thread, in a ring which only that thread writes
+	 * and only the drain reads. Empty when head and tail are equal.
+	 * Writing is set while the thread is recording, so that disabling
+	 * can wait for records which were started while still enabled.
+	 */
+	struct RecordBuffer
+	{
+		char* data;
+		size_t size;
+		volatile AtomicWord head;
+		volatile AtomicWord tail;
+		volatile AtomicWord orphaned;
+		volatile AtomicWord dropped;
+		volatile AtomicWord writing;
+	};
+
+	volatile bool DeferredLog::enabled = false;
+
+	static Poco::FastMutex formatsMutex;
+	static std::vector<ParsedFormat*> formats;
+	static Poco::FastMutex buffersMutex;
+	static std::vector<RecordBuffer*> buffers;
+	static Poco::FastMutex drainMutex;
+	static size_t bufferSize = 64 * 1024;
+	static Poco::Thread* drainThread = 0;
+	static Poco::Event drainEvent;
+	static volatile bool stopping = false;
+
+	static inline size_t Align(size_t size)
+	{
+		return (size + DEFERRED_LOG_ALIGNMENT - 1) & ~((size_t) DEFERRED_LOG_ALIGNMENT - 1);
+	}
+
+	static void ParseConversion(const char*& p, FormatSegment& segment)
+	{
+		const char* start = p++;
+		std::string spec("%");
+		while (*p && strchr("-+ #0'", *p))
+			spec += *p++;
+
+		segment.stars = 0;
+		if (*p == '*')
+		{
+			segment.stars++;
+			spec += *p++;
+		}
+		while (isdigit(*p))
+			spec += *p++;
+
+		if (*p == '.')
+		{
+			spec += *p++;
+			if (*p == '*')
+			{
+				segment.stars++;
+				spec += *p++;
+			}
+			while (isdigit(*p))
+				spec += *p++;
+		}
+
+		segment.length = LENGTH_NONE;
+		if (p[0] == 'h' && p[1] == 'h')
+		{
+			segment.length = LENGTH_CHAR;
+			p += 2;
+		}
+		else if (p[0] == 'l' && p[1] == 'l')
+		{
+			segment.length = LENGTH_LONG_LONG;
+			p += 2;
+		}
+		else if (p[0] == 'I' && p[1] == '6' && p[2] == '4')
+		{
+			segment.length = LENGTH_LONG_LONG;
+			p += 3;
+		}
+		else if (*p == 'h' || *p == 'l' || *p == 'q' || *p == 'j' ||
+			*p == 'z' || *p == 't' || *p == 'L')
+		{
+			switch (*p)
+			{
+				case 'h': segment.length = LENGTH_SHORT; break;
+				case 'l': segment.length = LENGTH_LONG; break;
+				case 'q': case 'j': segment.length = LENGTH_LONG_LONG; break;
+				case 'z': case 't': segment.length = LENGTH_SIZE; break;
+				case 'L': segment.length = LENGTH_LONG_DOUBLE; break;
+			}
+			p++;
+		}
+
+		char conversion = *p;
+		if (conversion)
+			p++;
+
+		switch (conversion)
+		{
+			case 'd': case 'i':
+				segment.type = ARG_INT;
+				segment.conversion = spec + "ll" + conversion;
+				break;
+			case 'u': case 'o': case 'x': case 'X':
+				segment.type = ARG_UNSIGNED;
+				segment.conversion = spec + "ll" + conversion;
+				break;
+			case 'c':
+				segment.type = ARG_CHAR;
+				segment.conversion = spec + conversion;
+				break;
+			case 'e': case 'E': case 'f': case 'F':
+			case 'g': case 'G': case 'a': case 'A':
+				segment.type = ARG_DOUBLE;
+				segment.conversion = spec + conversion;
+				break;
+			case 's':
+				// Wide strings are recorded by address only.
+				segment.type = segment.length == LENGTH_LONG ? ARG_POINTER : ARG_STRING;
+				segment.conversion = segment.type == ARG_STRING ? spec + "s" : "%p";
+				break;
+			case 'p':
+				segment.type = ARG_POINTER;
+				segment.conversion = spec + conversion;
+				break;
+			case 'n':
+				// Log messages never write back through their arguments.
+				segment.type = ARG_IGNORED_POINTER;
+				break;
+			default:
+				// Nothing is known about the arguments of an unknown
+				// conversion, so it is logged as it was written.
+				segment.type = ARG_NONE;
+				segment.literal.append(start, p - start);
+				break;
+		}
+	}
+
+	static ParsedFormat* ParseFormat(const char* format)
+	{
+		ParsedFormat* parsed = new ParsedFormat();
+		std::string literal;
+		const char* p = format;
+		while (*p)
+		{
+			if (*p != '%')
+			{
+				literal += *p++;
+				continue;
+			}
+			else if (p[1] == '%')
+			{
+				literal += '%';
+				p += 2;
+				continue;
+			}
+
+			FormatSegment segment;
+			segment.literal = literal;
+			literal.clear();
+			ParseConversion(p, segment);
+			parsed->segments.push_back(segment);
+		}
+		parsed->trailing = literal;
+		return parsed;
+	}
+
+	static ParsedFormat* RegisterFormat(LogFormat& format)
+	{
+		Poco::FastMutex::ScopedLock lock(formatsMutex);
+		if (!format.parsed)
+		{
+			ParsedFormat* parsed = ParseFormat(format.format);
+			formats.push_back(parsed);
+			parsed->id = (unsigned int) formats.size();
+
+			// Publish the parsed format only once it is complete.
+			AtomicCompareAndSwapPointer(&format.parsed, 0, parsed);
+		}
+		return static_cast<ParsedFormat*>(format.parsed);
+	}
+
+	// The drain frees the buffer of a thread which exited once it has
+	// formatted what is left in it.
+	static void OrphanRecordBuffer(void* data)
+	{
+		RecordBuffer* buffer = static_cast<RecordBuffer*>(data);
+		AtomicCompareAndSwap(&buffer->orphaned, 0, 1);
+	}
+
+	static ThreadLocal<RecordBuffer> threadBuffer = { &OrphanRecordBuffer };
+
+	static RecordBuffer* GetRecordBuffer()
+	{
+		RecordBuffer* buffer = threadBuffer.Get();
+		if (buffer)
+			return buffer;
+
+		buffer = static_cast<RecordBuffer*>(calloc(1, sizeof(RecordBuffer)));
+		buffer->size = Align(bufferSize);
+		buffer->data = static_cast<char*>(malloc(buffer->size));
+		threadBuffer.Set(buffer);
+
+		Poco::FastMutex::ScopedLock lock(buffersMutex);
+		buffers.push_back(buffer);
+		return buffer;
+	}
+
+	/**
+	 * Find room for a record of this size, or return NULL if the drain
+	 * has not caught up. The tail may never reach the head from behind,
+	 * because equal positions mean the buffer is empty.
+	 */
+	static char* ReserveRecord(RecordBuffer* buffer, size_t size, size_t& newTail)
+	{
+		size_t head = (size_t) buffer->head;
+		size_t tail = (size_t) buffer->tail;
+		if (tail >= head)
+		{
+			size_t room = buffer->size - tail;
+			if (size < room || (size == room && head != 0))
+			{
+				newTail = (tail + size) % buffer->size;
+				return buffer->data + tail;
+			}
+			else if (size < head)
+			{
+				// Mark the rest of the buffer as unused and start over.
+				reinterpret_cast<RecordHeader*>(buffer->data + tail)->size = 0;
+				newTail = size;
+				return buffer->data;
+			}
+		}
+		else if (tail + size < head)
+		{
+			newTail = tail + size;
+			return buffer->data + tail;
+		}
+		return 0;
+	}
+
+	static size_t MeasureRecord(ParsedFormat* parsed, va_list args)
+	{
+		size_t size = Align(sizeof(RecordHeader));
+		for (size_t i = 0; i < parsed->segments.size(); i++)
+		{
+			FormatSegment& segment = parsed->segments[i];
+			for (int star = 0; star < segment.stars; star++)
+			{
+				va_arg(args, int);
+				size += DEFERRED_LOG_ALIGNMENT;
+			}
+
+			switch (segment.type)
+			{
+				case ARG_STRING:
+				{
+					const char* string = va_arg(args, const char*);
+					size_t length = string ? strlen(string) : 0;
+					if (length > DEFERRED_LOG_MAX_STRING)
+						length = DEFERRED_LOG_MAX_STRING;
+					size += DEFERRED_LOG_ALIGNMENT + Align(length + 1);
+					break;
+				}
+				case ARG_INT:
+				case ARG_UNSIGNED:
+					if (segment.length == LENGTH_LONG)
+						va_arg(args, long);
+					else if (segment.length == LENGTH_LONG_LONG)
+						va_arg(args, long long);
+					else if (segment.length == LENGTH_SIZE)
+						va_arg(args, size_t);
+					else
+						va_arg(args, int);
+					size += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_CHAR:
+					va_arg(args, int);
+					size += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_DOUBLE:
+					if (segment.length == LENGTH_LONG_DOUBLE)
+						va_arg(args, long double);
+					else
+						va_arg(args, double);
+					size += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_POINTER:
+					va_arg(args, void*);
+					size += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_IGNORED_POINTER:
+					va_arg(args, void*);
+					break;
+				case ARG_NONE:
+					break;
+			}
+		}
+		return size;
+	}
+
+	static void WriteArguments(ParsedFormat* parsed, char* out, va_list args)
+	{
+		for (size_t i = 0; i < parsed->segments.size(); i++)
+		{
+			FormatSegment& segment = parsed->segments[i];
+			for (int star = 0; star < segment.stars; star++)
+			{
+				*reinterpret_cast<long long*>(out) = va_arg(args, int);
+				out += DEFERRED_LOG_ALIGNMENT;
+			}
+
+			long long* value = reinterpret_cast<long long*>(out);
+			switch (segment.type)
+			{
+				case ARG_STRING:
+				{
+					const char* string = va_arg(args, const char*);
+					if (!string)
+					{
+						*reinterpret_cast<unsigned int*>(out) = DEFERRED_LOG_NULL_STRING;
+						out += DEFERRED_LOG_ALIGNMENT + DEFERRED_LOG_ALIGNMENT;
+						break;
+					}
+
+					size_t length = strlen(string);
+					if (length > DEFERRED_LOG_MAX_STRING)
+						length = DEFERRED_LOG_MAX_STRING;
+					*reinterpret_cast<unsigned int*>(out) = (unsigned int) length;
+					memcpy(out + DEFERRED_LOG_ALIGNMENT, string, length);
+					out[DEFERRED_LOG_ALIGNMENT + length] = '\0';
+					out += DEFERRED_LOG_ALIGNMENT + Align(length + 1);
+					break;
+				}
+				case ARG_INT:
+					if (segment.length == LENGTH_LONG)
+						*value = va_arg(args, long);
+					else if (segment.length == LENGTH_LONG_LONG)
+						*value = va_arg(args, long long);
+					else if (segment.length == LENGTH_SIZE)
+						*value = (long long) (ptrdiff_t) va_arg(args, size_t);
+					else if (segment.length == LENGTH_SHORT)
+						*value = (short) va_arg(args, int);
+					else if (segment.length == LENGTH_CHAR)
+						*value = (signed char) va_arg(args, int);
+					else
+						*value = va_arg(args, int);
+					out += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_UNSIGNED:
+					if (segment.length == LENGTH_LONG)
+						*value = (long long) va_arg(args, unsigned long);
+					else if (segment.length == LENGTH_LONG_LONG)
+						*value = (long long) va_arg(args, unsigned long long);
+					else if (segment.length == LENGTH_SIZE)
+						*value = (long long) va_arg(args, size_t);
+					else if (segment.length == LENGTH_SHORT)
+						*value = (unsigned short) va_arg(args, unsigned int);
+					else if (segment.length == LENGTH_CHAR)
+						*value = (unsigned char) va_arg(args, unsigned int);
+					else
+						*value = va_arg(args, unsigned int);
+					out += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_CHAR:
+					*value = va_arg(args, int);
+					out += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_DOUBLE:
+					if (segment.length == LENGTH_LONG_DOUBLE)
+						*reinterpret_cast<double*>(out) = (double) va_arg(args, long double);
+					else
+						*reinterpret_cast<double*>(out) = va_arg(args, double);
+					out += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_POINTER:
+					*value = (long long) (size_t) va_arg(args, void*);
+					out += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_IGNORED_POINTER:
+					va_arg(args, void*);
+					break;
+				case ARG_NONE:
+					break;
+			}
+		}
+	}
+
+	/*static*/
+	bool DeferredLog::Record(Logger* logger, Logger::Level level,
+		LogFormat& format, va_list args)
+	{
+		if (!enabled)
+			return false;
+
+		ParsedFormat* parsed = static_cast<ParsedFormat*>(format.parsed);
+		if (!parsed)
+			parsed = RegisterFormat(format);
+
+		va_list measureArgs;
+		va_copy(measureArgs, args);
+		size_t size = MeasureRecord(parsed, measureArgs);
+		va_end(measureArgs);
+
+		// Disable clears enabled before it waits for writing to clear,
+		// so either it waits for this record or the check below fails.
+		RecordBuffer* buffer = GetRecordBuffer();
+		AtomicAdd(&buffer->writing, 1);
+		if (!enabled)
+		{
+			AtomicAdd(&buffer->writing, -1);
+			return false;
+		}
+
+		size_t newTail;
+		char* out = ReserveRecord(buffer, size, newTail);
+		if (!out)
+		{
+			AtomicAdd(&buffer->dropped, 1);
+			AtomicAdd(&buffer->writing, -1);
+			return true;
+		}
+
+		RecordHeader* header = reinterpret_cast<RecordHeader*>(out);
+		header->size = (unsigned int) size;
+		header->formatId = parsed->id;
+		header->time = Poco::Timestamp().epochMicroseconds();
+		header->logger = logger;
+		header->level = (int) level;
+
+		va_list writeArgs;
+		va_copy(writeArgs, args);
+		WriteArguments(parsed, out + Align(sizeof(RecordHeader)), writeArgs);
+		va_end(writeArgs);
+
+		// Only this thread moves the tail, so this always succeeds. It
+		// serves as the barrier which makes the record visible first.
+		AtomicCompareAndSwap(&buffer->tail, buffer->tail, (AtomicWord) newTail);
+		AtomicAdd(&buffer->writing, -1);
+		return true;
+	}
+
+	static void AppendFormatted(std::string& text, const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		text.append(Logger::Format(format, args));
+		va_end(args);
+	}
+
+	template <class T>
+	static void AppendConversion(std::string& text, FormatSegment& segment,
+		long long* stars, T value)
+	{
+		const char* conversion = segment.conversion.c_str();
+		if (segment.stars == 0)
+			AppendFormatted(text, conversion, value);
+		else if (segment.stars == 1)
+			AppendFormatted(text, conversion, (int) stars[0], value);
+		else
+			AppendFormatted(text, conversion, (int) stars[0], (int) stars[1], value);
+	}
+
+	static std::string FormatRecord(ParsedFormat* parsed, const char* in)
+	{
+		std::string text;
+		for (size_t i = 0; i < parsed->segments.size(); i++)
+		{
+			FormatSegment& segment = parsed->segments[i];
+			text.append(segment.literal);
+
+			long long stars[2];
+			for (int star = 0; star < segment.stars; star++)
+			{
+				stars[star] = *reinterpret_cast<const long long*>(in);
+				in += DEFERRED_LOG_ALIGNMENT;
+			}
+
+			const long long* value = reinterpret_cast<const long long*>(in);
+			switch (segment.type)
+			{
+				case ARG_STRING:
+				{
+					unsigned int length = *reinterpret_cast<const unsigned int*>(in);
+					in += DEFERRED_LOG_ALIGNMENT;
+					if (length == DEFERRED_LOG_NULL_STRING)
+					{
+						AppendConversion(text, segment, stars, "(null)");
+						in += DEFERRED_LOG_ALIGNMENT;
+					}
+					else
+					{
+						AppendConversion(text, segment, stars, in);
+						in += Align(length + 1);
+					}
+					break;
+				}
+				case ARG_INT:
+				case ARG_UNSIGNED:
+					AppendConversion(text, segment, stars, *value);
+					in += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_CHAR:
+					AppendConversion(text, segment, stars, (int) *value);
+					in += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_DOUBLE:
+					AppendConversion(text, segment, stars,
+						*reinterpret_cast<const double*>(in));
+					in += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_POINTER:
+					AppendConversion(text, segment, stars, (void*) (size_t) *value);
+					in += DEFERRED_LOG_ALIGNMENT;
+					break;
+				case ARG_IGNORED_POINTER:
+				case ARG_NONE:
+					break;
+			}
+		}
+		text.append(parsed->trailing);
+		return text;
+	}
+
+	struct FormattedRecord
+	{
+		Poco::Int64 time;
+		Logger* logger;
+		int level;
+		std::string text;
+
+		bool operator<(const FormattedRecord& other) const
+		{
+			return time < other.time;
+		}
+	};
+
+	/**
+	 * Look up a format in the drain's copy of the registered formats,
+	 * taking a new copy only for formats registered since the last one.
+	 * Formats are never freed, so the copy stays valid without the lock.
+	 */
+	static ParsedFormat* FindFormat(std::vector<ParsedFormat*>& known, unsigned int id)
+	{
+		if (id > known.size())
+		{
+			Poco::FastMutex::ScopedLock lock(formatsMutex);
+			known = formats;
+		}
+		return known[id - 1];
+	}
+
+	static void CollectRecords(RecordBuffer* buffer, std::vector<ParsedFormat*>& known,
+		std::vector<FormattedRecord>& records)
+	{
+		// Records up to the tail read here are complete.
+		size_t tail = (size_t) buffer->tail;
+		size_t head = (size_t) buffer->head;
+		while (head != tail)
+		{
+			RecordHeader* header = reinterpret_cast<RecordHeader*>(buffer->data + head);
+			if (header->size == 0)
+			{
+				head = 0;
+				continue;
+			}
+
+			ParsedFormat* parsed = FindFormat(known, header->formatId);
+			FormattedRecord record;
+			record.time = header->time;
+			record.logger = header->logger;
+			record.level = header->level;
+			record.text = FormatRecord(parsed,
+				buffer->data + head + Align(sizeof(RecordHeader)));
+			records.push_back(record);
+
+			head = (head + header->size) % buffer->size;
+		}
+
+		// Only the drain moves the head; this hands the space back.
+		AtomicCompareAndSwap(&buffer->head, buffer->head, (AtomicWord) head);
+	}
+
+	/*static*/
+	void DeferredLog::Drain()
+	{
+		Poco::FastMutex::ScopedLock drainLock(drainMutex);
+
+		std::vector<RecordBuffer*> current;
+		{
+			Poco::FastMutex::ScopedLock lock(buffersMutex);
+			current = buffers;
+		}
+
+		std::vector<FormattedRecord> records;
+		std::vector<ParsedFormat*> known;
+		int dropped = 0;
+		for (size_t i = 0; i < current.size(); i++)
+		{
+			RecordBuffer* buffer = current[i];
+			bool orphaned = buffer->orphaned != 0;
+			CollectRecords(buffer, known, records);
+
+			AtomicWord bufferDropped = buffer->dropped;
+			if (bufferDropped)
+			{
+				AtomicAdd(&buffer->dropped, -bufferDropped);
+				dropped += bufferDropped;
+			}
+
+			// The thread is gone, so nothing can be added after this.
+			if (orphaned)
+			{
+				Poco::FastMutex::ScopedLock lock(buffersMutex);
+				buffers.erase(std::find(buffers.begin(), buffers.end(), buffer));
+				free(buffer->data);
+				free(buffer);
+			}
+		}
+
+		// Each thread's records are in order already, so a stable sort
+		// keeps them that way when two share a timestamp.
+		std::stable_sort(records.begin(), records.end());
+
+		RootLogger* root = RootLogger::instance;
+		if (!root)
+			return;
+
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			FormattedRecord& record = records[i];
+			Poco::Message m(record.logger->GetName(), record.text,
+				(Poco::Message::Priority) record.level);
+			m.setTime(Poco::Timestamp(record.time));
+			root->LogImpl(m);
+		}
+
+		if (dropped)
+		{
+			root->Warn("Dropped %i deferred log messages because a thread's "
+				"record buffer was full", dropped);
+		}
+	}
+
+	class DeferredLogDrain : public Poco::Runnable
+	{
+		public:
+		void run()
+		{
+			START_KROLL_THREAD;
+			while (!stopping)
+			{
+				drainEvent.tryWait(DEFERRED_LOG_DRAIN_INTERVAL);
+				DeferredLog::Drain();
+			}
+			END_KROLL_THREAD;
+		}
+	};
+
+	static DeferredLogDrain drainRunnable;
+
+	/*static*/
+	void DeferredLog::Enable(size_t size)
+	{
+		if (enabled)
+			return;
+
+		bufferSize = size;
+		stopping = false;
+		drainThread = new Poco::Thread();
+		drainThread->setName("DeferredLog");
+		drainThread->start(drainRunnable);
+		enabled = true;
+	}
+
+	/*static*/
+	void DeferredLog::Disable()
+	{
+		if (!enabled)
+			return;
+
+		enabled = false;
+		stopping = true;
+		drainEvent.set();
+		drainThread->join();
+		delete drainThread;
+		drainThread = 0;
+
+		// Wait for threads which saw deferred logging as enabled just
+		// before it was turned off to finish their records, so that the
+		// last drain catches them. Holding the drain lock keeps buffers
+		// from being freed meanwhile. A thread which registers a buffer
+		// after the copy is taken will find enabled cleared.
+		{
+			Poco::FastMutex::ScopedLock drainLock(drainMutex);
+			std::vector<RecordBuffer*> current;
+			{
+				Poco::FastMutex::ScopedLock lock(buffersMutex);
+				current = buffers;
+			}
+
+			for (size_t i = 0; i < current.size(); i++)
+			{
+				// Adding nothing still acts as a barrier which orders the
+				// store to enabled before this load.
+				while (AtomicAdd(&current[i]->writing, 0))
+					Poco::Thread::yield();
+			}
+		}
+
+		Drain();
+	}
+}
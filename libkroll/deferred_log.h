@@ -0,0 +1,75 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_DEFERRED_LOG_H_
+#define _KR_DEFERRED_LOG_H_
+
+#include <cstdarg>
+
+namespace kroll
+{
+	/**
+	 * A format string which a call site declares once, so that messages
+	 * using it can be recorded without being formatted. Declare it as a
+	 * static aggregate, which needs no constructor and so is safe to
+	 * reach from several threads at once.
+	 * \code
+	 * static LogFormat callFormat = { "Calling %s with %i arguments" };
+	 * logger->Trace(&callFormat, name, (int) args.size());
+	 * \endcode
+	 */
+	struct KROLL_API LogFormat
+	{
+		const char* format;
+		void* volatile parsed;
+	};
+
+	/**
+	 * Deferred formatting for messages logged with a LogFormat. The call
+	 * site only copies the format's id and its raw arguments into a
+	 * buffer owned by the calling thread; strings are copied, since they
+	 * may not outlive the call. A background thread collects the records
+	 * from all threads every few milliseconds, formats them in the order
+	 * they were logged and hands them to the root logger.
+	 *
+	 * Records which do not fit in a thread's buffer are dropped rather than
+	 * making the caller wait, and reported as a count. Messages logged
+	 * while deferred logging is disabled are formatted right away.
+	 */
+	class KROLL_API DeferredLog
+	{
+		public:
+		/**
+		 * @param bufferSize the number of bytes each thread may have
+		 * waiting to be formatted. Threads which already logged keep the
+		 * buffer they have.
+		 */
+		static void Enable(size_t bufferSize=64 * 1024);
+
+		/**
+		 * Stop the background thread after formatting everything which
+		 * was recorded.
+		 */
+		static void Disable();
+		static bool IsEnabled() { return enabled; }
+
+		/**
+		 * @return false if deferred logging is disabled and the message
+		 * must be formatted by the caller
+		 */
+		static bool Record(Logger* logger, Logger::Level level, LogFormat& format,
+			va_list args);
+
+		/**
+		 * Format and log everything recorded so far.
+		 */
+		static void Drain();
+
+		private:
+		static volatile bool enabled;
+	};
+}
+
+#endif
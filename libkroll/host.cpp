@@ -35,8 +35,19 @@ using Poco::Environment;
 #define NO_CONSOLE_LOG_ARG "--no-console-logging"
 #define NO_FILE_LOG_ARG "--no-file-logging"
 #define PROFILE_ARG "--profile"
+#define PROFILE_SAMPLE_ARG "--profile-sample"
+#define TRACE_ARG "--trace"
+#define OBJECT_ACCOUNTING_ARG "--object-accounting"
 #define LOGPATH_ARG "--logpath"
 #define BOOT_HOME_ARG "--start"
+#define CYCLE_COLLECTOR_ARG "--cycle-collector"
+#define ASYNC_LOGGING_ARG "--async-logging"
+#define DEFERRED_LOGGING_ARG "--deferred-logging"
+#define LOG_MAX_SIZE_ARG "--log-max-size"
+#define LOG_ROTATE_INTERVAL_ARG "--log-rotate-interval"
+#define LOG_RETAIN_ARG "--log-retain"
+#define DEFAULT_RETAINED_LOGS 5
+#define DEFAULT_CYCLE_COLLECTOR_INTERVAL 5000
 
 #ifdef OS_WIN32
 #define MODULE_SUFFIX "dll"
@@ -93,6 +104,9 @@ namespace kroll
 		profileStream(0),
 		consoleLogging(true),
 		fileLogging(true),
+		asyncLogging(false),
+		loggingOverflowPolicy(Logger::BLOCK_WHEN_FULL),
+		cycleCollectorInterval(0),
 		logger(0)
 	{
 		hostInstance = this;
@@ -112,6 +126,7 @@ namespace kroll
 		}
 
 		this->SetupLogging();
+		this->SetupCycleCollector();
 		this->SetupProfiling();
 
 		// Call into the platform-specific initialization.
@@ -188,21 +203,83 @@ namespace kroll
 		// If this application has no log level, we'll get a suitable default
 		Logger::Level level = Logger::GetLevel(this->application->logLevel);
 		Logger::Initialize(this->consoleLogging, this->logFilePath, level);
+		if (this->asyncLogging)
+			Logger::EnableAsynchronousLogging(this->loggingOverflowPolicy);
+		if (this->application->HasArgument(DEFERRED_LOGGING_ARG))
+			DeferredLog::Enable();
+
+		// --log-max-size=<megabytes> --log-rotate-interval=<seconds> --log-retain=<files>
+		size_t maxBytes = 0;
+		long maxSeconds = 0;
+		if (this->application->HasArgument(LOG_MAX_SIZE_ARG))
+		{
+			std::string megabytes = this->application->GetArgumentValue(LOG_MAX_SIZE_ARG);
+			maxBytes = (size_t) atol(megabytes.c_str()) * 1024 * 1024;
+		}
+		if (this->application->HasArgument(LOG_ROTATE_INTERVAL_ARG))
+		{
+			std::string seconds = this->application->GetArgumentValue(LOG_ROTATE_INTERVAL_ARG);
+			maxSeconds = atol(seconds.c_str());
+		}
+		if (maxBytes > 0 || maxSeconds > 0)
+		{
+			int retained = DEFAULT_RETAINED_LOGS;
+			if (this->application->HasArgument(LOG_RETAIN_ARG))
+			{
+				std::string files = this->application->GetArgumentValue(LOG_RETAIN_ARG);
+				retained = atoi(files.c_str());
+				if (retained < 0)
+					retained = DEFAULT_RETAINED_LOGS;
+			}
+			Logger::SetLogRotation(maxBytes, maxSeconds, retained);
+		}
 		this->logger = Logger::Get("Host");
 	}
 
+	void Host::SetupCycleCollector()
+	{
+		// Start tracking bridge objects before any module creates them.
+		if (this->cycleCollectorInterval > 0 &&
+			!CycleCollector::Enable(this->cycleCollectorInterval))
+		{
+			logger->Warn("The cycle collector is not available with biased "
+				"reference counting");
+		}
+	}
+
 	void Host::SetupProfiling()
 	{
+		// We always wrap our top level global object to use the profiled
+		// bound object, so that profiling can be switched on at any time
+		// for all methods going through this object and it's attached
+		// children. While the profiler is off, the wrapper only forwards.
+		GlobalObject::TurnOnProfiling();
+
 		if (this->profile)
 		{
-			// In the case of profiling, we wrap our top level global object
-			// to use the profiled bound object which will profile all methods
-			// going through this object and it's attached children
+			unsigned int sampleEvery = 1;
+			if (this->application->HasArgument(PROFILE_SAMPLE_ARG))
+			{
+				std::string rate = this->application->GetArgumentValue(PROFILE_SAMPLE_ARG);
+				sampleEvery = (unsigned int) std::max(1, atoi(rate.c_str()));
+			}
+
 			this->profileStream = new Poco::FileOutputStream(this->profilePath);
-			ProfiledBoundObject::SetStream(this->profileStream);
-			GlobalObject::TurnOnProfiling();
+			Profiler::Enable(sampleEvery);
+
+			logger->Info("Starting Profiler. Report going to %s", this->profilePath.c_str());
+		}
+
+		if (!this->tracePath.empty())
+		{
+			Tracer::Enable();
+			logger->Info("Starting Tracer. Trace going to %s", this->tracePath.c_str());
+		}
 
-			logger->Info("Starting Profiler. Output going to %s", this->profilePath.c_str());
+		if (ObjectAccounting::IsEnabled())
+		{
+			ObjectAccounting::LogStatisticsOnSignal();
+			logger->Info("Counting objects by type. Send SIGUSR2 to log the counts");
 		}
 	}
 
@@ -211,12 +288,25 @@ namespace kroll
 		if (this->profile)
 		{
 			logger->Info("Stopping Profiler");
-			ProfiledBoundObject::SetStream(0);
-			profileStream->flush();
+			Profiler::Disable();
+			Profiler::WriteReport(*profileStream);
 			profileStream->close();
+			delete profileStream;
 			profileStream = 0;
 			this->profile = false;
 		}
+
+		if (!this->tracePath.empty())
+		{
+			logger->Info("Stopping Tracer");
+			Tracer::Disable();
+			Poco::FileOutputStream traceStream(this->tracePath);
+			Tracer::WriteTrace(traceStream);
+			this->tracePath = std::string();
+		}
+
+		// The watcher logs, so it must stop before the loggers do.
+		ObjectAccounting::StopLogStatisticsOnSignal();
 	}
 
 	void Host::ParseCommandLineArguments()
@@ -247,11 +337,42 @@ namespace kroll
 			this->profile = !this->profilePath.empty();
 		}
 
+		if (this->application->HasArgument(TRACE_ARG))
+		{
+			this->tracePath = this->application->GetArgumentValue(TRACE_ARG);
+		}
+
+		// Enable accounting before most objects are created, so that they
+		// are counted.
+		if (this->application->HasArgument(OBJECT_ACCOUNTING_ARG))
+		{
+			ObjectAccounting::Enable();
+		}
+
 		if (this->application->HasArgument(LOGPATH_ARG))
 		{
 			this->logFilePath = this->application->GetArgumentValue(LOGPATH_ARG);
 		}
 
+		// --async-logging[=block|drop-oldest|drop]
+		if (this->application->HasArgument(ASYNC_LOGGING_ARG))
+		{
+			this->asyncLogging = true;
+			std::string policy = this->application->GetArgumentValue(ASYNC_LOGGING_ARG);
+			if (policy == "drop-oldest")
+				this->loggingOverflowPolicy = Logger::DROP_OLDEST;
+			else if (policy == "drop")
+				this->loggingOverflowPolicy = Logger::DROP_NEWEST;
+		}
+
+		if (this->application->HasArgument(CYCLE_COLLECTOR_ARG))
+		{
+			std::string interval = this->application->GetArgumentValue(CYCLE_COLLECTOR_ARG);
+			this->cycleCollectorInterval = atol(interval.c_str());
+			if (this->cycleCollectorInterval <= 0)
+				this->cycleCollectorInterval = DEFAULT_CYCLE_COLLECTOR_INTERVAL;
+		}
+
 		// Was this only used by the appinstaller? It complicates things a bit,
 		// and the component list might not be correct after this point. -- Martin
 		if (this->application->HasArgument(BOOT_HOME_ARG))
@@ -648,12 +769,20 @@ namespace kroll
 			return;
 
 		ScopedLock lock(&moduleMutex);
+		CycleCollector::Disable();
 		this->UnloadModuleProviders();
 		this->UnloadModules();
 
 		UnloadBuiltinModules();
 
 		logger->Notice("Exiting with exit code: %i", exitCode);
+		if (logger->IsDebugEnabled())
+		{
+			SlabAllocator::LogStatistics(logger);
+			BufferPool::LogStatistics(logger);
+		}
+		if (ObjectAccounting::IsEnabled())
+			ObjectAccounting::LogStatistics(logger);
 		StopProfiling(); // Stop the profiler, if it was enabled
 		Logger::Shutdown();
 		shutdown = true;
@@ -8,6 +8,7 @@
 #define _KR_HOST_H_
 
 #include <Poco/Timestamp.h>
+#include <Poco/FileStream.h>
 
 namespace kroll
 {
@@ -26,7 +27,7 @@ namespace kroll
 
 		inline SharedApplication GetApplication() { return this->application; }
 		inline bool DebugModeEnabled() { return this->debug; }
-		inline bool ProfilingEnabled() { return this->profile; }
+		inline bool ProfilingEnabled() { return Profiler::IsEnabled(); }
 		inline Poco::Timestamp::TimeDiff GetElapsedTime() { return timeStarted.elapsed(); }
 		inline KObjectRef GetGlobalObject() { return GlobalObject::GetInstance(); }
 		/**
@@ -139,10 +140,14 @@ namespace kroll
 		bool autoScan;
 		bool profile;
 		std::string profilePath;
+		std::string tracePath;
 		std::string logFilePath;
 		Poco::FileOutputStream* profileStream;
 		bool consoleLogging;
 		bool fileLogging;
+		bool asyncLogging;
+		Logger::OverflowPolicy loggingOverflowPolicy;
+		long cycleCollectorInterval;
 		Logger* logger;
 		Poco::Timestamp timeStarted;
 		Poco::Mutex jobQueueMutex;
@@ -160,6 +165,7 @@ namespace kroll
 		void SetupApplication(int argc, const char* argv[]);
 		void SetupLogging();
 		void SetupProfiling();
+		void SetupCycleCollector();
 		void StopProfiling();
 		void AddInvalidModuleFile(std::string path);
 		void ParseCommandLineArguments();
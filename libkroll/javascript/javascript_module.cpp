@@ -15,6 +15,7 @@ namespace kroll
 	{
 		JavaScriptModule::instance = this;
 		host->AddModuleProvider(this);
+		CycleCollector::AddHeap(KJSHeap::GetInstance());
 		
 		KObjectRef global(Host::GetInstance()->GetGlobalObject());
 		JavaScriptMethods::Bind(global);
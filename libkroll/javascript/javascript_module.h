@@ -27,6 +27,7 @@ namespace kroll
 #include "k_kjs_method.h"
 #include "k_kjs_list.h"
 #include "kjs_util.h"
+#include "kjs_heap.h"
 #include "javascript_module_instance.h"
 #include "javascript_methods.h"
 
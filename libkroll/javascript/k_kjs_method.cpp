@@ -82,8 +82,34 @@ namespace kroll
 		return this->jsobject;
 	}
 
+	const char* KKJSMethod::GetTraceName()
+	{
+		if (!this->traceName.empty())
+			return this->traceName.c_str();
+
+		// Anonymous functions have an empty name and are traced under
+		// the type.
+		if (this->context)
+		{
+			JSStringRef nameProperty = JSStringCreateWithUTF8CString("name");
+			JSValueRef nameValue = JSObjectGetProperty(this->context, this->jsobject,
+				nameProperty, NULL);
+			JSStringRelease(nameProperty);
+			if (nameValue && JSValueIsString(this->context, nameValue))
+			{
+				JSStringRef nameString = JSValueToStringCopy(this->context, nameValue, NULL);
+				this->traceName = KJSUtil::ToChars(nameString);
+				JSStringRelease(nameString);
+			}
+		}
+		if (this->traceName.empty())
+			this->traceName = this->GetType();
+		return this->traceName.c_str();
+	}
+
 	KValueRef KKJSMethod::Call(JSObjectRef thisObject, const ValueList& args)
 	{
+		TraceSpan span("JavaScript", Tracer::IsEnabled() ? this->GetTraceName() : 0);
 		JSValueRef* jsArgs = new JSValueRef[args.size()];
 		for (int i = 0; i < (int) args.size(); i++)
 		{
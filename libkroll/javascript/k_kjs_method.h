@@ -38,6 +38,13 @@ namespace kroll
 		JSObjectRef jsobject;
 		JSObjectRef thisObject;
 		AutoPtr<KKJSObject> kobject;
+		std::string traceName;
+
+		/**
+		 * The name spans are recorded under, found the first time the
+		 * method is called while tracing.
+		 */
+		const char* GetTraceName();
 
 		private:
 		DISALLOW_EVIL_CONSTRUCTORS(KKJSMethod);
@@ -9,8 +9,10 @@ namespace kroll
 {
 	KKJSObject::KKJSObject(JSContextRef context, JSObjectRef jsobject) :
 		KObject("JavaScript.KKJSObject"),
+		CycleCollectable(this),
 		context(NULL),
-		jsobject(jsobject)
+		jsobject(jsobject),
+		pinned(true)
 	{
 		/* KJS methods run in the global context that they originated from
 		* this seems to prevent nasty crashes from trying to access invalid
@@ -30,11 +32,14 @@ namespace kroll
 
 		KJSUtil::ProtectGlobalContext(this->context);
 		JSValueProtect(this->context, this->jsobject);
+		CycleCollector::Add(this);
 	}
 
 	KKJSObject::~KKJSObject()
 	{
-		JSValueUnprotect(this->context, this->jsobject);
+		CycleCollector::Remove(this);
+		if (this->pinned)
+			JSValueUnprotect(this->context, this->jsobject);
 		KJSUtil::UnprotectGlobalContext(this->context);
 	}
 
@@ -43,8 +48,35 @@ namespace kroll
 		return this->jsobject;
 	}
 
+	bool KKJSObject::IsCollected()
+	{
+		return this->jsobject == NULL;
+	}
+
+	void KKJSObject::Traverse(CycleCollectorTraversal& traversal)
+	{
+		// What the JavaScript object reaches is opaque to us. The references
+		// held by its heap are reported by the KJSHeap's wrappers instead.
+	}
+
+	void KKJSObject::Unlink()
+	{
+		if (this->pinned)
+			JSValueUnprotect(this->context, this->jsobject);
+		this->pinned = false;
+		this->jsobject = NULL;
+	}
+
+	CycleCollectorHeap* KKJSObject::GetHeap()
+	{
+		return KJSHeap::GetInstance();
+	}
+
 	KValueRef KKJSObject::Get(const char *name)
 	{
+		if (this->IsCollected())
+			return Value::Undefined;
+
 		JSStringRef jsName = JSStringCreateWithUTF8CString(name);
 		JSValueRef exception = NULL;
 		JSValueRef jsValue = JSObjectGetProperty(this->context, this->jsobject, jsName, NULL);
@@ -62,6 +94,9 @@ namespace kroll
 
 	void KKJSObject::Set(const char *name, KValueRef value)
 	{
+		if (this->IsCollected())
+			return;
+
 		JSValueRef jsValue = KJSUtil::ToJSValue(value, this->context);
 		JSStringRef jsName = JSStringCreateWithUTF8CString(name);
 
@@ -80,7 +115,7 @@ namespace kroll
 	bool KKJSObject::Equals(KObjectRef other)
 	{
 		AutoPtr<KKJSObject> kjsOther = other.cast<KKJSObject>();
-		if (kjsOther.isNull())
+		if (kjsOther.isNull() || this->IsCollected() || kjsOther->IsCollected())
 			return false;
 
 		if (!kjsOther->SameContextGroup(this->context))
@@ -93,6 +128,8 @@ namespace kroll
 	SharedStringList KKJSObject::GetPropertyNames()
 	{
 		SharedStringList list(new StringList());
+		if (this->IsCollected())
+			return list;
 
 		JSPropertyNameArrayRef names =
 			JSObjectCopyPropertyNames(this->context, this->jsobject);
@@ -111,6 +148,9 @@ namespace kroll
 
 	bool KKJSObject::HasProperty(const char* name)
 	{
+		if (this->IsCollected())
+			return false;
+
 		JSStringRef jsName = JSStringCreateWithUTF8CString(name);
 		bool hasProperty = JSObjectHasProperty(context, jsobject, jsName);
 		JSStringRelease(jsName);
@@ -15,7 +15,7 @@
 
 namespace kroll
 {
-	class KROLL_API KKJSObject : public KObject
+	class KROLL_API KKJSObject : public KObject, public CycleCollectable
 	{
 		public:
 		KKJSObject(JSContextRef context, JSObjectRef js_object);
@@ -30,9 +30,22 @@ namespace kroll
 		bool SameContextGroup(JSContextRef c);
 		JSObjectRef GetJSObject();
 
+		/**
+		 * @return true if the cycle collector found the JavaScript object
+		 * to be garbage and it has been collected.
+		 */
+		bool IsCollected();
+
+		virtual void Traverse(CycleCollectorTraversal& traversal);
+		virtual void Unlink();
+		virtual CycleCollectorHeap* GetHeap();
+
 		protected:
 		JSGlobalContextRef context;
 		JSObjectRef jsobject;
+		bool pinned;
+
+		friend class KJSHeap;
 
 		private:
 		DISALLOW_EVIL_CONSTRUCTORS(KKJSObject);
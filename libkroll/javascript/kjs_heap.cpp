@@ -0,0 +1,315 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "javascript_module.h"
+#include <Poco/ScopedLock.h>
+#include <set>
+
+#define HIDDEN_EDGES_PROPERTY "__kroll_cycle_edges__"
+#define HIDDEN_SENTINEL_PROPERTY "__kroll_cycle_sentinel__"
+
+namespace kroll
+{
+	// A sentinel hangs off each probed JavaScript object. If the sentinel
+	// is finalized by a collection, so was the object holding it.
+	struct SentinelState
+	{
+		bool finalized;
+		bool orphaned;
+	};
+
+	typedef std::pair<JSObjectRef, JSGlobalContextRef> AttachedEdges;
+
+	static KJSHeap heap;
+	static JSClassRef sentinelClass = NULL;
+	static const JSClassDefinition emptyClassDefinition =
+	{
+		0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0
+	};
+
+	static void FinalizeSentinel(JSObjectRef sentinel)
+	{
+		SentinelState* state = static_cast<SentinelState*>(JSObjectGetPrivate(sentinel));
+		if (state->orphaned)
+			delete state;
+		else
+			state->finalized = true;
+	}
+
+	static JSObjectRef MakeSentinel(JSContextRef context, SentinelState* state)
+	{
+		if (sentinelClass == NULL)
+		{
+			JSClassDefinition definition = emptyClassDefinition;
+			definition.className = "KrollCycleSentinel";
+			definition.finalize = FinalizeSentinel;
+			sentinelClass = JSClassCreate(&definition);
+		}
+		return JSObjectMake(context, sentinelClass, state);
+	}
+
+	/**
+	 * Store a value in a non-enumerable property and check that it stuck,
+	 * which it may not on host objects with their own property storage.
+	 */
+	static bool SetHiddenProperty(JSContextRef context, JSObjectRef object,
+		const char* name, JSValueRef value)
+	{
+		JSStringRef jsName = JSStringCreateWithUTF8CString(name);
+		JSValueRef exception = NULL;
+		JSObjectSetProperty(context, object, jsName, value,
+			kJSPropertyAttributeDontEnum, &exception);
+
+		bool stored = false;
+		if (exception == NULL)
+		{
+			JSValueRef current = JSObjectGetProperty(context, object, jsName, &exception);
+			stored = exception == NULL && JSValueIsStrictEqual(context, current, value);
+		}
+		JSStringRelease(jsName);
+		return stored;
+	}
+
+	static void DeleteHiddenProperty(JSContextRef context, JSObjectRef object,
+		const char* name)
+	{
+		JSStringRef jsName = JSStringCreateWithUTF8CString(name);
+		JSObjectDeleteProperty(context, object, jsName, NULL);
+		JSStringRelease(jsName);
+	}
+
+	static KObject* GetHeldObject(KValueRef* value)
+	{
+		if ((*value)->IsMethod())
+			return (*value)->ToMethod().get();
+		else if ((*value)->IsList())
+			return (*value)->ToList().get();
+		else if ((*value)->IsObject())
+			return (*value)->ToObject().get();
+		return 0;
+	}
+
+	/*static*/
+	KJSHeap* KJSHeap::GetInstance()
+	{
+		return &heap;
+	}
+
+	void KJSHeap::AddWrapper(JSObjectRef wrapper, KValueRef* value, JSContextRef context)
+	{
+		if (!CycleCollector::IsEnabled())
+			return;
+
+		// Hidden properties must be set from a context which outlives the
+		// one the wrapper happened to be created in.
+		JSObjectRef globalObject = JSContextGetGlobalObject(context);
+		JSGlobalContextRef globalContext = KJSUtil::GetGlobalContext(globalObject);
+		if (globalContext == NULL)
+			return;
+
+		Poco::Mutex::ScopedLock lock(mutex);
+		Wrapper& entry = wrappers[wrapper];
+		entry.value = value;
+		entry.context = globalContext;
+	}
+
+	void KJSHeap::RemoveWrapper(JSObjectRef wrapper)
+	{
+		Poco::Mutex::ScopedLock lock(mutex);
+		wrappers.erase(wrapper);
+	}
+
+	/*static*/
+	bool KJSHeap::IsHiddenProperty(JSStringRef name)
+	{
+		return JSStringIsEqualToUTF8CString(name, HIDDEN_EDGES_PROPERTY) ||
+			JSStringIsEqualToUTF8CString(name, HIDDEN_SENTINEL_PROPERTY);
+	}
+
+	void KJSHeap::TraverseWrappers(CycleCollectorTraversal& traversal)
+	{
+		Poco::Mutex::ScopedLock lock(mutex);
+		std::map<JSObjectRef, Wrapper>::iterator i = wrappers.begin();
+		while (i != wrappers.end())
+		{
+			traversal.NoteValue(i->second.value->get());
+			i++;
+		}
+	}
+
+	/**
+	 * Give each wrapper of an object in reachable a hidden array of the
+	 * candidates' JavaScript objects which it reaches through Kroll, so
+	 * that JavaScriptCore's collector follows the edges it cannot see.
+	 * @return false if some edge could not be expressed
+	 */
+	bool KJSHeap::AttachEdges(std::map<KObject*, std::vector<CycleCollectable*> >& reachable,
+		std::vector<AttachedEdges>& attached)
+	{
+		std::vector<AttachedEdges> holders;
+		std::vector<std::vector<CycleCollectable*>*> targets;
+		{
+			Poco::Mutex::ScopedLock lock(mutex);
+			std::map<JSObjectRef, Wrapper>::iterator i = wrappers.begin();
+			while (i != wrappers.end())
+			{
+				std::map<KObject*, std::vector<CycleCollectable*> >::iterator found =
+					reachable.find(GetHeldObject(i->second.value));
+				if (found != reachable.end() && !found->second.empty())
+				{
+					holders.push_back(AttachedEdges(i->first, i->second.context));
+					targets.push_back(&found->second);
+				}
+				i++;
+			}
+		}
+
+		for (size_t i = 0; i < holders.size(); i++)
+		{
+			JSGlobalContextRef context = holders[i].second;
+			JSObjectRef edges = JSObjectMake(context, NULL, NULL);
+			JSValueProtect(context, edges);
+
+			std::vector<CycleCollectable*>& members = *targets[i];
+			bool expressible = true;
+			for (size_t j = 0; j < members.size(); j++)
+			{
+				KKJSObject* object = static_cast<KKJSObject*>(members[j]);
+				if (object->IsCollected() || !object->SameContextGroup(context))
+				{
+					expressible = false;
+					break;
+				}
+				JSObjectSetPropertyAtIndex(context, edges, j, object->GetJSObject(), NULL);
+			}
+
+			// A collection while setting this up may have finalized the
+			// wrapper, in which case it has no edges left to keep.
+			bool registered = false;
+			bool stored = false;
+			if (expressible)
+			{
+				Poco::Mutex::ScopedLock lock(mutex);
+				registered = wrappers.find(holders[i].first) != wrappers.end();
+				if (registered)
+				{
+					stored = SetHiddenProperty(context, holders[i].first,
+						HIDDEN_EDGES_PROPERTY, edges);
+				}
+			}
+			JSValueUnprotect(context, edges);
+
+			if (stored)
+				attached.push_back(holders[i]);
+			else if (registered || !expressible)
+				return false;
+		}
+		return true;
+	}
+
+	void KJSHeap::DetachEdges(std::vector<AttachedEdges>& attached)
+	{
+		for (size_t i = 0; i < attached.size(); i++)
+		{
+			Poco::Mutex::ScopedLock lock(mutex);
+			if (wrappers.find(attached[i].first) != wrappers.end())
+			{
+				DeleteHiddenProperty(attached[i].second, attached[i].first,
+					HIDDEN_EDGES_PROPERTY);
+			}
+		}
+	}
+
+	void KJSHeap::Collect(std::vector<CycleCollectable*>& candidates,
+		std::map<KObject*, std::vector<CycleCollectable*> >& reachable,
+		std::vector<CycleCollectable*>& survivors)
+	{
+		std::vector<AttachedEdges> attached;
+		if (!this->AttachEdges(reachable, attached))
+		{
+			this->DetachEdges(attached);
+			survivors.insert(survivors.end(), candidates.begin(), candidates.end());
+			return;
+		}
+
+		// Several candidates may wrap the same JavaScript object, so they
+		// share its sentinel.
+		std::vector<KKJSObject*> probed;
+		std::map<JSObjectRef, SentinelState*> states;
+		std::set<JSContextGroupRef> groups;
+		std::vector<JSGlobalContextRef> contexts;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			KKJSObject* object = static_cast<KKJSObject*>(candidates[i]);
+			if (!object->pinned)
+			{
+				survivors.push_back(object);
+				continue;
+			}
+
+			if (states.find(object->jsobject) == states.end())
+			{
+				SentinelState* state = new SentinelState();
+				state->finalized = false;
+				state->orphaned = false;
+
+				JSObjectRef sentinel = MakeSentinel(object->context, state);
+				if (!SetHiddenProperty(object->context, object->jsobject,
+					HIDDEN_SENTINEL_PROPERTY, sentinel))
+				{
+					// There is no telling whether this object dies.
+					state->orphaned = true;
+					survivors.push_back(object);
+					continue;
+				}
+				states[object->jsobject] = state;
+			}
+
+			probed.push_back(object);
+			if (groups.insert(JSContextGetGroup(object->context)).second)
+				contexts.push_back(object->context);
+		}
+
+		for (size_t i = 0; i < probed.size(); i++)
+		{
+			JSValueUnprotect(probed[i]->context, probed[i]->jsobject);
+			probed[i]->pinned = false;
+		}
+
+		for (size_t i = 0; i < contexts.size(); i++)
+			JSGarbageCollect(contexts[i]);
+
+		for (size_t i = 0; i < probed.size(); i++)
+		{
+			KKJSObject* object = probed[i];
+			if (states[object->jsobject]->finalized)
+			{
+				object->jsobject = NULL;
+				continue;
+			}
+
+			// The sentinels of survivors will be finalized later on and
+			// clean up after themselves.
+			states[object->jsobject]->orphaned = true;
+			DeleteHiddenProperty(object->context, object->jsobject,
+				HIDDEN_SENTINEL_PROPERTY);
+			JSValueProtect(object->context, object->jsobject);
+			object->pinned = true;
+			survivors.push_back(object);
+		}
+
+		std::map<JSObjectRef, SentinelState*>::iterator i = states.begin();
+		while (i != states.end())
+		{
+			if (i->second->finalized)
+				delete i->second;
+			i++;
+		}
+
+		this->DetachEdges(attached);
+	}
+}
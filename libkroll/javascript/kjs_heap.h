@@ -0,0 +1,59 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KJS_HEAP_H_
+#define _KJS_HEAP_H_
+
+#include <Poco/Mutex.h>
+
+namespace kroll
+{
+	/**
+	 * Lets the cycle collector see the JavaScriptCore heap. It tracks the
+	 * wrapper objects which keep Kroll values alive from JavaScript and
+	 * confirms garbage candidates by running JavaScriptCore's collector.
+	 */
+	class KROLL_API KJSHeap : public CycleCollectorHeap
+	{
+		public:
+		static KJSHeap* GetInstance();
+
+		/**
+		 * Track a wrapper created for a Kroll value. Wrappers created while
+		 * the cycle collector is disabled are not tracked, so the values
+		 * they hold always look externally referenced.
+		 */
+		void AddWrapper(JSObjectRef wrapper, KValueRef* value, JSContextRef context);
+		void RemoveWrapper(JSObjectRef wrapper);
+
+		/**
+		 * @return true if this is the name of a property which the
+		 * collector stores on wrappers. Wrapper classes must leave these
+		 * to JavaScriptCore's own property storage.
+		 */
+		static bool IsHiddenProperty(JSStringRef name);
+
+		virtual void TraverseWrappers(CycleCollectorTraversal& traversal);
+		virtual void Collect(std::vector<CycleCollectable*>& candidates,
+			std::map<KObject*, std::vector<CycleCollectable*> >& reachable,
+			std::vector<CycleCollectable*>& survivors);
+
+		private:
+		struct Wrapper
+		{
+			KValueRef* value;
+			JSGlobalContextRef context;
+		};
+
+		Poco::Mutex mutex;
+		std::map<JSObjectRef, Wrapper> wrappers;
+
+		bool AttachEdges(std::map<KObject*, std::vector<CycleCollectable*> >& reachable,
+			std::vector<std::pair<JSObjectRef, JSGlobalContextRef> >& attached);
+		void DetachEdges(std::vector<std::pair<JSObjectRef, JSGlobalContextRef> >& attached);
+	};
+}
+
+#endif
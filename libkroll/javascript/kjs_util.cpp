@@ -12,12 +12,11 @@ namespace kroll
 {
 namespace KJSUtil
 {
+	static LoggerHandle logger = { "JavaScript.KJSUtil" };
+
 	static inline Logger* GetLogger()
 	{
-		static Logger* logger = 0;
-		if (!logger)
-			logger = Logger::Get("JavaScript.KJSUtil");
-		return logger;
+		return logger.Get();
 	}
 
 	static JSClassRef KJSKObjectClass = NULL;
@@ -156,7 +155,7 @@ namespace KJSUtil
 		{
 			KObjectRef obj = value->ToObject();
 			AutoPtr<KKJSObject> kobj = obj.cast<KKJSObject>();
-			if (!kobj.isNull() && kobj->SameContextGroup(jsContext))
+			if (!kobj.isNull() && !kobj->IsCollected() && kobj->SameContextGroup(jsContext))
 			{
 				// this object is actually a pure JS object
 				jsValue = kobj->GetJSObject();
@@ -227,7 +226,10 @@ namespace KJSUtil
 			jsClassDefinition.setProperty = SetPropertyCallback;
 			KJSKObjectClass = JSClassCreate(&jsClassDefinition);
 		}
-		return JSObjectMake(jsContext, KJSKObjectClass, new KValueRef(objectValue));
+		KValueRef* value = new KValueRef(objectValue);
+		JSObjectRef jsobject = JSObjectMake(jsContext, KJSKObjectClass, value);
+		KJSHeap::GetInstance()->AddWrapper(jsobject, value, jsContext);
+		return jsobject;
 	}
 
 	JSValueRef KMethodToJSValue(KValueRef methodValue, JSContextRef jsContext)
@@ -244,7 +246,9 @@ namespace KJSUtil
 			jsClassDefinition.callAsFunction = CallAsFunctionCallback;
 			KJSKMethodClass = JSClassCreate(&jsClassDefinition);
 		}
-		JSObjectRef jsobject = JSObjectMake(jsContext, KJSKMethodClass, new KValueRef(methodValue));
+		KValueRef* value = new KValueRef(methodValue);
+		JSObjectRef jsobject = JSObjectMake(jsContext, KJSKMethodClass, value);
+		KJSHeap::GetInstance()->AddWrapper(jsobject, value, jsContext);
 		JSValueRef functionPrototype = GetFunctionPrototype(jsContext, NULL);
 		JSObjectSetPrototype(jsContext, jsobject, functionPrototype);
 		return jsobject;
@@ -265,7 +269,9 @@ namespace KJSUtil
 			KJSKListClass = JSClassCreate(&jsClassDefinition);
 		}
 
-		JSObjectRef jsobject = JSObjectMake(jsContext, KJSKListClass, new KValueRef(listValue));
+		KValueRef* value = new KValueRef(listValue);
+		JSObjectRef jsobject = JSObjectMake(jsContext, KJSKListClass, value);
+		KJSHeap::GetInstance()->AddWrapper(jsobject, value, jsContext);
 		JSValueRef arrayPrototype = GetArrayPrototype(jsContext, NULL);
 		JSObjectSetPrototype(jsContext, jsobject, arrayPrototype);
 		return jsobject;
@@ -303,6 +309,7 @@ namespace KJSUtil
 	static void FinalizeCallback(JSObjectRef jsObject)
 	{
 		KValueRef* value = static_cast<KValueRef*>(JSObjectGetPrivate(jsObject));
+		KJSHeap::GetInstance()->RemoveWrapper(jsObject);
 		delete value;
 	}
 
@@ -332,7 +339,7 @@ namespace KJSUtil
 		JSStringRef jsProperty)
 	{
 		KValueRef* value = static_cast<KValueRef*>(JSObjectGetPrivate(jsObject));
-		if (value == NULL)
+		if (value == NULL || KJSHeap::IsHiddenProperty(jsProperty))
 			return false;
 
 		// Convert the name to a std::string.
@@ -372,6 +379,10 @@ namespace KJSUtil
 		if (value == NULL)
 			return JSValueMakeUndefined(jsContext);
 
+		// Let JavaScriptCore's own storage answer for the collector's edges.
+		if (KJSHeap::IsHiddenProperty(jsProperty))
+			return NULL;
+
 		KObjectRef object = (*value)->ToObject();
 		std::string name(ToChars(jsProperty));
 		JSValueRef jsValue = NULL;
@@ -404,7 +415,7 @@ namespace KJSUtil
 		JSStringRef jsProperty, JSValueRef jsValue, JSValueRef* jsException)
 	{
 		KValueRef* value = static_cast<KValueRef*>(JSObjectGetPrivate(jsObject));
-		if (value == NULL)
+		if (value == NULL || KJSHeap::IsHiddenProperty(jsProperty))
 			return false;
 
 		KObjectRef object = (*value)->ToObject();
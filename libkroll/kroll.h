@@ -78,12 +78,23 @@ namespace kroll
 
 #include "utils/utils.h"
 #include "net/net.h"
+#include "thread_local.h"
+#include "slab_allocator.h"
+#include "buffer_pool.h"
+#include "byte_kernels.h"
 #include "reference_counted.h"
+#include "weak_reference.h"
+#include "cycle_collector.h"
 #include "logger.h"
+#include "deferred_log.h"
+#include "log_limiter.h"
+#include "profiler.h"
+#include "object_accounting.h"
 #include "mutex.h"
 #include "scoped_lock.h"
 
 #include "binding/binding.h"
+#include "tracer.h"
 #include "module_provider.h"
 #include "module.h"
 #include "async_job.h"
@@ -0,0 +1,338 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <sstream>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/Timestamp.h>
+#include <Poco/Timer.h>
+
+#define LOG_LIMITER_REPORT_INTERVAL 5000
+
+namespace kroll
+{
+	struct LogLimit
+	{
+		std::string prefix;
+		double messagesPerSecond;
+		int burst;
+		int sampleEvery;
+
+		Poco::FastMutex mutex;
+		double tokens;
+		Poco::Timestamp lastRefill;
+		size_t seen;
+		size_t admitted;
+		size_t sampledOut;
+		size_t rateLimited;
+		size_t reportedSampledOut;
+		size_t reportedRateLimited;
+	};
+
+	class ReportTimer
+	{
+		public:
+		void OnTimer(Poco::Timer&)
+		{
+			LogLimiter::ReportSuppressed();
+		}
+	};
+
+	static Poco::FastMutex limitsMutex;
+	static std::map<std::string, LogLimit*> limits;
+
+	// Loggers may still be counting against a limit after it was replaced
+	// or removed. Such limits are kept until no admission is in progress,
+	// since any admission which starts later finds the current limits.
+	static std::vector<LogLimit*> retiredLimits;
+	static volatile AtomicWord limitsGeneration = 1;
+	static volatile AtomicWord admitting = 0;
+
+	struct AdmissionScope
+	{
+		AdmissionScope() { AtomicAdd(&admitting, 1); }
+		~AdmissionScope() { AtomicAdd(&admitting, -1); }
+	};
+
+	static Poco::FastMutex timerMutex;
+	static Poco::Timer* timer = 0;
+	static ReportTimer timerTarget;
+
+	volatile bool LogLimiter::active = false;
+
+	static std::string NormalizePrefix(std::string prefix)
+	{
+		if (!prefix.empty() && prefix[prefix.size() - 1] == '*')
+			prefix.erase(prefix.size() - 1);
+		if (!prefix.empty() && prefix[prefix.size() - 1] == '.')
+			prefix.erase(prefix.size() - 1);
+		return prefix;
+	}
+
+	static bool PrefixMatches(const std::string& prefix, const std::string& name)
+	{
+		if (prefix.empty())
+			return true;
+		return name.compare(0, prefix.size(), prefix) == 0 &&
+			(name.size() == prefix.size() || name[prefix.size()] == '.');
+	}
+
+	static LogLimit* FindLimit(const std::string& name)
+	{
+		LogLimit* found = 0;
+		std::map<std::string, LogLimit*>::iterator i = limits.begin();
+		for (; i != limits.end(); i++)
+		{
+			if (PrefixMatches(i->first, name) &&
+				(!found || i->first.size() > found->prefix.size()))
+				found = i->second;
+		}
+		return found;
+	}
+
+	/**
+	 * Take the counts which were not reported yet, if any.
+	 * The limit's mutex must be held.
+	 */
+	static std::string TakeReport(LogLimit* limit)
+	{
+		size_t sampledOut = limit->sampledOut - limit->reportedSampledOut;
+		size_t rateLimited = limit->rateLimited - limit->reportedRateLimited;
+		if (sampledOut == 0 && rateLimited == 0)
+			return std::string();
+
+		limit->reportedSampledOut = limit->sampledOut;
+		limit->reportedRateLimited = limit->rateLimited;
+
+		std::ostringstream text;
+		text << "Suppressed " << (sampledOut + rateLimited) << " messages from '"
+			<< limit->prefix << "' (" << sampledOut << " sampled out, "
+			<< rateLimited << " over the rate limit)";
+		return text.str();
+	}
+
+	static void LogReport(const std::string& source, const std::string& report)
+	{
+		// Go straight to the root logger so that reports are never limited.
+		if (report.empty() || !RootLogger::instance)
+			return;
+		Poco::Message m(source, report, Poco::Message::PRIO_WARNING);
+		RootLogger::instance->LogImpl(m);
+	}
+
+	/**
+	 * Report suppressed messages every few seconds for as long as any
+	 * limit is set. Must be called without limitsMutex, which the timer
+	 * callback takes.
+	 */
+	static void UpdateReportTimer()
+	{
+		Poco::Timer* stopping = 0;
+		{
+			Poco::FastMutex::ScopedLock lock(timerMutex);
+			if (LogLimiter::IsActive() && !timer)
+			{
+				timer = new Poco::Timer(LOG_LIMITER_REPORT_INTERVAL,
+					LOG_LIMITER_REPORT_INTERVAL);
+				timer->start(Poco::TimerCallback<ReportTimer>(
+					timerTarget, &ReportTimer::OnTimer));
+			}
+			else if (!LogLimiter::IsActive() && timer)
+			{
+				stopping = timer;
+				timer = 0;
+			}
+		}
+
+		// Stopping waits for a running callback.
+		if (stopping)
+		{
+			stopping->stop();
+			delete stopping;
+		}
+	}
+
+	static void Retire(LogLimit* limit)
+	{
+		retiredLimits.push_back(limit);
+		AtomicAdd(&limitsGeneration, 1);
+	}
+
+	/*static*/
+	void LogLimiter::SetLimit(std::string prefix, double messagesPerSecond,
+		int burst, int sampleEvery)
+	{
+		LogLimit* limit = new LogLimit();
+		limit->prefix = NormalizePrefix(prefix);
+		limit->messagesPerSecond = messagesPerSecond < 0 ? 0 : messagesPerSecond;
+		limit->burst = burst < 1 ? 1 : burst;
+		limit->sampleEvery = sampleEvery < 1 ? 1 : sampleEvery;
+		limit->tokens = limit->burst;
+		limit->seen = 0;
+		limit->admitted = 0;
+		limit->sampledOut = 0;
+		limit->rateLimited = 0;
+		limit->reportedSampledOut = 0;
+		limit->reportedRateLimited = 0;
+
+		std::string report;
+		{
+			Poco::FastMutex::ScopedLock lock(limitsMutex);
+			LogLimit*& existing = limits[limit->prefix];
+			if (existing)
+			{
+				Poco::FastMutex::ScopedLock limitLock(existing->mutex);
+				report = TakeReport(existing);
+				Retire(existing);
+			}
+			existing = limit;
+			AtomicAdd(&limitsGeneration, 1);
+			active = true;
+		}
+		LogReport(PRODUCT_NAME, report);
+		UpdateReportTimer();
+	}
+
+	/*static*/
+	void LogLimiter::RemoveLimit(std::string prefix)
+	{
+		std::string report;
+		{
+			Poco::FastMutex::ScopedLock lock(limitsMutex);
+			std::map<std::string, LogLimit*>::iterator i =
+				limits.find(NormalizePrefix(prefix));
+			if (i == limits.end())
+				return;
+
+			{
+				Poco::FastMutex::ScopedLock limitLock(i->second->mutex);
+				report = TakeReport(i->second);
+			}
+			Retire(i->second);
+			limits.erase(i);
+			active = !limits.empty();
+		}
+		LogReport(PRODUCT_NAME, report);
+		UpdateReportTimer();
+	}
+
+	/*static*/
+	void LogLimiter::RemoveAllLimits()
+	{
+		{
+			Poco::FastMutex::ScopedLock lock(limitsMutex);
+			std::map<std::string, LogLimit*>::iterator i = limits.begin();
+			for (; i != limits.end(); i++)
+				Retire(i->second);
+			limits.clear();
+			active = false;
+		}
+		UpdateReportTimer();
+
+		// Report once the timer is stopped, so that nothing is left over.
+		ReportSuppressed();
+	}
+
+	/*static*/
+	void LogLimiter::GetLimits(std::vector<LogLimitInfo>& info)
+	{
+		Poco::FastMutex::ScopedLock lock(limitsMutex);
+		std::map<std::string, LogLimit*>::iterator i = limits.begin();
+		for (; i != limits.end(); i++)
+		{
+			LogLimit* limit = i->second;
+			Poco::FastMutex::ScopedLock limitLock(limit->mutex);
+
+			LogLimitInfo l;
+			l.prefix = limit->prefix;
+			l.messagesPerSecond = limit->messagesPerSecond;
+			l.burst = limit->burst;
+			l.sampleEvery = limit->sampleEvery;
+			l.admitted = limit->admitted;
+			l.sampledOut = limit->sampledOut;
+			l.rateLimited = limit->rateLimited;
+			info.push_back(l);
+		}
+	}
+
+	/*static*/
+	void LogLimiter::ReportSuppressed()
+	{
+		std::vector<std::string> reports;
+		{
+			Poco::FastMutex::ScopedLock lock(limitsMutex);
+			std::map<std::string, LogLimit*>::iterator i = limits.begin();
+			for (; i != limits.end(); i++)
+			{
+				Poco::FastMutex::ScopedLock limitLock(i->second->mutex);
+				reports.push_back(TakeReport(i->second));
+			}
+			for (size_t j = 0; j < retiredLimits.size(); j++)
+			{
+				Poco::FastMutex::ScopedLock limitLock(retiredLimits[j]->mutex);
+				reports.push_back(TakeReport(retiredLimits[j]));
+			}
+
+			// Adding nothing still acts as a barrier, which orders the
+			// generation changes made when retiring before this load.
+			if (AtomicAdd(&admitting, 0) == 0)
+			{
+				for (size_t j = 0; j < retiredLimits.size(); j++)
+					delete retiredLimits[j];
+				retiredLimits.clear();
+			}
+		}
+
+		for (size_t i = 0; i < reports.size(); i++)
+			LogReport(PRODUCT_NAME, reports[i]);
+	}
+
+	/*static*/
+	bool LogLimiter::AdmitLimited(Logger* logger)
+	{
+		// Find the limit again whenever the limits have changed. Counting
+		// the admission first keeps a retired limit alive while it is used.
+		AdmissionScope admission;
+		AtomicWord generation = limitsGeneration;
+		if (logger->limitGeneration != generation)
+		{
+			Poco::FastMutex::ScopedLock lock(limitsMutex);
+			logger->limit = FindLimit(logger->GetName());
+			logger->limitGeneration = limitsGeneration;
+		}
+
+		LogLimit* limit = logger->limit;
+		if (!limit)
+			return true;
+
+		Poco::FastMutex::ScopedLock lock(limit->mutex);
+		if (limit->sampleEvery > 1 && (limit->seen++ % limit->sampleEvery) != 0)
+		{
+			limit->sampledOut++;
+			return false;
+		}
+
+		if (limit->messagesPerSecond > 0)
+		{
+			double elapsed = (double) limit->lastRefill.elapsed() /
+				(double) Poco::Timestamp::resolution();
+			limit->lastRefill.update();
+			limit->tokens += elapsed * limit->messagesPerSecond;
+			if (limit->tokens > limit->burst)
+				limit->tokens = limit->burst;
+
+			if (limit->tokens < 1.0)
+			{
+				limit->rateLimited++;
+				return false;
+			}
+			limit->tokens -= 1.0;
+		}
+
+		limit->admitted++;
+		return true;
+	}
+}
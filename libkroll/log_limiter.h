@@ -0,0 +1,80 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_LOG_LIMITER_H_
+#define _KR_LOG_LIMITER_H_
+
+#include <string>
+#include <vector>
+
+namespace kroll
+{
+	struct LogLimit;
+
+	/**
+	 * The configuration and counters of one log limit.
+	 */
+	struct KROLL_API LogLimitInfo
+	{
+		std::string prefix;
+		double messagesPerSecond;
+		int burst;
+		int sampleEvery;
+		size_t admitted;
+		size_t sampledOut;
+		size_t rateLimited;
+	};
+
+	/**
+	 * Rate limits and sampling for loggers, configured per logger name
+	 * prefix. A prefix such as "Kroll.JavaScript" or "Kroll.JavaScript.*"
+	 * covers that logger and all of its children; when several prefixes
+	 * match, the longest one applies.
+	 *
+	 * Of the messages a limited logger lets through its level, only every
+	 * sampleEvery-th one is kept, and of those only as many as a token
+	 * bucket allows: burst messages at once, refilled at messagesPerSecond.
+	 * Everything else is dropped before it is formatted. How many messages
+	 * were dropped is logged every few seconds while any limit is set, when
+	 * a limit is replaced or removed, and once more at shutdown.
+	 *
+	 * Loggers without a limit only pay for reading one flag.
+	 */
+	class KROLL_API LogLimiter
+	{
+		public:
+		/**
+		 * Limit the loggers under prefix, replacing any limit it had.
+		 * @param messagesPerSecond zero for no rate limit
+		 * @param sampleEvery one to keep every message
+		 */
+		static void SetLimit(std::string prefix, double messagesPerSecond,
+			int burst, int sampleEvery=1);
+		static void RemoveLimit(std::string prefix);
+		static void RemoveAllLimits();
+		static void GetLimits(std::vector<LogLimitInfo>& limits);
+		static bool IsActive() { return active; }
+
+		/**
+		 * @return whether logger may log a message now. Called by Logger
+		 * once the message passed the logger's level.
+		 */
+		static bool Admit(Logger* logger)
+		{
+			return !active || AdmitLimited(logger);
+		}
+
+		/**
+		 * Log the number of messages dropped since the last report.
+		 */
+		static void ReportSuppressed();
+
+		private:
+		static volatile bool active;
+		static bool AdmitLimited(Logger* logger);
+	};
+}
+
+#endif
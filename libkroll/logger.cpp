@@ -6,15 +6,29 @@
 #include "kroll.h"
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <Poco/Mutex.h>
 #include <Poco/ScopedLock.h>
 #include <Poco/PatternFormatter.h>
 #include <Poco/Path.h>
 #include <Poco/File.h>
+#include <Poco/Timestamp.h>
+#include <Poco/RWLock.h>
+#include <Poco/DateTimeFormatter.h>
+#include <Poco/DeflatingStream.h>
+#include <Poco/FileStream.h>
+#include <Poco/StreamCopier.h>
+#include <deque>
+#include <algorithm>
 
-#define LOGGER_MAX_ENTRY_SIZE 2048
+#define LOGGER_INITIAL_BUFFER_SIZE 2048
+#define LOGGER_RETAINED_BUFFER_SIZE (64 * 1024)
+#define LOGGER_BATCH_SIZE 256
+#define LOGGER_FLUSH_INTERVAL 200
 
 using Poco::PatternFormatter;
 using Poco::Path;
@@ -23,8 +37,70 @@ using Poco::File;
 namespace kroll
 {
 	std::map<std::string, Logger*> Logger::loggers;
-	char Logger::buffer[LOGGER_MAX_ENTRY_SIZE];
-	Poco::Mutex Logger::mutex;
+
+	// Loggers are looked up far more often than they are created.
+	static Poco::RWLock loggersLock;
+
+	/**
+	 * The buffer each thread formats its messages into. It grows to fit
+	 * the longest message, but one which grew unusually large is given
+	 * back after use.
+	 */
+	struct FormatBuffer
+	{
+		char* data;
+		size_t size;
+	};
+
+	static void DestroyFormatBuffer(void* data)
+	{
+		FormatBuffer* buffer = static_cast<FormatBuffer*>(data);
+		free(buffer->data);
+		free(buffer);
+	}
+
+	static ThreadLocal<FormatBuffer> threadFormatBuffer = { &DestroyFormatBuffer };
+
+	static FormatBuffer* GetFormatBuffer()
+	{
+		FormatBuffer* buffer = threadFormatBuffer.Get();
+		if (!buffer)
+		{
+			buffer = static_cast<FormatBuffer*>(calloc(1, sizeof(FormatBuffer)));
+			threadFormatBuffer.Set(buffer);
+		}
+
+		if (!buffer->data)
+		{
+			buffer->size = LOGGER_INITIAL_BUFFER_SIZE;
+			buffer->data = static_cast<char*>(malloc(buffer->size));
+		}
+		return buffer;
+	}
+
+	/**
+	 * @return the length of the formatted text, even when it did not fit
+	 */
+	static int FormatInto(char* data, size_t size, const char* format, va_list args)
+	{
+		va_list copy;
+		va_copy(copy, args);
+#ifdef OS_WIN32
+		// MSVC's vsnprintf gives up with -1 when the text does not fit.
+		int length = _vsnprintf(data, size, format, copy);
+		va_end(copy);
+		if (length < 0 || (size_t) length >= size)
+		{
+			va_copy(copy, args);
+			length = _vscprintf(format, copy);
+			va_end(copy);
+		}
+#else
+		int length = vsnprintf(data, size, format, copy);
+		va_end(copy);
+#endif
+		return length;
+	}
 
 	/*static*/
 	Logger* Logger::Get(std::string name)
@@ -36,20 +112,52 @@ namespace kroll
 	/*static*/
 	void Logger::Initialize(bool console, std::string logFilePath, Level level)
 	{
-		Logger::loggers[PRODUCT_NAME] = 
-			new RootLogger(console, logFilePath, level);
+		RootLogger* root = new RootLogger(console, logFilePath, level);
+		Poco::RWLock::ScopedLock lock(loggersLock, true);
+		Logger::loggers[PRODUCT_NAME] = root;
 	}
 
 	/*static*/
 	void Logger::Shutdown()
 	{
-		std::map<std::string, Logger*>::iterator i = loggers.begin();
-		while (i != loggers.end())
+		// Write out everything which is still recorded or queued while
+		// all of the loggers are alive. Removing the limits reports what
+		// they suppressed and stops their periodic reports.
+		LogLimiter::RemoveAllLimits();
+		DeferredLog::Disable();
+		if (RootLogger::instance)
+			RootLogger::instance->StopWriter();
+
+		std::map<std::string, Logger*> oldLoggers;
+		{
+			Poco::RWLock::ScopedLock lock(loggersLock, true);
+			oldLoggers.swap(loggers);
+		}
+
+		std::map<std::string, Logger*>::iterator i = oldLoggers.begin();
+		while (i != oldLoggers.end())
 		{
 			Logger* l = (i++)->second;
 			delete l;
 		}
-		loggers.clear();
+	}
+
+	/*static*/
+	void Logger::EnableAsynchronousLogging(OverflowPolicy policy, size_t capacity)
+	{
+		if (RootLogger::instance)
+			RootLogger::instance->StartWriter(policy, capacity);
+	}
+
+	/*static*/
+	void Logger::SetLogRotation(size_t maxBytes, long maxSeconds,
+		int retainedFiles, bool compress)
+	{
+		if (RootLogger::instance)
+		{
+			RootLogger::instance->SetRotation(maxBytes, maxSeconds,
+				retainedFiles, compress);
+		}
 	}
 
 	/*static*/
@@ -69,11 +177,23 @@ namespace kroll
 	/*static*/
 	Logger* Logger::GetImpl(std::string name)
 	{
-		if (loggers.find(name) == loggers.end())
 		{
-			loggers[name] = new Logger(name);
+			Poco::RWLock::ScopedLock lock(loggersLock, false);
+			std::map<std::string, Logger*>::iterator i = loggers.find(name);
+			if (i != loggers.end())
+				return i->second;
 		}
-		return loggers[name];
+
+		// A new logger looks up its parent to inherit the level, so it
+		// is created without holding the lock. Another thread may have
+		// added the same one in the meantime, in which case it wins.
+		Logger* logger = new Logger(name);
+		Poco::RWLock::ScopedLock lock(loggersLock, true);
+		std::pair<std::map<std::string, Logger*>::iterator, bool> result =
+			loggers.insert(std::make_pair(name, logger));
+		if (!result.second)
+			delete logger;
+		return result.first->second;
 	}
 
 	Logger::Level Logger::GetLevel(std::string& levelString)
@@ -101,7 +221,9 @@ namespace kroll
 	}
 
 	Logger::Logger(std::string name) :
-		name(name)
+		name(name),
+		limit(0),
+		limitGeneration(0)
 	{
 		Logger* parent = this->GetParent();
 		this->level = parent->GetLevel();
@@ -109,7 +231,9 @@ namespace kroll
 
 	Logger::Logger(std::string name, Level level) :
 		name(name),
-		level(level)
+		level(level),
+		limit(0),
+		limitGeneration(0)
 	{ }
 
 	std::string& Logger::GetName()
@@ -202,7 +326,7 @@ namespace kroll
 	{
 		// This check only happens at the entry logger and never in it's
 		// parents. This is so a child logger can have a more permissive level.
-		if ((Level) m.getPriority() <= this->level)
+		if ((Level) m.getPriority() <= this->level && LogLimiter::Admit(this))
 		{
 			RootLogger* root = RootLogger::instance;
 			root->LogImpl(m);
@@ -219,25 +343,61 @@ namespace kroll
 	{
 		// Don't do formatting when this logger filters the message.
 		// This prevents unecessary string manipulation.
-		if (level <= this->level)
+		if (level <= this->level && LogLimiter::Admit(this))
 		{
-			std::string messageText = Logger::Format(format, args);
-			this->Log(level, messageText);
+			Poco::Message m(this->name, Logger::Format(format, args),
+				(Poco::Message::Priority) level);
+			RootLogger::instance->LogImpl(m);
 		}
 	}
 
 	/*static*/
 	std::string Logger::Format(const char* format, va_list args)
 	{
-		// Protect the buffer
-		Poco::Mutex::ScopedLock lock(mutex);
+		FormatBuffer* buffer = GetFormatBuffer();
+		int length = FormatInto(buffer->data, buffer->size, format, args);
+		if (length < 0)
+			return std::string();
 
-		vsnprintf(Logger::buffer, LOGGER_MAX_ENTRY_SIZE - 1, format, args);
-		Logger::buffer[LOGGER_MAX_ENTRY_SIZE - 1] = '\0';
-		std::string text = buffer;
+		if ((size_t) length >= buffer->size)
+		{
+			free(buffer->data);
+			buffer->size = length + 1;
+			buffer->data = static_cast<char*>(malloc(buffer->size));
+			FormatInto(buffer->data, buffer->size, format, args);
+		}
+
+		std::string text(buffer->data, length);
+		if (buffer->size > LOGGER_RETAINED_BUFFER_SIZE)
+		{
+			free(buffer->data);
+			buffer->data = 0;
+		}
 		return text;
 	}
 
+	void Logger::Log(Level level, LogFormat* format, va_list args)
+	{
+		if (level <= this->level && LogLimiter::Admit(this) &&
+			!DeferredLog::Record(this, level, *format, args))
+		{
+			Poco::Message m(this->name, Logger::Format(format->format, args),
+				(Poco::Message::Priority) level);
+			RootLogger::instance->LogImpl(m);
+		}
+	}
+
+	void Logger::Log(Level level, LogFormat* format, ...)
+	{
+		if (IsEnabled(level))
+		{
+			va_list args;
+			va_start(args, format);
+			this->Log(level, format, args);
+			va_end(args);
+		}
+	}
+
 	void Logger::Log(Level level, const char* format, ...)
 	{
 		if (IsEnabled(level))
@@ -268,6 +428,17 @@ namespace kroll
 		}
 	}
 
+	void Logger::Trace(LogFormat* format, ...)
+	{
+		if (IsTraceEnabled())
+		{
+			va_list args;
+			va_start(args, format);
+			this->Log(LTRACE, format, args);
+			va_end(args);
+		}
+	}
+
 	void Logger::Debug(std::string message)
 	{
 		if (IsDebugEnabled())
@@ -287,6 +458,17 @@ namespace kroll
 		}
 	}
 
+	void Logger::Debug(LogFormat* format, ...)
+	{
+		if (IsDebugEnabled())
+		{
+			va_list args;
+			va_start(args, format);
+			this->Log(LDEBUG, format, args);
+			va_end(args);
+		}
+	}
+
 	void Logger::Info(std::string message)
 	{
 		if (IsInfoEnabled())
@@ -401,11 +583,333 @@ namespace kroll
 		}
 	}
 
+	/**
+	 * A bounded queue of messages which any thread may push to or pop
+	 * from without taking a lock. Each slot carries a sequence number
+	 * which tells whether it is ready to be written or read in the
+	 * current lap around the ring, so a full or empty queue is detected
+	 * without the two ends ever touching the same counter.
+	 */
+	class LogQueue
+	{
+		public:
+		LogQueue(size_t capacity) :
+			enqueuePosition(0),
+			dequeuePosition(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			this->mask = size - 1;
+			this->slots = new Slot[size];
+			for (size_t i = 0; i < size; i++)
+				this->slots[i].sequence = (AtomicWord) i;
+		}
+
+		~LogQueue()
+		{
+			delete [] this->slots;
+		}
+
+		bool TryPush(Poco::Message& message)
+		{
+			AtomicWord position = this->enqueuePosition;
+			while (true)
+			{
+				Slot& slot = this->slots[position & this->mask];
+				AtomicWord difference = Distance(slot.sequence, position);
+				if (difference == 0)
+				{
+					if (AtomicCompareAndSwap(&this->enqueuePosition, position, position + 1))
+					{
+						slot.message = message;
+						AtomicAdd(&slot.sequence, 1);
+						return true;
+					}
+					position = this->enqueuePosition;
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = this->enqueuePosition;
+				}
+			}
+		}
+
+		bool TryPop(Poco::Message& message)
+		{
+			AtomicWord position = this->dequeuePosition;
+			while (true)
+			{
+				Slot& slot = this->slots[position & this->mask];
+				AtomicWord difference = Distance(slot.sequence, position + 1);
+				if (difference == 0)
+				{
+					if (AtomicCompareAndSwap(&this->dequeuePosition, position, position + 1))
+					{
+						message = slot.message;
+						AtomicAdd(&slot.sequence, (AtomicWord) this->mask);
+						return true;
+					}
+					position = this->dequeuePosition;
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = this->dequeuePosition;
+				}
+			}
+		}
+
+		private:
+		struct Slot
+		{
+			volatile AtomicWord sequence;
+			Poco::Message message;
+		};
+
+		// Positions wrap around, so compare them by their distance.
+		static AtomicWord Distance(AtomicWord a, AtomicWord b)
+		{
+			return (AtomicWord) ((unsigned long) a - (unsigned long) b);
+		}
+
+		Slot* slots;
+		size_t mask;
+		volatile AtomicWord enqueuePosition;
+		volatile AtomicWord dequeuePosition;
+	};
+
+	/**
+	 * The name of a rotated log file, split into the timestamp which
+	 * RotateLogFile gives it and the number it adds when a second holds
+	 * more than one rotation.
+	 */
+	struct RotatedName
+	{
+		std::string name;
+		std::string stamp;
+		int number;
+
+		bool operator<(const RotatedName& other) const
+		{
+			if (stamp != other.stamp)
+				return stamp < other.stamp;
+			return number < other.number;
+		}
+	};
+
+	static bool AllDigits(const std::string& text, size_t start, size_t count)
+	{
+		if (count == 0 || start + count > text.size())
+			return false;
+		for (size_t i = start; i < start + count; i++)
+		{
+			if (!isdigit((unsigned char) text[i]))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Parse a name of the form <prefix>YYYYMMDD-HHMMSS[-n][.gz], so that
+	 * other files which happen to share the log file's name are left alone.
+	 */
+	static bool ParseRotatedName(const std::string& name, size_t prefixSize,
+		RotatedName& parsed)
+	{
+		std::string rest(name.substr(prefixSize));
+		if (rest.size() > 3 && rest.compare(rest.size() - 3, 3, ".gz") == 0)
+			rest.erase(rest.size() - 3);
+
+		if (!AllDigits(rest, 0, 8) || rest.size() < 15 || rest[8] != '-' ||
+			!AllDigits(rest, 9, 6))
+			return false;
+
+		parsed.name = name;
+		parsed.stamp = rest.substr(0, 15);
+		parsed.number = 0;
+		if (rest.size() == 15)
+			return true;
+
+		if (rest[15] != '-' || !AllDigits(rest, 16, rest.size() - 16))
+			return false;
+		parsed.number = atoi(rest.c_str() + 16);
+		return true;
+	}
+
+	/**
+	 * Compresses rotated log files and prunes old ones on its own thread.
+	 * Problems are reported on stderr, since logging them could recurse.
+	 */
+	class LogCompressor : public Poco::Runnable
+	{
+		public:
+		LogCompressor(const std::string& logFilePath, int retainedFiles, bool compress) :
+			logFilePath(logFilePath),
+			retainedFiles(retainedFiles),
+			compress(compress),
+			stopping(false)
+		{
+			this->thread.setName("LogCompressor");
+			this->thread.start(*this);
+		}
+
+		/**
+		 * Finish with every file handed over so far.
+		 */
+		~LogCompressor()
+		{
+			this->stopping = true;
+			this->event.set();
+			this->thread.join();
+		}
+
+		void Add(const std::string& rotatedPath)
+		{
+			{
+				Poco::Mutex::ScopedLock lock(this->mutex);
+				this->pending.push_back(rotatedPath);
+			}
+			this->event.set();
+		}
+
+		void run()
+		{
+			START_KROLL_THREAD;
+			while (true)
+			{
+				std::string path;
+				{
+					Poco::Mutex::ScopedLock lock(this->mutex);
+					if (!this->pending.empty())
+					{
+						path = this->pending.front();
+						this->pending.pop_front();
+					}
+				}
+
+				if (!path.empty())
+				{
+					if (this->compress)
+						this->Compress(path);
+					this->Prune();
+				}
+				else if (this->stopping)
+				{
+					break;
+				}
+				else
+				{
+					this->event.wait();
+				}
+			}
+			END_KROLL_THREAD;
+		}
+
+		private:
+		std::string logFilePath;
+		int retainedFiles;
+		bool compress;
+		volatile bool stopping;
+		Poco::Mutex mutex;
+		std::deque<std::string> pending;
+		Poco::Event event;
+		Poco::Thread thread;
+
+		void Compress(const std::string& path)
+		{
+			std::string compressedPath(path + ".gz");
+			try
+			{
+				{
+					Poco::FileInputStream in(path);
+					Poco::FileOutputStream out(compressedPath);
+					Poco::DeflatingOutputStream deflater(out,
+						Poco::DeflatingStreamBuf::STREAM_GZIP);
+					Poco::StreamCopier::copyStream(in, deflater);
+					deflater.close();
+				}
+				File(path).remove();
+			}
+			catch (Poco::Exception& e)
+			{
+				std::cerr << "Could not compress " << path << ": "
+					<< e.displayText() << std::endl;
+				try
+				{
+					File(compressedPath).remove();
+				}
+				catch (Poco::Exception&) {}
+			}
+		}
+
+		void Prune()
+		{
+			// Rotated files are named after the log file plus a sortable
+			// timestamp and, within a second, a number, so the oldest ones
+			// sort first.
+			std::string directory(FileUtils::Dirname(this->logFilePath));
+			std::string prefix(FileUtils::Basename(this->logFilePath) + ".");
+			std::vector<std::string> names;
+			std::vector<RotatedName> rotated;
+			try
+			{
+				File(directory).list(names);
+			}
+			catch (Poco::Exception&)
+			{
+				return;
+			}
+
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				RotatedName parsed;
+				if (names[i].compare(0, prefix.size(), prefix) == 0 &&
+					ParseRotatedName(names[i], prefix.size(), parsed))
+					rotated.push_back(parsed);
+			}
+
+			std::sort(rotated.begin(), rotated.end());
+			for (size_t i = 0; i + this->retainedFiles < rotated.size(); i++)
+			{
+				try
+				{
+					File(FileUtils::Join(directory.c_str(), rotated[i].name.c_str(), 0)).remove();
+				}
+				catch (Poco::Exception& e)
+				{
+					std::cerr << "Could not remove old log file " << rotated[i].name
+						<< ": " << e.displayText() << std::endl;
+				}
+			}
+		}
+	};
+
 	RootLogger* RootLogger::instance = NULL;
 	RootLogger::RootLogger(bool consoleLogging, std::string logFilePath, Level level) :
 		Logger(PRODUCT_NAME, level),
 		consoleLogging(consoleLogging),
-		fileLogging(!logFilePath.empty())
+		fileLogging(!logFilePath.empty()),
+		logFilePath(logFilePath),
+		queue(0),
+		overflowPolicy(BLOCK_WHEN_FULL),
+		writerThread(0),
+		writerAdapter(0),
+		writerSleeping(0),
+		droppedMessages(0),
+		stopping(false),
+		rotateBytes(0),
+		rotateSeconds(0),
+		logFileSize(0),
+		compressor(0)
 	{
 		RootLogger::instance = this;
 		this->formatter = new PatternFormatter("[%H:%M:%S:%i] [%s] [%p] %t");
@@ -416,48 +920,158 @@ namespace kroll
 			string logDirectory = FileUtils::Dirname(logFilePath);
 			File logDirectoryFile = File(logDirectory);
 			logDirectoryFile.createDirectories();
+			this->OpenLogFile();
+		}
+	}
+
+	RootLogger::~RootLogger()
+	{
+		this->StopWriter();
+		if (fileLogging)
+		{
+			this->logFile.close();
+		}
+		delete this->compressor;
+	}
 
+	void RootLogger::OpenLogFile()
+	{
+#ifdef OS_WIN32
+		this->logFile.open(UTF8ToWide(logFilePath).c_str(),
+			 std::ios::out | std::ios::trunc);
+#else
+		this->logFile.open(logFilePath.c_str(),
+			 std::ios::out | std::ios::trunc);
+#endif
+
+		// Couldn't open the file, perhaps there is contention?
+		if (!this->logFile.is_open())
+		{
+			this->fileLogging = false;
+		}
+
+		this->logFileSize = 0;
+		this->logFileOpened.update();
+	}
+
+	void RootLogger::SetRotation(size_t maxBytes, long maxSeconds,
+		int retainedFiles, bool compress)
+	{
+		Poco::Mutex::ScopedLock lock(mutex);
+		if (!fileLogging)
+			return;
+
+		this->rotateBytes = maxBytes;
+		this->rotateSeconds = maxSeconds;
+		delete this->compressor;
+		this->compressor = new LogCompressor(this->logFilePath,
+			retainedFiles, compress);
+	}
+
+	void RootLogger::RotateLogFile()
+	{
+		this->logFile.close();
+
+		// A second can hold more than one rotation of a busy log.
+		std::string stamp(Poco::DateTimeFormatter::format(
+			Poco::Timestamp(), "%Y%m%d-%H%M%S"));
+		std::string rotatedPath(this->logFilePath + "." + stamp);
+		for (int i = 1; File(rotatedPath).exists() ||
+			File(rotatedPath + ".gz").exists(); i++)
+		{
+			std::ostringstream numbered;
+			numbered << this->logFilePath << "." << stamp << "-" << i;
+			rotatedPath = numbered.str();
+		}
+
+		try
+		{
+			File(this->logFilePath).renameTo(rotatedPath);
+			this->compressor->Add(rotatedPath);
+		}
+		catch (Poco::Exception& e)
+		{
+			// Keep logging to the same file rather than losing messages.
+			std::cerr << "Could not rotate the log file: " << e.displayText() << std::endl;
 #ifdef OS_WIN32
 			this->logFile.open(UTF8ToWide(logFilePath).c_str(),
-				 std::ios::out | std::ios::trunc);
+				std::ios::out | std::ios::app);
 #else
-			this->logFile.open(logFilePath.c_str(),
-				 std::ios::out | std::ios::trunc);
+			this->logFile.open(logFilePath.c_str(), std::ios::out | std::ios::app);
 #endif
+			this->logFileOpened.update();
+			return;
+		}
+
+		this->OpenLogFile();
+	}
 
-			// Couldn't open the file, perhaps there is contention?
-			if (!this->logFile.is_open())
+	void RootLogger::LogImpl(Poco::Message& m)
+	{
+		// Callbacks run on the writer thread, and messages they log must
+		// not wait for the writer to make room for them. They must not
+		// wait for queueLock either, since a thread blocked pushing holds
+		// it until the writer makes room.
+		if (Poco::Thread::current() != this->writerThread)
+		{
+			Poco::RWLock::ScopedLock lock(queueLock, false);
+			if (this->queue && !this->stopping)
 			{
-				this->fileLogging = false;
+				this->Push(m);
+				return;
 			}
 		}
+
+		Poco::Mutex::ScopedLock lock(mutex);
+		this->Write(m);
+		this->Flush();
 	}
 
-	RootLogger::~RootLogger()
+	void RootLogger::Push(Poco::Message& m)
 	{
-		if (fileLogging)
+		while (!this->queue->TryPush(m))
 		{
-			this->logFile.close();
+			if (this->overflowPolicy == DROP_NEWEST)
+			{
+				AtomicAdd(&this->droppedMessages, 1);
+				return;
+			}
+			else if (this->overflowPolicy == DROP_OLDEST)
+			{
+				Poco::Message oldest;
+				if (this->queue->TryPop(oldest))
+					AtomicAdd(&this->droppedMessages, 1);
+			}
+			else
+			{
+				this->WakeWriter();
+				Poco::Thread::yield();
+			}
 		}
+		this->WakeWriter();
 	}
 
-	void RootLogger::LogImpl(Poco::Message& m)
+	void RootLogger::Write(Poco::Message& m)
 	{
-		Poco::Mutex::ScopedLock lock(mutex);
 		Level level = (Level) m.getPriority();
 		std::string line;
 		this->formatter->format(m, line);
 
 		if (fileLogging)
 		{
-			this->logFile << line << std::endl;
-			this->logFile.flush();
+			this->logFile << line << '\n';
+			this->logFileSize += line.size() + 1;
+			if ((this->rotateBytes && this->logFileSize >= this->rotateBytes) ||
+				(this->rotateSeconds &&
+				this->logFileOpened.isElapsed(this->rotateSeconds * Poco::Timestamp::resolution())))
+			{
+				this->RotateLogFile();
+			}
 		}
 
 		if (consoleLogging)
 		{
 			printf("%s\n", line.c_str());
-			fflush(stdout);
 		}
 
 		for (size_t i = 0; i < callbacks.size(); i++)
@@ -466,6 +1080,144 @@ namespace kroll
 		}
 	}
 
+	void RootLogger::Flush()
+	{
+		if (fileLogging)
+		{
+			this->logFile.flush();
+		}
+
+		if (consoleLogging)
+		{
+			fflush(stdout);
+		}
+	}
+
+	void RootLogger::StartWriter(OverflowPolicy policy, size_t capacity)
+	{
+		Poco::RWLock::ScopedLock lock(queueLock, true);
+		if (this->queue)
+			return;
+
+		this->overflowPolicy = policy;
+		this->stopping = false;
+		this->writerAdapter = new Poco::RunnableAdapter<RootLogger>(*this,
+			&RootLogger::RunWriter);
+		this->writerThread = new Poco::Thread();
+		this->writerThread->setName("Logger");
+		this->queue = new LogQueue(capacity);
+		this->writerThread->start(*this->writerAdapter);
+	}
+
+	void RootLogger::StopWriter()
+	{
+		// Wait for the threads which are pushing, while the writer still
+		// makes room for them. Once stopping is set, others write
+		// synchronously, so nothing is pushed after the last drain.
+		{
+			Poco::RWLock::ScopedLock lock(queueLock, true);
+			if (!this->queue || this->stopping)
+				return;
+			this->stopping = true;
+		}
+
+		this->writerEvent.set();
+		this->writerThread->join();
+
+		{
+			Poco::Mutex::ScopedLock lock(mutex);
+			Poco::Message m;
+			while (this->queue->TryPop(m))
+				this->Write(m);
+			this->ReportDroppedMessages();
+			this->Flush();
+		}
+
+		Poco::RWLock::ScopedLock lock(queueLock, true);
+		delete this->queue;
+		this->queue = 0;
+		delete this->writerThread;
+		delete this->writerAdapter;
+		this->writerThread = 0;
+		this->writerAdapter = 0;
+	}
+
+	void RootLogger::WakeWriter()
+	{
+		if (this->writerSleeping && AtomicCompareAndSwap(&this->writerSleeping, 1, 0))
+			this->writerEvent.set();
+	}
+
+	void RootLogger::ReportDroppedMessages()
+	{
+		AtomicWord dropped = this->droppedMessages;
+		while (dropped && !AtomicCompareAndSwap(&this->droppedMessages, dropped, 0))
+			dropped = this->droppedMessages;
+
+		if (dropped)
+		{
+			std::ostringstream text;
+			text << "Dropped " << dropped << " log messages because the log "
+				"queue was full";
+			Poco::Message m(this->name, text.str(), Poco::Message::PRIO_WARNING);
+			this->Write(m);
+		}
+	}
+
+	void RootLogger::RunWriter()
+	{
+		START_KROLL_THREAD;
+
+		Poco::Message m;
+		Poco::Timestamp lastFlush;
+		bool unflushed = false;
+		while (true)
+		{
+			int written = 0;
+			{
+				Poco::Mutex::ScopedLock lock(mutex);
+				while (written < LOGGER_BATCH_SIZE && this->queue->TryPop(m))
+				{
+					this->Write(m);
+					written++;
+				}
+				this->ReportDroppedMessages();
+
+				// Flush when caught up, and now and then under sustained load.
+				unflushed = unflushed || written > 0;
+				if (unflushed && (written < LOGGER_BATCH_SIZE ||
+					lastFlush.isElapsed(LOGGER_FLUSH_INTERVAL * 1000)))
+				{
+					this->Flush();
+					lastFlush.update();
+					unflushed = false;
+				}
+			}
+
+			if (written == LOGGER_BATCH_SIZE)
+				continue;
+			if (this->stopping)
+				break;
+
+			// Check the queue once more after announcing that the writer is
+			// going to sleep, so that a message pushed in between still
+			// wakes it up.
+			this->writerSleeping = 1;
+			if (this->queue->TryPop(m))
+			{
+				this->writerSleeping = 0;
+				Poco::Mutex::ScopedLock lock(mutex);
+				this->Write(m);
+				unflushed = true;
+				continue;
+			}
+			this->writerEvent.tryWait(LOGGER_FLUSH_INTERVAL);
+			this->writerSleeping = 0;
+		}
+
+		END_KROLL_THREAD;
+	}
+
 	void RootLogger::AddLoggerCallback(LoggerCallback callback)
 	{
 		Poco::Mutex::ScopedLock lock(mutex);
@@ -6,7 +6,12 @@
 #include <Poco/Logger.h>
 #include <Poco/Message.h>
 #include <Poco/Mutex.h>
+#include <Poco/RWLock.h>
 #include <Poco/PatternFormatter.h>
+#include <Poco/Thread.h>
+#include <Poco/Event.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Timestamp.h>
 #include <cstdarg>
 #include <iostream>
 #include <fstream>
@@ -14,6 +19,10 @@
 namespace kroll
 {
 	class RootLogger;
+	class LogQueue;
+	class LogCompressor;
+	struct LogFormat;
+	struct LogLimit;
 	class KROLL_API Logger
 	{
 		public:
@@ -30,6 +39,19 @@ namespace kroll
 		} Level;
 		typedef void (*LoggerCallback)(Level, std::string&);
 
+		/**
+		 * What asynchronous logging does with a message when its queue
+		 * is full: wait for room, discard the oldest queued message, or
+		 * discard the new one. Discarded messages are counted and
+		 * reported in the log once there is room again.
+		 */
+		typedef enum
+		{
+			BLOCK_WHEN_FULL,
+			DROP_OLDEST,
+			DROP_NEWEST
+		} OverflowPolicy;
+
 		static Logger* Get(std::string name);
 		static Logger* GetRootLogger();
 		static void Initialize(bool, std::string, Level);
@@ -37,7 +59,29 @@ namespace kroll
 		static Level GetLevel(std::string& level);
 		static void AddLoggerCallback(LoggerCallback callback);
 
-		Logger() {};
+		/**
+		 * Hand messages to a writer thread instead of writing them on the
+		 * caller's thread. The writer formats and writes them in batches
+		 * and flushes whenever it catches up. Everything queued is written
+		 * before Shutdown returns.
+		 * @param capacity the number of messages which may be queued,
+		 * rounded up to a power of two
+		 */
+		static void EnableAsynchronousLogging(OverflowPolicy policy=BLOCK_WHEN_FULL,
+			size_t capacity=4096);
+
+		/**
+		 * Start a new log file once the current one reaches maxBytes or
+		 * has been open for maxSeconds, whichever comes first; zero turns
+		 * either limit off. Old files are renamed with a timestamp and
+		 * then gzipped and pruned to the newest retainedFiles on a
+		 * background thread, so rotating only costs the logging thread
+		 * a rename.
+		 */
+		static void SetLogRotation(size_t maxBytes, long maxSeconds,
+			int retainedFiles=5, bool compress=true);
+
+		Logger() : limit(0), limitGeneration(0) {};
 		virtual ~Logger() {};
 		Logger(std::string);
 		Logger(std::string, Level);
@@ -64,11 +108,20 @@ namespace kroll
 		void Log(Level, const char*, ...);
 		static std::string Format(const char*, va_list);
 
+		/**
+		 * Log with a format which may be recorded now and formatted
+		 * later, when DeferredLog is enabled.
+		 */
+		void Log(Level, LogFormat*, va_list);
+		void Log(Level, LogFormat*, ...);
+
 		void Trace(std::string);
 		void Trace(const char*, ...);
+		void Trace(LogFormat*, ...);
 
 		void Debug(std::string);
 		void Debug(const char*, ...);
+		void Debug(LogFormat*, ...);
 
 		void Info(std::string);
 		void Info(const char*, ...);
@@ -91,13 +144,50 @@ namespace kroll
 		protected:
 		std::string name;
 		Level level;
-		static Poco::Mutex mutex;
-		static char buffer[];
+
+		// The LogLimiter limit which applies to this logger, as of the
+		// given generation of the limits.
+		LogLimit* volatile limit;
+		volatile AtomicWord limitGeneration;
+		friend class LogLimiter;
 
 		static Logger* GetImpl(std::string name);
 		static std::map<std::string, Logger*> loggers;
 	};
 
+	/**
+	 * A logger which a call site can keep in a static and reach without
+	 * looking it up by name every time. It is an aggregate, so it needs
+	 * no constructor and is safe to reach from several threads at once.
+	 * \code
+	 * static LoggerHandle logger = { "KEventObject" };
+	 * logger->Error("Something went wrong");
+	 * \endcode
+	 * Like any Logger*, a handle must not be used after Logger::Shutdown.
+	 */
+	struct KROLL_API LoggerHandle
+	{
+		const char* name;
+		Logger* volatile logger;
+
+		Logger* Get()
+		{
+			// Threads which race here find the same logger.
+			Logger* cached = logger;
+			if (!cached)
+			{
+				cached = Logger::Get(name);
+				logger = cached;
+			}
+			return cached;
+		}
+
+		Logger* operator->()
+		{
+			return this->Get();
+		}
+	};
+
 	class KROLL_API RootLogger : public Logger
 	{
 		public:
@@ -106,6 +196,10 @@ namespace kroll
 		static RootLogger* instance;
 		virtual void LogImpl(Poco::Message& m);
 		void AddLoggerCallback(LoggerCallback callback);
+		void StartWriter(OverflowPolicy policy, size_t capacity);
+		void StopWriter();
+		void SetRotation(size_t maxBytes, long maxSeconds, int retainedFiles,
+			bool compress);
 
 		protected:
 		bool consoleLogging;
@@ -115,6 +209,33 @@ namespace kroll
 		std::ofstream logFile;
 		Poco::Mutex mutex;
 		std::vector<LoggerCallback> callbacks;
+
+		// Held shared while pushing to the queue and exclusively while
+		// the queue is started or stopped.
+		Poco::RWLock queueLock;
+		LogQueue* queue;
+		OverflowPolicy overflowPolicy;
+		Poco::Thread* writerThread;
+		Poco::RunnableAdapter<RootLogger>* writerAdapter;
+		Poco::Event writerEvent;
+		volatile AtomicWord writerSleeping;
+		volatile AtomicWord droppedMessages;
+		volatile bool stopping;
+
+		size_t rotateBytes;
+		long rotateSeconds;
+		size_t logFileSize;
+		Poco::Timestamp logFileOpened;
+		LogCompressor* compressor;
+
+		void OpenLogFile();
+		void RotateLogFile();
+		void Push(Poco::Message& m);
+		void Write(Poco::Message& m);
+		void Flush();
+		void RunWriter();
+		void WakeWriter();
+		void ReportDroppedMessages();
 	};
 
 }
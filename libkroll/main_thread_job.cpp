@@ -79,7 +79,7 @@ namespace kroll
 
 	void MainThreadJob::PrintException()
 	{
-		static Logger* logger = Logger::Get("Host");
+		static LoggerHandle logger = { "Host" };
 		if (this->returnValue.isNull())
 		{
 			logger->Error("Error in the job queue: %s",
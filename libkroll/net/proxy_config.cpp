@@ -141,13 +141,17 @@ SharedProxy GetProxyForURL(string& url)
 		return environmentProxy;
 	}
 
-	logger->Debug("Looking up proxy information for: %s", url.c_str());
+	// This runs for every request, so these are recorded without
+	// formatting when deferred logging is enabled.
+	static LogFormat lookupFormat = { "Looking up proxy information for: %s" };
+	static LogFormat proxyFormat = { "Using proxy: %s" };
+	logger->Debug(&lookupFormat, url.c_str());
 	SharedProxy proxy(ProxyConfig::GetProxyForURLImpl(uri));
 
 	if (proxy.isNull())
 		logger->Debug("Using direct connection.");
-	else
-		logger->Debug("Using proxy: %s", proxy->ToString().c_str());
+	else if (logger->IsDebugEnabled())
+		logger->Debug(&proxyFormat, proxy->ToString().c_str());
 
 	return proxy;
 }
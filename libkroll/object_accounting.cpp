@@ -0,0 +1,269 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstring>
+#include <algorithm>
+#include <Poco/RWLock.h>
+#include <Poco/AtomicCounter.h>
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+
+#ifndef OS_WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// How many allocations a thread remembers before their objects are
+// constructed. More than one are needed for expressions such as
+// new A(new B()), where A may be allocated before B is constructed.
+#define PENDING_ALLOCATIONS 4
+
+namespace kroll
+{
+	class ObjectTypeCounter
+	{
+		public:
+		ObjectTypeCounter(const std::string& type) :
+			type(type),
+			liveBytes(0)
+		{}
+
+		std::string type;
+		Poco::AtomicCounter liveObjects;
+		Poco::AtomicCounter totalObjects;
+		volatile AtomicWord liveBytes;
+	};
+
+	struct PendingAllocations
+	{
+		void* pointers[PENDING_ALLOCATIONS];
+		size_t sizes[PENDING_ALLOCATIONS];
+		unsigned int next;
+	};
+
+	// Counters are never freed, because objects hold on to them for as
+	// long as they live.
+	static Poco::RWLock countersLock;
+	static std::map<std::string, ObjectTypeCounter*> counters;
+
+	volatile bool ObjectAccounting::enabled = false;
+
+	static void DestroyPendingAllocations(void* data)
+	{
+		delete static_cast<PendingAllocations*>(data);
+	}
+
+	static ThreadLocal<PendingAllocations> threadPending = { &DestroyPendingAllocations };
+
+	static PendingAllocations* GetPendingAllocations()
+	{
+		PendingAllocations* pending = threadPending.Get();
+		if (!pending)
+		{
+			pending = new PendingAllocations();
+			for (size_t i = 0; i < PENDING_ALLOCATIONS; i++)
+				pending->pointers[i] = 0;
+			pending->next = 0;
+			threadPending.Set(pending);
+		}
+		return pending;
+	}
+
+	static ObjectTypeCounter* GetCounter(const std::string& type)
+	{
+		{
+			Poco::ScopedRWLock lock(countersLock, false);
+			std::map<std::string, ObjectTypeCounter*>::iterator i = counters.find(type);
+			if (i != counters.end())
+				return i->second;
+		}
+
+		Poco::ScopedRWLock lock(countersLock, true);
+		ObjectTypeCounter*& counter = counters[type];
+		if (!counter)
+			counter = new ObjectTypeCounter(type);
+		return counter;
+	}
+
+	/*static*/
+	void ObjectAccounting::Enable()
+	{
+		enabled = true;
+	}
+
+	/*static*/
+	void ObjectAccounting::Disable()
+	{
+		enabled = false;
+	}
+
+	/*static*/
+	void ObjectAccounting::NoteAllocation(void* pointer, size_t size)
+	{
+		PendingAllocations* pending = GetPendingAllocations();
+		pending->pointers[pending->next] = pointer;
+		pending->sizes[pending->next] = size;
+		pending->next = (pending->next + 1) % PENDING_ALLOCATIONS;
+	}
+
+	/*static*/
+	ObjectTypeCounter* ObjectAccounting::Add(KObject* object,
+		const std::string& type, unsigned int& size)
+	{
+		// Objects on the stack, and objects whose KObject part does not
+		// start where they were allocated, are not found here and are
+		// not counted.
+		PendingAllocations* pending = GetPendingAllocations();
+		for (size_t i = 0; i < PENDING_ALLOCATIONS; i++)
+		{
+			if (pending->pointers[i] != object)
+				continue;
+
+			pending->pointers[i] = 0;
+			size = (unsigned int) pending->sizes[i];
+
+			ObjectTypeCounter* counter = GetCounter(type);
+			counter->liveObjects++;
+			counter->totalObjects++;
+			AtomicAdd(&counter->liveBytes, (AtomicWord) size);
+			return counter;
+		}
+		return 0;
+	}
+
+	/*static*/
+	void ObjectAccounting::Remove(ObjectTypeCounter* counter, unsigned int size)
+	{
+		counter->liveObjects--;
+		AtomicAdd(&counter->liveBytes, -((AtomicWord) size));
+	}
+
+	static bool MoreLiveBytes(const ObjectTypeStats& a, const ObjectTypeStats& b)
+	{
+		return a.liveBytes > b.liveBytes;
+	}
+
+	/*static*/
+	void ObjectAccounting::GetStatistics(std::vector<ObjectTypeStats>& stats)
+	{
+		{
+			Poco::ScopedRWLock lock(countersLock, false);
+			std::map<std::string, ObjectTypeCounter*>::iterator i = counters.begin();
+			for (; i != counters.end(); i++)
+			{
+				ObjectTypeCounter* counter = i->second;
+				ObjectTypeStats s;
+				s.type = counter->type;
+				s.liveObjects = (size_t) counter->liveObjects.value();
+				s.liveBytes = (size_t) counter->liveBytes;
+				s.totalObjects = (size_t) counter->totalObjects.value();
+				stats.push_back(s);
+			}
+		}
+		std::sort(stats.begin(), stats.end(), &MoreLiveBytes);
+	}
+
+	/*static*/
+	void ObjectAccounting::LogStatistics(Logger* logger)
+	{
+		std::vector<ObjectTypeStats> stats;
+		GetStatistics(stats);
+
+		size_t liveObjects = 0, liveBytes = 0;
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			ObjectTypeStats& s = stats[i];
+			logger->Info("%s: %i live objects, %i live bytes, %i constructed",
+				s.type.c_str(), (int) s.liveObjects, (int) s.liveBytes,
+				(int) s.totalObjects);
+			liveObjects += s.liveObjects;
+			liveBytes += s.liveBytes;
+		}
+		logger->Info("All types: %i live objects, %i live bytes",
+			(int) liveObjects, (int) liveBytes);
+	}
+
+#ifndef OS_WIN32
+	// The signal handler may not take locks or log, so it only wakes a
+	// thread which does.
+	static int signalPipe[2] = { -1, -1 };
+
+	static void SignalReceived(int signal)
+	{
+		int savedErrno = errno;
+		char byte = 0;
+		(void) write(signalPipe[1], &byte, 1);
+		errno = savedErrno;
+	}
+
+	class SignalWatcher : public Poco::Runnable
+	{
+		public:
+		void run()
+		{
+			START_KROLL_THREAD;
+			char byte;
+			while (true)
+			{
+				ssize_t count = read(signalPipe[0], &byte, 1);
+				if (count < 0 && errno == EINTR)
+					continue;
+				if (count <= 0)
+					break;
+
+				ObjectAccounting::LogStatistics(Logger::Get("ObjectAccounting"));
+			}
+			END_KROLL_THREAD;
+		}
+	};
+
+	static Poco::Thread signalThread;
+	static SignalWatcher signalWatcher;
+#endif
+
+	/*static*/
+	void ObjectAccounting::LogStatisticsOnSignal()
+	{
+#ifndef OS_WIN32
+		if (signalPipe[0] != -1 || pipe(signalPipe) != 0)
+			return;
+
+		signalThread.setName("Object accounting");
+		signalThread.start(signalWatcher);
+
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = &SignalReceived;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART;
+		sigaction(SIGUSR2, &action, 0);
+#endif
+	}
+
+	/*static*/
+	void ObjectAccounting::StopLogStatisticsOnSignal()
+	{
+#ifndef OS_WIN32
+		if (signalPipe[0] == -1)
+			return;
+
+		// Ignore the signal before closing the pipe, so that the handler
+		// does not write to it afterwards. The watcher logs any signal
+		// which is still in the pipe and stops once it reads its end.
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = SIG_IGN;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGUSR2, &action, 0);
+
+		close(signalPipe[1]);
+		signalThread.join();
+		close(signalPipe[0]);
+		signalPipe[0] = signalPipe[1] = -1;
+#endif
+	}
+}
@@ -0,0 +1,86 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_OBJECT_ACCOUNTING_H_
+#define _KR_OBJECT_ACCOUNTING_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace kroll
+{
+	class KObject;
+	class ObjectTypeCounter;
+
+	/**
+	 * A snapshot of the counters of one KObject type.
+	 */
+	struct KROLL_API ObjectTypeStats
+	{
+		std::string type;
+		size_t liveObjects;
+		size_t liveBytes;
+		size_t totalObjects;
+	};
+
+	/**
+	 * Optional counters of the live KObjects and the bytes they occupy,
+	 * by the type string each object was constructed with. An object is
+	 * counted if it was allocated with new while accounting was enabled,
+	 * and stays counted until it is destroyed, even if accounting is
+	 * disabled in between. The bytes are those of the objects themselves,
+	 * not of any buffers they own.
+	 *
+	 * While accounting is disabled, constructing an object costs one
+	 * flag check.
+	 */
+	class KROLL_API ObjectAccounting
+	{
+		public:
+		static void Enable();
+		static void Disable();
+		static bool IsEnabled() { return enabled; }
+
+		/**
+		 * @return the counters of every type with objects counted so far,
+		 * the one with the most live bytes first
+		 */
+		static void GetStatistics(std::vector<ObjectTypeStats>& stats);
+		static void LogStatistics(Logger* logger);
+
+		/**
+		 * Log the statistics whenever the process receives SIGUSR2. Does
+		 * nothing on Windows.
+		 */
+		static void LogStatisticsOnSignal();
+
+		/**
+		 * Stop logging the statistics on SIGUSR2, which is ignored from
+		 * then on. Must be called before Logger::Shutdown.
+		 */
+		static void StopLogStatisticsOnSignal();
+
+		/**
+		 * Remember the memory a KObject is about to be constructed in.
+		 * Called by the operator new of KObject and of slab allocated
+		 * classes.
+		 */
+		static void NoteAllocation(void* pointer, size_t size);
+
+		/**
+		 * @return the counter the object was added to, or NULL if it was
+		 * not allocated with new
+		 */
+		static ObjectTypeCounter* Add(KObject* object, const std::string& type,
+			unsigned int& size);
+		static void Remove(ObjectTypeCounter* counter, unsigned int size);
+
+		private:
+		static volatile bool enabled;
+	};
+}
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+
+#define PROFILER_SUB_BUCKETS 16
+#define PROFILER_HISTOGRAM_BUCKETS (PROFILER_SUB_BUCKETS * 37)
+
+namespace kroll
+{
+	struct ProfileEntry
+	{
+		const char* eventType;
+		ProfileEntry* next;
+		Poco::UInt64 count;
+		Poco::Timestamp::TimeDiff total;
+		Poco::Timestamp::TimeDiff max;
+		unsigned int histogram[PROFILER_HISTOGRAM_BUCKETS];
+	};
+
+	/**
+	 * The entries recorded by one thread, by name. Entries for other event
+	 * types with the same name are chained to the first one. The mutex is
+	 * only ever contended while the statistics are being merged.
+	 */
+	struct ProfilerThreadTable
+	{
+		Poco::FastMutex mutex;
+		std::map<std::string, ProfileEntry*> entries;
+		unsigned int unsampled;
+	};
+
+	static Poco::FastMutex tablesMutex;
+	static std::vector<ProfilerThreadTable*> tables;
+
+	// What threads which exited recorded.
+	static ProfilerThreadTable exitedThreads;
+
+	volatile bool Profiler::enabled = false;
+	volatile unsigned int Profiler::sampleEvery = 1;
+
+	static size_t BucketIndex(Poco::Timestamp::TimeDiff elapsed)
+	{
+		// Values below 16 get a bucket each. Above that, each power of two
+		// is split into 16 buckets.
+		Poco::UInt64 value = elapsed < 0 ? 0 : (Poco::UInt64) elapsed;
+		if (value < PROFILER_SUB_BUCKETS)
+			return (size_t) value;
+
+		int msb = 0;
+		for (Poco::UInt64 v = value; v >>= 1;)
+			msb++;
+
+		size_t index = PROFILER_SUB_BUCKETS * (msb - 3) +
+			(size_t) ((value >> (msb - 4)) - PROFILER_SUB_BUCKETS);
+		return std::min(index, (size_t) PROFILER_HISTOGRAM_BUCKETS - 1);
+	}
+
+	/**
+	 * @return the largest value which falls into a bucket
+	 */
+	static Poco::Timestamp::TimeDiff BucketLimit(size_t index)
+	{
+		if (index < PROFILER_SUB_BUCKETS)
+			return (Poco::Timestamp::TimeDiff) index;
+
+		int msb = (int) (index / PROFILER_SUB_BUCKETS) + 3;
+		Poco::UInt64 subBucket = index % PROFILER_SUB_BUCKETS + PROFILER_SUB_BUCKETS;
+		return (Poco::Timestamp::TimeDiff) (((subBucket + 1) << (msb - 4)) - 1);
+	}
+
+	static ProfileEntry& FindEntry(ProfilerThreadTable& table,
+		const char* eventType, const std::string& name)
+	{
+		ProfileEntry*& first = table.entries[name];
+		for (ProfileEntry* entry = first; entry; entry = entry->next)
+		{
+			if (entry->eventType == eventType || !strcmp(entry->eventType, eventType))
+				return *entry;
+		}
+
+		ProfileEntry* entry = new ProfileEntry();
+		entry->eventType = eventType;
+		entry->next = first;
+		first = entry;
+		return *entry;
+	}
+
+	static void MergeEntry(ProfileEntry& into, const ProfileEntry& from)
+	{
+		into.count += from.count;
+		into.total += from.total;
+		into.max = std::max(into.max, from.max);
+		for (size_t i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++)
+			into.histogram[i] += from.histogram[i];
+	}
+
+	static void ClearTable(ProfilerThreadTable& table)
+	{
+		std::map<std::string, ProfileEntry*>::iterator i = table.entries.begin();
+		for (; i != table.entries.end(); i++)
+		{
+			ProfileEntry* entry = i->second;
+			while (entry)
+			{
+				ProfileEntry* next = entry->next;
+				delete entry;
+				entry = next;
+			}
+		}
+		table.entries.clear();
+	}
+
+	static void DestroyThreadTable(void* data)
+	{
+		ProfilerThreadTable* table = static_cast<ProfilerThreadTable*>(data);
+		{
+			Poco::FastMutex::ScopedLock lock(tablesMutex);
+			tables.erase(std::find(tables.begin(), tables.end(), table));
+
+			std::map<std::string, ProfileEntry*>::iterator i = table->entries.begin();
+			for (; i != table->entries.end(); i++)
+			{
+				for (ProfileEntry* entry = i->second; entry; entry = entry->next)
+				{
+					MergeEntry(FindEntry(exitedThreads, entry->eventType, i->first),
+						*entry);
+				}
+			}
+		}
+		ClearTable(*table);
+		delete table;
+	}
+
+	static ThreadLocal<ProfilerThreadTable> threadTable = { &DestroyThreadTable };
+
+	static ProfilerThreadTable* GetThreadTable()
+	{
+		ProfilerThreadTable* table = threadTable.Get();
+		if (!table)
+		{
+			table = new ProfilerThreadTable();
+			table->unsampled = 0;
+			{
+				Poco::FastMutex::ScopedLock lock(tablesMutex);
+				tables.push_back(table);
+			}
+			threadTable.Set(table);
+		}
+		return table;
+	}
+
+	/*static*/
+	void Profiler::Enable(unsigned int sampleEvery)
+	{
+		Profiler::sampleEvery = sampleEvery < 1 ? 1 : sampleEvery;
+		Profiler::enabled = true;
+	}
+
+	/*static*/
+	void Profiler::Disable()
+	{
+		Profiler::enabled = false;
+	}
+
+	/*static*/
+	unsigned int Profiler::Sample()
+	{
+		unsigned int rate = sampleEvery;
+		if (rate <= 1)
+			return 1;
+
+		// Each thread counts on its own, so sampling needs no atomics.
+		ProfilerThreadTable* table = GetThreadTable();
+		if (++table->unsampled < rate)
+			return 0;
+		table->unsampled = 0;
+		return rate;
+	}
+
+	/*static*/
+	void Profiler::Record(const char* eventType, const std::string& name,
+		Poco::Timestamp::TimeDiff elapsed, unsigned int weight)
+	{
+		ProfilerThreadTable* table = GetThreadTable();
+		Poco::FastMutex::ScopedLock lock(table->mutex);
+
+		ProfileEntry& entry = FindEntry(*table, eventType, name);
+		entry.count += weight;
+		entry.total += elapsed * weight;
+		entry.max = std::max(entry.max, elapsed);
+		entry.histogram[BucketIndex(elapsed)] += weight;
+	}
+
+	typedef std::map<std::pair<std::string, std::string>, ProfileEntry> MergedEntries;
+
+	static void MergeTable(ProfilerThreadTable& table, MergedEntries& merged)
+	{
+		Poco::FastMutex::ScopedLock lock(table.mutex);
+		std::map<std::string, ProfileEntry*>::iterator i = table.entries.begin();
+		for (; i != table.entries.end(); i++)
+		{
+			for (ProfileEntry* entry = i->second; entry; entry = entry->next)
+			{
+				MergeEntry(merged[std::make_pair(std::string(entry->eventType),
+					i->first)], *entry);
+			}
+		}
+	}
+
+	static Poco::Timestamp::TimeDiff Percentile(const ProfileEntry& entry, double fraction)
+	{
+		Poco::UInt64 wanted = (Poco::UInt64) (entry.count * fraction);
+		if (wanted < 1)
+			wanted = 1;
+
+		Poco::UInt64 seen = 0;
+		for (size_t i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++)
+		{
+			seen += entry.histogram[i];
+			if (seen >= wanted)
+				return std::min(BucketLimit(i), entry.max);
+		}
+		return entry.max;
+	}
+
+	static bool LongerInTotal(const ProfileStatistics& a, const ProfileStatistics& b)
+	{
+		return a.total > b.total;
+	}
+
+	/*static*/
+	void Profiler::GetStatistics(std::vector<ProfileStatistics>& statistics)
+	{
+		MergedEntries merged;
+		{
+			Poco::FastMutex::ScopedLock lock(tablesMutex);
+			for (size_t i = 0; i < tables.size(); i++)
+				MergeTable(*tables[i], merged);
+			MergeTable(exitedThreads, merged);
+		}
+
+		MergedEntries::iterator i = merged.begin();
+		for (; i != merged.end(); i++)
+		{
+			ProfileEntry& entry = i->second;
+			ProfileStatistics s;
+			s.eventType = i->first.first;
+			s.name = i->first.second;
+			s.count = entry.count;
+			s.total = entry.total;
+			s.max = entry.max;
+			s.p50 = Percentile(entry, 0.5);
+			s.p90 = Percentile(entry, 0.9);
+			s.p99 = Percentile(entry, 0.99);
+			statistics.push_back(s);
+		}
+		std::sort(statistics.begin(), statistics.end(), &LongerInTotal);
+	}
+
+	/*static*/
+	void Profiler::WriteReport(std::ostream& stream)
+	{
+		std::vector<ProfileStatistics> statistics;
+		GetStatistics(statistics);
+
+		stream << std::setw(6) << "event" << std::setw(10) << "count"
+			<< std::setw(14) << "total ms" << std::setw(12) << "mean us"
+			<< std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+			<< std::setw(10) << "p99 us" << std::setw(10) << "max us"
+			<< "  name" << std::endl;
+
+		for (size_t i = 0; i < statistics.size(); i++)
+		{
+			ProfileStatistics& s = statistics[i];
+			stream << std::setw(6) << s.eventType << std::setw(10) << s.count
+				<< std::setw(14) << std::fixed << std::setprecision(3)
+				<< (double) s.total / 1000.0
+				<< std::setw(12) << std::setprecision(1)
+				<< (double) s.total / (double) s.count
+				<< std::setw(10) << s.p50 << std::setw(10) << s.p90
+				<< std::setw(10) << s.p99 << std::setw(10) << s.max
+				<< "  " << s.name << '\n';
+		}
+		stream.flush();
+	}
+
+	/*static*/
+	void Profiler::Reset()
+	{
+		Poco::FastMutex::ScopedLock lock(tablesMutex);
+		for (size_t i = 0; i < tables.size(); i++)
+		{
+			Poco::FastMutex::ScopedLock tableLock(tables[i]->mutex);
+			ClearTable(*tables[i]);
+		}
+		ClearTable(exitedThreads);
+	}
+}
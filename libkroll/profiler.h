@@ -0,0 +1,94 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_PROFILER_H_
+#define _KR_PROFILER_H_
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <Poco/Timestamp.h>
+#include <Poco/Types.h>
+
+namespace kroll
+{
+	/**
+	 * The merged timings of one kind of event at one call site, such as
+	 * calls of "API.log". Times are in microseconds.
+	 */
+	struct KROLL_API ProfileStatistics
+	{
+		std::string eventType;
+		std::string name;
+		Poco::UInt64 count;
+		Poco::Timestamp::TimeDiff total;
+		Poco::Timestamp::TimeDiff max;
+		Poco::Timestamp::TimeDiff p50;
+		Poco::Timestamp::TimeDiff p90;
+		Poco::Timestamp::TimeDiff p99;
+	};
+
+	/**
+	 * Aggregates the timings reported by the profiled bound objects. Each
+	 * thread keeps a count, the total and longest time and a latency
+	 * histogram per event type and name, so recording a timing neither
+	 * writes anything nor waits for other threads. The tables of all
+	 * threads are merged when statistics are asked for.
+	 *
+	 * The histogram has 16 buckets per power of two, so the percentiles
+	 * it reports are within about 6% of the real ones.
+	 *
+	 * Profiling can be switched on and off at any time. To make it cheaper
+	 * still, it can time only one in every few events, and count each
+	 * timing that many times.
+	 */
+	class KROLL_API Profiler
+	{
+		public:
+		/**
+		 * @param sampleEvery time one in this many events
+		 */
+		static void Enable(unsigned int sampleEvery=1);
+		static void Disable();
+		static bool IsEnabled() { return enabled; }
+		static unsigned int GetSampleRate() { return sampleEvery; }
+
+		/**
+		 * @return 0 if the calling thread should not time its next event,
+		 * or otherwise the number of events its timing stands for
+		 */
+		static unsigned int Sample();
+
+		/**
+		 * @param eventType a string which lives as long as the program,
+		 * such as "call"
+		 * @param weight the number of events this timing stands for
+		 */
+		static void Record(const char* eventType, const std::string& name,
+			Poco::Timestamp::TimeDiff elapsed, unsigned int weight=1);
+
+		/**
+		 * @return the statistics of every call site, the one which took
+		 * the longest in total first
+		 */
+		static void GetStatistics(std::vector<ProfileStatistics>& statistics);
+
+		/**
+		 * Write the statistics of every call site as a table.
+		 */
+		static void WriteReport(std::ostream& stream);
+
+		/**
+		 * Forget everything recorded so far.
+		 */
+		static void Reset();
+
+		private:
+		static volatile bool enabled;
+		static volatile unsigned int sampleEvery;
+	};
+}
+
+#endif
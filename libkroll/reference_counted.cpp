@@ -0,0 +1,330 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+
+namespace kroll
+{
+#ifdef KROLL_BIASED_REFCOUNT
+	/**
+	 * The per-thread record which biased objects point to. Records are
+	 * never freed, since objects may outlive the thread which made them.
+	 */
+	struct BiasedOwner
+	{
+		Poco::FastMutex mutex;
+		std::vector<ReferenceCounted*> queue;
+		volatile AtomicWord pending;
+		bool alive;
+
+		BiasedOwner() :
+			pending(0),
+			alive(true)
+		{
+		}
+
+		static BiasedOwner* Current();
+		static BiasedOwner* Find();
+		static void ThreadExited(void* data);
+
+		void Share(ReferenceCounted* object);
+		void MergeQueued();
+	};
+
+	static ThreadLocal<BiasedOwner> threadOwner = { &BiasedOwner::ThreadExited };
+
+	/*static*/
+	BiasedOwner* BiasedOwner::Current()
+	{
+		BiasedOwner* owner = threadOwner.Get();
+		if (!owner)
+		{
+			owner = new BiasedOwner();
+			threadOwner.Set(owner);
+		}
+		return owner;
+	}
+
+	/*static*/
+	BiasedOwner* BiasedOwner::Find()
+	{
+		// Unlike Current, this never creates a record. A thread without one
+		// owns no objects, and while a thread exits its record is no longer
+		// reachable through the key, so reference operations it performs
+		// then take the path for objects owned by another thread.
+		return threadOwner.Get();
+	}
+
+	/*static*/
+	void BiasedOwner::ThreadExited(void* data)
+	{
+		// Mark the owner as gone before merging, so that objects released
+		// while merging, and their members, are counted in the shared count
+		// instead of being queued with this owner again.
+		BiasedOwner* owner = static_cast<BiasedOwner*>(data);
+		{
+			Poco::FastMutex::ScopedLock lock(owner->mutex);
+			owner->alive = false;
+		}
+		owner->MergeQueued();
+	}
+
+	void BiasedOwner::Share(ReferenceCounted* object)
+	{
+		// Only the thread which marks the object as shared queues it.
+		AtomicWord oldFlags = object->flags;
+		while (true)
+		{
+			if (!(oldFlags & ReferenceCounted::BIASED) ||
+				(oldFlags & ReferenceCounted::SHARED))
+				return;
+			if (AtomicCompareAndSwap(&object->flags, oldFlags,
+				oldFlags | ReferenceCounted::SHARED))
+				break;
+			oldFlags = object->flags;
+		}
+
+		// The queue holds a reference, so that the object cannot be deleted
+		// before the owner's references are merged.
+		AtomicAdd(&object->count, 2);
+		{
+			Poco::FastMutex::ScopedLock lock(this->mutex);
+			if (this->alive)
+			{
+				this->queue.push_back(object);
+				this->pending = 1;
+				return;
+			}
+		}
+
+		// The owner is gone and will never touch its local count again.
+		object->MergeLocalCount();
+		object->release();
+	}
+
+	void BiasedOwner::MergeQueued()
+	{
+		std::vector<ReferenceCounted*> merging;
+		{
+			Poco::FastMutex::ScopedLock lock(this->mutex);
+			merging.swap(this->queue);
+			this->pending = 0;
+		}
+
+		for (size_t i = 0; i < merging.size(); i++)
+		{
+			merging[i]->MergeLocalCount();
+			merging[i]->release();
+		}
+	}
+
+	ReferenceCounted::ReferenceCounted() :
+		count(0),
+		flags(BIASED),
+		forward(0),
+		localCount(1),
+		owner(BiasedOwner::Current())
+	{
+	}
+
+	ReferenceCounted::ReferenceCounted(const ReferenceCounted&) :
+		count(0),
+		flags(BIASED),
+		forward(0),
+		localCount(1),
+		owner(BiasedOwner::Current())
+	{
+	}
+#else
+	ReferenceCounted::ReferenceCounted() :
+		count(2 | MERGED),
+		flags(0),
+		forward(0)
+	{
+	}
+
+	ReferenceCounted::ReferenceCounted(const ReferenceCounted&) :
+		count(2 | MERGED),
+		flags(0),
+		forward(0)
+	{
+	}
+#endif
+
+	void ReferenceCounted::MakeImmortal()
+	{
+		AtomicOr(&flags, IMMORTAL);
+	}
+
+	void ReferenceCounted::ForwardReferenceCount(ReferenceCounted* primary)
+	{
+		this->forward = primary;
+		AtomicOr(&flags, FORWARDED);
+	}
+
+	int ReferenceCounted::referenceCount() const
+	{
+		if (flags & FORWARDED)
+			return forward->referenceCount();
+
+		int references = count / 2;
+#ifdef KROLL_BIASED_REFCOUNT
+		if (flags & BIASED)
+			references += localCount;
+#endif
+		return references;
+	}
+
+#ifdef KROLL_BIASED_REFCOUNT
+	void ReferenceCounted::MergeLocalCount()
+	{
+		// Until this point the shared count is even, so no other thread
+		// can see it drop to MERGED, even after the flags are cleared.
+		AtomicWord oldFlags = AtomicClear(&flags, BIASED | SHARED);
+		if (oldFlags & BIASED)
+			AtomicAdd(&count, localCount * 2 + MERGED);
+	}
+
+	bool ReferenceCounted::CountLocally(int delta)
+	{
+		if (BiasedOwner::Find() != owner)
+		{
+			owner->Share(this);
+			return false;
+		}
+
+		if (owner->pending)
+			owner->MergeQueued();
+
+		if (!(flags & BIASED))
+			return false;
+
+		// When the object is shared, the queue holds a reference to it
+		// and the merge decides when it dies.
+		localCount += delta;
+		if (localCount == 0 && !(flags & SHARED) &&
+			(!weakControl || this->ClearWeakReferences()))
+			delete this;
+		return true;
+	}
+#endif
+
+	WeakReferenceControl* ReferenceCounted::GetWeakReferenceControl()
+	{
+		if (flags & FORWARDED)
+			return forward->GetWeakReferenceControl();
+
+		WeakReferenceControl* control = weakControl;
+		if (control)
+			return control;
+
+		control = new WeakReferenceControl(this);
+		if (!AtomicCompareAndSwapPointer((void* volatile*) &weakControl, 0, control))
+		{
+			delete control;
+			control = weakControl;
+		}
+		return control;
+	}
+
+	bool ReferenceCounted::TryDuplicate()
+	{
+		// The caller guarantees that the object has not been destroyed yet,
+		// but it may be about to be.
+		if (flags & IMMORTAL)
+			return true;
+
+		if (flags & FORWARDED)
+			return forward->TryDuplicate();
+
+#ifdef KROLL_BIASED_REFCOUNT
+		if ((flags & BIASED) && BiasedOwner::Find() == owner)
+		{
+			localCount++;
+			return true;
+		}
+#endif
+
+		AtomicWord oldCount = count;
+		while (oldCount != MERGED)
+		{
+			if (AtomicCompareAndSwap(&count, oldCount, oldCount + 2))
+			{
+#ifdef KROLL_BIASED_REFCOUNT
+				// Mark the object as shared before the lock is released, so
+				// that its owner does not delete it when its local count
+				// drops to zero.
+				if (flags & BIASED)
+					owner->Share(this);
+#endif
+				return true;
+			}
+			oldCount = count;
+		}
+		return false;
+	}
+
+	bool ReferenceCounted::ClearWeakReferences()
+	{
+		WeakReferenceControl* control = weakControl;
+		{
+			Poco::FastMutex::ScopedLock lock(control->GetMutex());
+#ifdef KROLL_BIASED_REFCOUNT
+			// Another thread revived the object through a weak reference.
+			if (flags & SHARED)
+				return false;
+#endif
+			control->object = 0;
+		}
+
+		weakControl = 0;
+		control->release();
+		return true;
+	}
+
+	void ReferenceCounted::DuplicateSlow()
+	{
+		if (flags & IMMORTAL)
+			return;
+
+		if (flags & FORWARDED)
+		{
+			forward->duplicate();
+			return;
+		}
+
+#ifdef KROLL_BIASED_REFCOUNT
+		if ((flags & BIASED) && this->CountLocally(1))
+			return;
+#endif
+
+		AtomicAdd(&count, 2);
+	}
+
+	void ReferenceCounted::ReleaseSlow()
+	{
+		if (flags & IMMORTAL)
+			return;
+
+		if (flags & FORWARDED)
+		{
+			forward->release();
+			return;
+		}
+
+#ifdef KROLL_BIASED_REFCOUNT
+		if ((flags & BIASED) && this->CountLocally(-1))
+			return;
+#endif
+
+		// Until the owner's references are merged, the shared count can
+		// reach zero or go negative without the object being dead.
+		if (AtomicAdd(&count, -2) == MERGED)
+			delete this;
+	}
+}
@@ -6,34 +6,148 @@
 #ifndef _KR_REFERENCE_COUNTED_H_
 #define _KR_REFERENCE_COUNTED_H_
 
+#include "atomic.h"
+
+#if defined(KROLL_BIASED_REFCOUNT) && defined(OS_WIN32)
+#error "Biased reference counting relies on thread exit notifications"
+#endif
+
 namespace kroll
 {
+	class WeakReferenceControl;
+#ifdef KROLL_BIASED_REFCOUNT
+	struct BiasedOwner;
+#endif
+
+	/**
+	 * An intrusive reference count for use with AutoPtr. duplicate() and
+	 * release() are not virtual: in the common case they are a single
+	 * inlined atomic add.
+	 *
+	 * When libkroll is built with KROLL_BIASED_REFCOUNT, objects start out
+	 * biased towards the thread which created them. That thread counts
+	 * references without atomic instructions until another thread touches
+	 * the object. That thread counts in the shared, atomic count instead and
+	 * queues the object with its owner, which folds its own references into
+	 * the shared count at its next reference operation. If the owner has
+	 * already exited, the other thread does this itself.
+	 *
+	 * Classes which inherit ReferenceCounted more than once (through two
+	 * KObject bases, for instance) must call ForwardReferenceCount on all
+	 * but one of the bases, and define duplicate() and release() which
+	 * call through to that base, so that the object has a single count.
+	 */
 	class KROLL_API ReferenceCounted
 	{
-		private:
-		Poco::AtomicCounter count;
-
 		public:
-		ReferenceCounted() : count(1) { }
-		virtual ~ReferenceCounted() { }
+		ReferenceCounted();
+		ReferenceCounted(const ReferenceCounted&);
 
-		virtual void duplicate()
+		virtual ~ReferenceCounted()
 		{
-			++count;
+			if (!(flags & FORWARDED) && weakControl)
+				this->ClearWeakReferences();
 		}
 
-		virtual void release()
+		// Copying an object never copies its reference count.
+		ReferenceCounted& operator=(const ReferenceCounted&) { return *this; }
+
+		inline void duplicate()
 		{
-			int value = --count;
-			if (value <= 0) {
-				delete this;
-			}
+			if (flags == 0)
+				AtomicAdd(&count, 2);
+			else
+				this->DuplicateSlow();
 		}
 
-		virtual int referenceCount() const
+		inline void release()
 		{
-			return count.value();
+			if (flags != 0)
+				this->ReleaseSlow();
+			else if (AtomicAdd(&count, -2) == MERGED)
+				delete this;
 		}
+
+		int referenceCount() const;
+
+		/**
+		 * @return true if this object is immortal: it is never deleted
+		 * and reference operations on it do nothing.
+		 */
+		bool IsImmortal() const { return (flags & IMMORTAL) != 0; }
+
+		/**
+		 * @return true if some references to this object may still be
+		 * counted privately by the thread which created it, in which case
+		 * referenceCount() is only exact on that thread.
+		 */
+		bool HasPrivateReferences() const { return (flags & BIASED) != 0; }
+
+		/**
+		 * @return the control block shared by all weak references to this
+		 * object, which is created on first use. See KWeakRef.
+		 */
+		WeakReferenceControl* GetWeakReferenceControl();
+
+		/**
+		 * Take a new reference, unless the count has already dropped to
+		 * zero and the object is being destroyed. The caller must keep the
+		 * object's memory valid meanwhile, for instance by holding a lock
+		 * which its destructor takes. With biased reference counting only
+		 * the lock of the weak reference control block is enough, because
+		 * the owner may otherwise delete the object without taking a lock.
+		 * @return true if a reference was taken
+		 */
+		bool TryDuplicate();
+
+		protected:
+		void MakeImmortal();
+
+		/**
+		 * Count all references to this base in another base of the same
+		 * object instead. This should be called from the constructor.
+		 */
+		void ForwardReferenceCount(ReferenceCounted* primary);
+
+		private:
+		enum
+		{
+			// The low bit of count is set once every reference is counted in
+			// it, so the object is deleted when count drops back to MERGED.
+			MERGED = 1,
+
+			// Bits in flags. Any set bit sends reference operations down
+			// the slow path.
+			IMMORTAL = 1,
+			FORWARDED = 2,
+			BIASED = 4,
+			SHARED = 8
+		};
+
+		volatile AtomicWord count;
+		volatile AtomicWord flags;
+
+		// A base which forwards its count is never the target of weak
+		// references itself, so the two pointers can share a word.
+		union
+		{
+			ReferenceCounted* forward;
+			WeakReferenceControl* volatile weakControl;
+		};
+#ifdef KROLL_BIASED_REFCOUNT
+		int localCount;
+		BiasedOwner* owner;
+#endif
+
+		void DuplicateSlow();
+		void ReleaseSlow();
+		bool ClearWeakReferences();
+		friend class WeakReferenceControl;
+#ifdef KROLL_BIASED_REFCOUNT
+		bool CountLocally(int delta);
+		void MergeLocalCount();
+		friend struct BiasedOwner;
+#endif
 	};
 }
 #endif
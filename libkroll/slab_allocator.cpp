@@ -0,0 +1,400 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_GRANULARITY 16
+#define SLAB_MAX_BLOCK_SIZE 256
+#define SLAB_SIZE_CLASSES (SLAB_MAX_BLOCK_SIZE / SLAB_GRANULARITY)
+#define SLAB_MAGAZINE_SIZE 64
+#define SLAB_MAX_TYPES 32
+
+namespace kroll
+{
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct SizeClass
+	{
+		Poco::FastMutex mutex;
+		FreeBlock* freeList;
+		size_t freeCount;
+		char* current;
+		char* end;
+		size_t slabs;
+		size_t carvedBlocks;
+	};
+
+	/**
+	 * What one thread allocated and freed. Objects are often freed by
+	 * another thread than the one which allocated them, so only the sums
+	 * over all threads are meaningful.
+	 */
+	struct ThreadCounts
+	{
+		size_t allocations[SLAB_MAX_TYPES];
+		size_t frees[SLAB_MAX_TYPES];
+		size_t allocatedBytes[SLAB_MAX_TYPES];
+		size_t freedBytes[SLAB_MAX_TYPES];
+		size_t allocatedBlocks[SLAB_SIZE_CLASSES];
+		size_t freedBlocks[SLAB_SIZE_CLASSES];
+	};
+
+	struct ThreadCache
+	{
+		FreeBlock* freeList[SLAB_SIZE_CLASSES];
+		size_t count[SLAB_SIZE_CLASSES];
+		ThreadCounts counts;
+		ThreadCache* next;
+		ThreadCache* previous;
+	};
+
+	/**
+	 * The caches of all running threads, so that their counters can be
+	 * summed, and the counters of the threads which exited.
+	 */
+	struct CacheRegistry
+	{
+		Poco::FastMutex mutex;
+		ThreadCache* caches;
+		ThreadCounts exited;
+	};
+
+	// The depot is created on first use, because Values are allocated
+	// during static initialization of other translation units. That happens
+	// while the library is loading, before any other thread exists.
+	static SizeClass* depot = 0;
+	static CacheRegistry* registry = 0;
+	static SlabTypeStats* typeStatsHead = 0;
+	static size_t typeCount = 0;
+
+	static void ReturnBlocks(size_t sizeClass, FreeBlock*& list, size_t& count, size_t toReturn);
+
+	static void AddCounts(ThreadCounts& into, const ThreadCounts& from)
+	{
+		for (size_t i = 0; i < SLAB_MAX_TYPES; i++)
+		{
+			into.allocations[i] += from.allocations[i];
+			into.frees[i] += from.frees[i];
+			into.allocatedBytes[i] += from.allocatedBytes[i];
+			into.freedBytes[i] += from.freedBytes[i];
+		}
+		for (size_t i = 0; i < SLAB_SIZE_CLASSES; i++)
+		{
+			into.allocatedBlocks[i] += from.allocatedBlocks[i];
+			into.freedBlocks[i] += from.freedBlocks[i];
+		}
+	}
+
+	static void DestroyThreadCache(void* data)
+	{
+		ThreadCache* cache = static_cast<ThreadCache*>(data);
+		for (size_t i = 0; i < SLAB_SIZE_CLASSES; i++)
+		{
+			ReturnBlocks(i, cache->freeList[i], cache->count[i], cache->count[i]);
+		}
+
+		{
+			Poco::FastMutex::ScopedLock lock(registry->mutex);
+			AddCounts(registry->exited, cache->counts);
+			if (cache->previous)
+				cache->previous->next = cache->next;
+			else
+				registry->caches = cache->next;
+			if (cache->next)
+				cache->next->previous = cache->previous;
+		}
+		free(cache);
+	}
+
+	// Magazines of threads which exit on Windows are not returned to the
+	// depot.
+	static ThreadLocal<ThreadCache> threadCache = { &DestroyThreadCache };
+
+	static void InitializeDepot()
+	{
+		if (depot)
+			return;
+
+		void* memory = malloc(sizeof(SizeClass) * SLAB_SIZE_CLASSES);
+		SizeClass* classes = static_cast<SizeClass*>(memory);
+		for (size_t i = 0; i < SLAB_SIZE_CLASSES; i++)
+		{
+			SizeClass* sizeClass = new (&classes[i]) SizeClass;
+			sizeClass->freeList = 0;
+			sizeClass->freeCount = 0;
+			sizeClass->current = 0;
+			sizeClass->end = 0;
+			sizeClass->slabs = 0;
+			sizeClass->carvedBlocks = 0;
+		}
+
+		void* registryMemory = calloc(1, sizeof(CacheRegistry));
+		registry = new (registryMemory) CacheRegistry;
+		registry->caches = 0;
+		depot = classes;
+	}
+
+	static ThreadCache* GetThreadCache()
+	{
+		ThreadCache* cache = threadCache.Get();
+		if (!cache)
+		{
+			cache = static_cast<ThreadCache*>(calloc(1, sizeof(ThreadCache)));
+			{
+				Poco::FastMutex::ScopedLock lock(registry->mutex);
+				cache->next = registry->caches;
+				if (cache->next)
+					cache->next->previous = cache;
+				registry->caches = cache;
+			}
+			threadCache.Set(cache);
+		}
+		return cache;
+	}
+
+	static inline size_t BlockSize(size_t sizeClass)
+	{
+		return (sizeClass + 1) * SLAB_GRANULARITY;
+	}
+
+	static void ReturnBlocks(size_t sizeClass, FreeBlock*& list, size_t& count, size_t toReturn)
+	{
+		if (toReturn == 0)
+			return;
+
+		SizeClass& c = depot[sizeClass];
+		Poco::FastMutex::ScopedLock lock(c.mutex);
+		for (size_t i = 0; i < toReturn && list; i++)
+		{
+			FreeBlock* block = list;
+			list = block->next;
+			block->next = c.freeList;
+			c.freeList = block;
+			c.freeCount++;
+			count--;
+		}
+	}
+
+	static void FetchBlocks(size_t sizeClass, ThreadCache* cache)
+	{
+		SizeClass& c = depot[sizeClass];
+		size_t blockSize = BlockSize(sizeClass);
+
+		Poco::FastMutex::ScopedLock lock(c.mutex);
+		while (cache->count[sizeClass] < SLAB_MAGAZINE_SIZE / 2)
+		{
+			FreeBlock* block = c.freeList;
+			if (block)
+			{
+				c.freeList = block->next;
+				c.freeCount--;
+			}
+			else
+			{
+				if (c.current + blockSize > c.end)
+				{
+					// Carve from a fresh slab. The tail of the old one is
+					// too small for a block, so it is simply abandoned.
+					char* slab = static_cast<char*>(malloc(SLAB_SIZE));
+					if (!slab)
+						break;
+					c.current = slab;
+					c.end = slab + SLAB_SIZE;
+					c.slabs++;
+				}
+				block = reinterpret_cast<FreeBlock*>(c.current);
+				c.current += blockSize;
+				c.carvedBlocks++;
+			}
+
+			block->next = cache->freeList[sizeClass];
+			cache->freeList[sizeClass] = block;
+			cache->count[sizeClass]++;
+		}
+	}
+
+	SlabTypeStats::SlabTypeStats(const char* typeName) :
+		typeName(typeName),
+		index(typeCount < SLAB_MAX_TYPES ? typeCount++ : SLAB_MAX_TYPES),
+		next(typeStatsHead)
+	{
+		// Types past SLAB_MAX_TYPES are allocated like any other, but
+		// their allocations are not counted.
+		typeStatsHead = this;
+	}
+
+	SlabTypeStats SlabAllocator::callbackStats("Callback");
+	SlabTypeStats SlabAllocator::argListStats("ArgList");
+
+	/*static*/
+	void* SlabAllocator::Allocate(size_t size, SlabTypeStats* stats)
+	{
+		if (size == 0)
+			size = 1;
+
+		InitializeDepot();
+		ThreadCache* cache = GetThreadCache();
+		if (stats->index < SLAB_MAX_TYPES)
+		{
+			cache->counts.allocations[stats->index]++;
+			cache->counts.allocatedBytes[stats->index] += size;
+		}
+
+		if (size > SLAB_MAX_BLOCK_SIZE)
+			return ::operator new(size);
+
+		size_t sizeClass = (size - 1) / SLAB_GRANULARITY;
+		if (!cache->freeList[sizeClass])
+		{
+			FetchBlocks(sizeClass, cache);
+			if (!cache->freeList[sizeClass])
+				throw std::bad_alloc();
+		}
+
+		FreeBlock* block = cache->freeList[sizeClass];
+		cache->freeList[sizeClass] = block->next;
+		cache->count[sizeClass]--;
+		cache->counts.allocatedBlocks[sizeClass]++;
+		return block;
+	}
+
+	/*static*/
+	void SlabAllocator::Free(void* pointer, size_t size, SlabTypeStats* stats)
+	{
+		if (!pointer)
+			return;
+
+		if (size == 0)
+			size = 1;
+
+		ThreadCache* cache = GetThreadCache();
+		if (stats->index < SLAB_MAX_TYPES)
+		{
+			cache->counts.frees[stats->index]++;
+			cache->counts.freedBytes[stats->index] += size;
+		}
+
+		if (size > SLAB_MAX_BLOCK_SIZE)
+		{
+			::operator delete(pointer);
+			return;
+		}
+
+		size_t sizeClass = (size - 1) / SLAB_GRANULARITY;
+		FreeBlock* block = static_cast<FreeBlock*>(pointer);
+		block->next = cache->freeList[sizeClass];
+		cache->freeList[sizeClass] = block;
+		cache->count[sizeClass]++;
+		cache->counts.freedBlocks[sizeClass]++;
+
+		if (cache->count[sizeClass] > SLAB_MAGAZINE_SIZE)
+		{
+			ReturnBlocks(sizeClass, cache->freeList[sizeClass],
+				cache->count[sizeClass], SLAB_MAGAZINE_SIZE / 2);
+		}
+	}
+
+	static void SumCounts(ThreadCounts& sum)
+	{
+		memset(&sum, 0, sizeof(ThreadCounts));
+		Poco::FastMutex::ScopedLock lock(registry->mutex);
+		AddCounts(sum, registry->exited);
+		for (ThreadCache* cache = registry->caches; cache; cache = cache->next)
+			AddCounts(sum, cache->counts);
+	}
+
+	static inline size_t Difference(size_t added, size_t removed)
+	{
+		// The counters of different threads are read at slightly different
+		// times, so an object freed by one thread may be seen freed before
+		// it is seen allocated by another.
+		return added > removed ? added - removed : 0;
+	}
+
+	/*static*/
+	void SlabAllocator::GetTypeCounts(std::vector<SlabTypeCounts>& counts)
+	{
+		InitializeDepot();
+		ThreadCounts sum;
+		SumCounts(sum);
+
+		for (SlabTypeStats* type = typeStatsHead; type; type = type->next)
+		{
+			if (type->index >= SLAB_MAX_TYPES)
+				continue;
+
+			SlabTypeCounts c;
+			c.typeName = type->typeName;
+			c.liveObjects = Difference(sum.allocations[type->index],
+				sum.frees[type->index]);
+			c.liveBytes = Difference(sum.allocatedBytes[type->index],
+				sum.freedBytes[type->index]);
+			c.totalAllocations = sum.allocations[type->index];
+			counts.push_back(c);
+		}
+	}
+
+	/*static*/
+	void SlabAllocator::GetSizeClassStats(std::vector<SlabSizeClassStats>& stats)
+	{
+		InitializeDepot();
+		ThreadCounts sum;
+		SumCounts(sum);
+
+		for (size_t i = 0; i < SLAB_SIZE_CLASSES; i++)
+		{
+			SizeClass& c = depot[i];
+			Poco::FastMutex::ScopedLock lock(c.mutex);
+
+			SlabSizeClassStats s;
+			s.blockSize = BlockSize(i);
+			s.slabs = c.slabs;
+			s.reservedBytes = c.slabs * SLAB_SIZE;
+			s.carvedBlocks = c.carvedBlocks;
+			s.depotBlocks = c.freeCount;
+			s.liveBlocks = Difference(sum.allocatedBlocks[i], sum.freedBlocks[i]);
+			stats.push_back(s);
+		}
+	}
+
+	/*static*/
+	void SlabAllocator::LogStatistics(Logger* logger)
+	{
+		std::vector<SlabTypeCounts> types;
+		GetTypeCounts(types);
+		for (size_t i = 0; i < types.size(); i++)
+		{
+			SlabTypeCounts& t = types[i];
+			logger->Debug("%s: %i live objects, %i live bytes, %i allocations",
+				t.typeName, (int) t.liveObjects, (int) t.liveBytes,
+				(int) t.totalAllocations);
+		}
+
+		std::vector<SlabSizeClassStats> classes;
+		GetSizeClassStats(classes);
+		for (size_t i = 0; i < classes.size(); i++)
+		{
+			SlabSizeClassStats& s = classes[i];
+			if (s.slabs == 0)
+				continue;
+
+			double occupancy = (double) (s.liveBlocks * s.blockSize) /
+				(double) s.reservedBytes;
+			logger->Debug("%i byte blocks: %i slabs, %i live blocks, "
+				"%i in depot, %.1f%% occupied", (int) s.blockSize,
+				(int) s.slabs, (int) s.liveBlocks, (int) s.depotBlocks,
+				occupancy * 100.0);
+		}
+	}
+}
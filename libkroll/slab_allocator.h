@@ -0,0 +1,113 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_SLAB_ALLOCATOR_H_
+#define _KR_SLAB_ALLOCATOR_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace kroll
+{
+	/**
+	 * Identifies one type of slab-allocated object to the allocator, which
+	 * counts its allocations. Instances register themselves on construction,
+	 * so they should only be created as statics, usually through
+	 * KROLL_SLAB_ALLOCATOR_IMPL.
+	 */
+	class KROLL_API SlabTypeStats
+	{
+		public:
+		SlabTypeStats(const char* typeName);
+
+		const char* typeName;
+		size_t index;
+		SlabTypeStats* next;
+	};
+
+	/**
+	 * A snapshot of the counters of one slab-allocated type.
+	 */
+	struct KROLL_API SlabTypeCounts
+	{
+		const char* typeName;
+		size_t liveObjects;
+		size_t liveBytes;
+		size_t totalAllocations;
+	};
+
+	/**
+	 * A snapshot of the state of one slab size class.
+	 */
+	struct KROLL_API SlabSizeClassStats
+	{
+		size_t blockSize;
+		size_t slabs;
+		size_t reservedBytes;
+		size_t carvedBlocks;
+		size_t depotBlocks;
+		size_t liveBlocks;
+	};
+
+	/**
+	 * A size-class slab allocator for small, hot binding objects such as
+	 * Values, bound methods, callbacks and argument lists.
+	 *
+	 * Each thread keeps a small free list (a magazine) per size class, so
+	 * most allocations and frees never take a lock. Memory freed on another
+	 * thread than the one which allocated it simply joins the freeing
+	 * thread's magazine. When a magazine runs dry or overflows, half of it
+	 * is exchanged with the shared depot for that size class. Slabs are
+	 * never returned to the system; allocations larger than the biggest
+	 * size class go straight to the global heap.
+	 *
+	 * The counters behind the statistics are kept per thread too, so that
+	 * allocating touches no shared cache line. They are summed when the
+	 * statistics are asked for, which makes the sums approximate while
+	 * other threads are allocating.
+	 */
+	class KROLL_API SlabAllocator
+	{
+		public:
+		static void* Allocate(size_t size, SlabTypeStats* stats);
+		static void Free(void* pointer, size_t size, SlabTypeStats* stats);
+
+		static void GetTypeCounts(std::vector<SlabTypeCounts>& counts);
+		static void GetSizeClassStats(std::vector<SlabSizeClassStats>& stats);
+		static void LogStatistics(Logger* logger);
+
+		static SlabTypeStats callbackStats;
+		static SlabTypeStats argListStats;
+	};
+}
+
+/**
+ * Declare class-specific operator new and delete which allocate
+ * instances of the class (and its subclasses) from the slab allocator.
+ */
+#define KROLL_SLAB_ALLOCATED \
+	public: \
+	static void* operator new(size_t size); \
+	static void operator delete(void* pointer, size_t size);
+
+/**
+ * Define the operators declared by KROLL_SLAB_ALLOCATED. This should be
+ * placed in the class' translation unit, before any static instances.
+ */
+#define KROLL_SLAB_ALLOCATOR_IMPL(ClassName) \
+	static kroll::SlabTypeStats ClassName##SlabStats(#ClassName); \
+	void* ClassName::operator new(size_t size) \
+	{ \
+		void* pointer = kroll::SlabAllocator::Allocate(size, &ClassName##SlabStats); \
+		if (kroll::ObjectAccounting::IsEnabled()) \
+			kroll::ObjectAccounting::NoteAllocation(pointer, size); \
+		return pointer; \
+	} \
+	void ClassName::operator delete(void* pointer, size_t size) \
+	{ \
+		kroll::SlabAllocator::Free(pointer, size, &ClassName##SlabStats); \
+	}
+
+#endif
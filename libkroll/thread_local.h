@@ -0,0 +1,91 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_THREAD_LOCAL_H_
+#define _KR_THREAD_LOCAL_H_
+
+#include "atomic.h"
+#include <Poco/Thread.h>
+
+#ifndef OS_WIN32
+#include <pthread.h>
+#endif
+
+namespace kroll
+{
+	/**
+	 * A pointer which each thread keeps for itself. Declare it as a static
+	 * aggregate along with the function which frees a thread's value when
+	 * the thread exits, or NULL. It needs no constructor, so it works from
+	 * the static initialization of any translation unit, and its key is
+	 * created the first time any thread reaches it.
+	 * \code
+	 * static ThreadLocal<FormatBuffer> formatBuffer = { &DestroyFormatBuffer };
+	 * FormatBuffer* buffer = formatBuffer.Get();
+	 * \endcode
+	 *
+	 * Windows offers no TLS destructors, so there the values of threads
+	 * which exit are never freed.
+	 */
+	template <class T>
+	struct ThreadLocal
+	{
+		void (*destroy)(void*);
+		volatile AtomicWord state;
+#ifdef OS_WIN32
+		DWORD key;
+#else
+		pthread_key_t key;
+#endif
+
+		enum { KEY_MISSING, KEY_CREATING, KEY_CREATED };
+
+		/**
+		 * @return the calling thread's value, or NULL if it set none
+		 */
+		T* Get()
+		{
+			this->CreateKey();
+#ifdef OS_WIN32
+			return static_cast<T*>(TlsGetValue(this->key));
+#else
+			return static_cast<T*>(pthread_getspecific(this->key));
+#endif
+		}
+
+		void Set(T* value)
+		{
+			this->CreateKey();
+#ifdef OS_WIN32
+			TlsSetValue(this->key, value);
+#else
+			pthread_setspecific(this->key, value);
+#endif
+		}
+
+		void CreateKey()
+		{
+			if (this->state == KEY_CREATED)
+				return;
+
+			if (AtomicCompareAndSwap(&this->state, KEY_MISSING, KEY_CREATING))
+			{
+#ifdef OS_WIN32
+				this->key = TlsAlloc();
+#else
+				pthread_key_create(&this->key, this->destroy);
+#endif
+				AtomicCompareAndSwap(&this->state, KEY_CREATING, KEY_CREATED);
+				return;
+			}
+
+			// Another thread is creating the key, which takes no time.
+			while (this->state != KEY_CREATED)
+				Poco::Thread::yield();
+		}
+	};
+}
+
+#endif
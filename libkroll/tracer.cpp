@@ -0,0 +1,212 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <cstring>
+#include <algorithm>
+#include <Poco/Mutex.h>
+#include <Poco/ScopedLock.h>
+#include <Poco/Timestamp.h>
+#include <Poco/Thread.h>
+#include <Poco/Process.h>
+
+#define TRACER_NAME_LENGTH 48
+
+namespace kroll
+{
+	struct TraceEvent
+	{
+		const char* category;
+		Poco::Int64 start;
+		Poco::Int64 duration;
+		char name[TRACER_NAME_LENGTH];
+	};
+
+	/**
+	 * The ring of spans recorded by one thread. Its mutex is only ever
+	 * contended while the trace is being written.
+	 */
+	struct TraceBuffer
+	{
+		Poco::FastMutex mutex;
+		int threadId;
+		std::string threadName;
+		bool exited;
+		TraceEvent* events;
+		size_t capacity;
+		size_t next;
+		size_t count;
+	};
+
+	static Poco::FastMutex buffersMutex;
+	static std::vector<TraceBuffer*> buffers;
+	static int nextThreadId = 1;
+	static volatile AtomicWord spansPerThread = 65536;
+	static Poco::Int64 traceStart = 0;
+
+	volatile bool Tracer::enabled = false;
+
+	static void FreeBuffer(TraceBuffer* buffer)
+	{
+		delete [] buffer->events;
+		delete buffer;
+	}
+
+	static void ThreadExited(void* data)
+	{
+		// Keep the spans of the thread until tracing is enabled again.
+		TraceBuffer* buffer = static_cast<TraceBuffer*>(data);
+		Poco::FastMutex::ScopedLock lock(buffer->mutex);
+		buffer->exited = true;
+	}
+
+	static ThreadLocal<TraceBuffer> threadBuffer = { &ThreadExited };
+
+	static TraceBuffer* GetThreadBuffer()
+	{
+		TraceBuffer* buffer = threadBuffer.Get();
+		if (buffer)
+			return buffer;
+
+		buffer = new TraceBuffer();
+		buffer->exited = false;
+		buffer->capacity = std::max((size_t) spansPerThread, (size_t) 1);
+		buffer->events = new TraceEvent[buffer->capacity];
+		buffer->next = 0;
+		buffer->count = 0;
+
+		Poco::Thread* thread = Poco::Thread::current();
+		{
+			Poco::FastMutex::ScopedLock lock(buffersMutex);
+			buffer->threadId = nextThreadId++;
+			if (thread)
+				buffer->threadName = thread->getName();
+			else if (IsMainThread())
+				buffer->threadName = "Main";
+			buffers.push_back(buffer);
+		}
+
+		threadBuffer.Set(buffer);
+		return buffer;
+	}
+
+	/*static*/
+	void Tracer::Enable(size_t spansPerThread)
+	{
+		Poco::FastMutex::ScopedLock lock(buffersMutex);
+		kroll::spansPerThread = (AtomicWord) spansPerThread;
+		traceStart = Now();
+
+		std::vector<TraceBuffer*> running;
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			TraceBuffer* buffer = buffers[i];
+			bool exited;
+			{
+				Poco::FastMutex::ScopedLock bufferLock(buffer->mutex);
+				exited = buffer->exited;
+				buffer->next = 0;
+				buffer->count = 0;
+			}
+
+			if (exited)
+				FreeBuffer(buffer);
+			else
+				running.push_back(buffer);
+		}
+		buffers.swap(running);
+		enabled = true;
+	}
+
+	/*static*/
+	void Tracer::Disable()
+	{
+		enabled = false;
+	}
+
+	/*static*/
+	Poco::Int64 Tracer::Now()
+	{
+		return Poco::Timestamp().epochMicroseconds();
+	}
+
+	/*static*/
+	void Tracer::Record(const char* category, const std::string& name,
+		Poco::Int64 start)
+	{
+		Poco::Int64 end = Now();
+		TraceBuffer* buffer = GetThreadBuffer();
+		Poco::FastMutex::ScopedLock lock(buffer->mutex);
+
+		TraceEvent& event = buffer->events[buffer->next];
+		event.category = category;
+		event.start = start;
+		event.duration = end - start;
+		size_t length = std::min(name.size(), (size_t) TRACER_NAME_LENGTH - 1);
+		memcpy(event.name, name.data(), length);
+		event.name[length] = '\0';
+
+		buffer->next = (buffer->next + 1) % buffer->capacity;
+		buffer->count = std::min(buffer->count + 1, buffer->capacity);
+	}
+
+	static void WriteString(std::ostream& stream, const char* text)
+	{
+		stream << '"';
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				stream << '\\' << *c;
+			else if ((unsigned char) *c < 0x20)
+				stream << ' ';
+			else
+				stream << *c;
+		}
+		stream << '"';
+	}
+
+	/*static*/
+	void Tracer::WriteTrace(std::ostream& stream)
+	{
+		long pid = (long) Poco::Process::id();
+		bool first = true;
+
+		stream << "{\"traceEvents\":[\n";
+		Poco::FastMutex::ScopedLock lock(buffersMutex);
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			TraceBuffer* buffer = buffers[i];
+			Poco::FastMutex::ScopedLock bufferLock(buffer->mutex);
+
+			if (!buffer->threadName.empty())
+			{
+				stream << (first ? "" : ",\n")
+					<< "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+					<< ",\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+				WriteString(stream, buffer->threadName.c_str());
+				stream << "}}";
+				first = false;
+			}
+
+			// The oldest span is where the next one will go once the ring
+			// is full.
+			size_t oldest = buffer->count < buffer->capacity ? 0 : buffer->next;
+			for (size_t j = 0; j < buffer->count; j++)
+			{
+				TraceEvent& event = buffer->events[(oldest + j) % buffer->capacity];
+				stream << (first ? "" : ",\n") << "{\"ph\":\"X\",\"cat\":";
+				WriteString(stream, event.category);
+				stream << ",\"name\":";
+				WriteString(stream, event.name);
+				stream << ",\"pid\":" << pid << ",\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << (event.start - traceStart)
+					<< ",\"dur\":" << event.duration << "}";
+				first = false;
+			}
+		}
+		stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		stream.flush();
+	}
+}
@@ -0,0 +1,100 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_TRACER_H_
+#define _KR_TRACER_H_
+
+#include <string>
+#include <ostream>
+#include <Poco/Types.h>
+
+namespace kroll
+{
+	/**
+	 * Records spans around method calls across the language bridges, so
+	 * that nested calls, such as a JavaScript call into Python which
+	 * calls back into C++, can be seen on a timeline. The spans are
+	 * written in the Chrome trace-event format, which chrome://tracing
+	 * and Perfetto can load.
+	 *
+	 * Each thread records into a ring of its own, which holds its most
+	 * recent spans and needs no lock shared with other threads. Spans are
+	 * only recorded once they end, so a span never lacks its end.
+	 */
+	class KROLL_API Tracer
+	{
+		public:
+		/**
+		 * Start recording, dropping anything recorded before.
+		 * @param spansPerThread the number of spans each thread keeps.
+		 * Threads which already recorded keep the ring they have.
+		 */
+		static void Enable(size_t spansPerThread=65536);
+		static void Disable();
+		static bool IsEnabled() { return enabled; }
+
+		/**
+		 * Write the spans of all threads as a trace-event JSON document.
+		 */
+		static void WriteTrace(std::ostream& stream);
+
+		/**
+		 * @return the time to pass to Record as the start of a span
+		 */
+		static Poco::Int64 Now();
+
+		/**
+		 * @param category a string which lives as long as the program,
+		 * such as "Python"
+		 */
+		static void Record(const char* category, const std::string& name,
+			Poco::Int64 start);
+
+		private:
+		static volatile bool enabled;
+	};
+
+	/**
+	 * Records a span for as long as it is in scope, named after the
+	 * function which is being called. The name is only copied when the
+	 * span ends, so it must live at least as long as the span. Names which
+	 * are costly to find can be looked up only while tracing is enabled;
+	 * a span with a NULL name records nothing.
+	 * \code
+	 * KValueRef StaticBoundMethod::Call(const ValueList& args)
+	 * {
+	 *     TraceSpan span("Native", this->name.c_str());
+	 *     ...
+	 * }
+	 * \endcode
+	 */
+	class KROLL_API TraceSpan
+	{
+		public:
+		TraceSpan(const char* category, const char* name) :
+			category(0)
+		{
+			if (name && Tracer::IsEnabled())
+			{
+				this->category = category;
+				this->name = name;
+				this->start = Tracer::Now();
+			}
+		}
+
+		~TraceSpan()
+		{
+			if (this->category)
+				Tracer::Record(this->category, this->name, this->start);
+		}
+
+		private:
+		const char* category;
+		const char* name;
+		Poco::Int64 start;
+	};
+}
+
+#endif
@@ -193,6 +193,8 @@ namespace URLUtils
 	}
 
 #if defined(KROLL_API_EXPORT) || defined(_KROLL_H_)
+	static LoggerHandle logger = { "URLUtils" };
+
 	static std::string NormalizeAppURL(const std::string& url)
 	{
 		size_t appLength = 6; // app://
@@ -285,8 +287,7 @@ namespace URLUtils
 		catch (ValueException& e)
 		{
 			SharedString ss = e.DisplayString();
-			Logger* log = Logger::Get("URLUtils");
-			log->Error("Could not convert %s to a path: %s", url.c_str(), ss->c_str());
+			logger->Error("Could not convert %s to a path: %s", url.c_str(), ss->c_str());
 		}
 		return url;
 	}
@@ -323,13 +324,11 @@ namespace URLUtils
 		catch (ValueException& e)
 		{
 			SharedString ss = e.DisplayString();
-			Logger* log = Logger::Get("URLUtils");
-			log->Error("Could not convert %s to a path: %s", tiURL.c_str(), ss->c_str());
+			logger->Error("Could not convert %s to a path: %s", tiURL.c_str(), ss->c_str());
 		}
 		catch (...)
 		{
-			Logger* log = Logger::Get("URLUtils");
-			log->Error("Could not convert %s to a path", tiURL.c_str());
+			logger->Error("Could not convert %s to a path", tiURL.c_str());
 		}
 		return tiURL;
 	}
@@ -361,13 +360,11 @@ namespace URLUtils
 		catch (ValueException& e)
 		{
 			SharedString ss = e.DisplayString();
-			Logger* log = Logger::Get("URLUtils");
-			log->Error("Could not convert %s to a path: %s", inURL.c_str(), ss->c_str());
+			logger->Error("Could not convert %s to a path: %s", inURL.c_str(), ss->c_str());
 		}
 		catch (...)
 		{
-			Logger* log = Logger::Get("URLUtils");
-			log->Error("Could not convert %s to a path", inURL.c_str());
+			logger->Error("Could not convert %s to a path", inURL.c_str());
 		}
 
 		return inURL;
@@ -0,0 +1,50 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#include "kroll.h"
+#include <Poco/ScopedLock.h>
+
+#define WEAK_REFERENCE_LOCKS 64
+
+namespace kroll
+{
+	static Poco::FastMutex weakReferenceLocks[WEAK_REFERENCE_LOCKS];
+
+	WeakReferenceControl::WeakReferenceControl(ReferenceCounted* object) :
+		object(object),
+		references(1) // The object's own reference
+	{
+	}
+
+	ReferenceCounted* WeakReferenceControl::Lock()
+	{
+		Poco::FastMutex::ScopedLock lock(this->GetMutex());
+		if (object && object->TryDuplicate())
+			return object;
+		return 0;
+	}
+
+	bool WeakReferenceControl::IsAlive()
+	{
+		return object != 0;
+	}
+
+	void WeakReferenceControl::duplicate()
+	{
+		++references;
+	}
+
+	void WeakReferenceControl::release()
+	{
+		if (--references == 0)
+			delete this;
+	}
+
+	Poco::FastMutex& WeakReferenceControl::GetMutex()
+	{
+		size_t index = (reinterpret_cast<size_t>(this) >> 4) % WEAK_REFERENCE_LOCKS;
+		return weakReferenceLocks[index];
+	}
+}
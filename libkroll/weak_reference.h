@@ -0,0 +1,153 @@
+/**
+ * Appcelerator Kroll - licensed under the Apache Public License 2
+ * see LICENSE in the root folder for details on the license.
+ * Copyright (c) 2009 Appcelerator, Inc. All Rights Reserved.
+ */
+#ifndef _KR_WEAK_REFERENCE_H_
+#define _KR_WEAK_REFERENCE_H_
+
+#include <Poco/AtomicCounter.h>
+#include <Poco/Mutex.h>
+
+namespace kroll
+{
+	/**
+	 * The block shared by an object and all weak references to it. It
+	 * outlives the object for as long as weak references to it remain.
+	 */
+	class KROLL_API WeakReferenceControl
+	{
+		public:
+		WeakReferenceControl(ReferenceCounted* object);
+
+		/**
+		 * Take a new strong reference to the object.
+		 * @return the object or NULL if it has already been destroyed
+		 */
+		ReferenceCounted* Lock();
+
+		/**
+		 * @return true if the object has not been destroyed yet. The
+		 * answer may be out of date by the time it is used.
+		 */
+		bool IsAlive();
+
+		void duplicate();
+		void release();
+
+		/**
+		 * Control blocks share a small set of locks, which guard
+		 * the object pointer against concurrent destruction.
+		 */
+		Poco::FastMutex& GetMutex();
+
+		private:
+		ReferenceCounted* volatile object;
+		Poco::AtomicCounter references;
+
+		friend class ReferenceCounted;
+	};
+
+	/**
+	 * A reference to a ReferenceCounted object which does not keep it
+	 * alive. This can be used for caches, identity maps and listener
+	 * registries which should not own the objects they hold.
+	 * \code
+	 * KWeakRef<KObject> weak(object);
+	 * KObjectRef strong(weak.Lock());
+	 * if (!strong.isNull())
+	 *     strong->Get("foo");
+	 * \endcode
+	 */
+	template <class T>
+	class KWeakRef
+	{
+		public:
+		KWeakRef() :
+			pointer(0),
+			control(0)
+		{
+		}
+
+		KWeakRef(T* pointer) :
+			pointer(pointer),
+			control(0)
+		{
+			this->Attach();
+		}
+
+		KWeakRef(const AutoPtr<T>& reference) :
+			pointer(const_cast<T*>(reference.get())),
+			control(0)
+		{
+			this->Attach();
+		}
+
+		KWeakRef(const KWeakRef<T>& other) :
+			pointer(other.pointer),
+			control(other.control)
+		{
+			if (control)
+				control->duplicate();
+		}
+
+		~KWeakRef()
+		{
+			if (control)
+				control->release();
+		}
+
+		KWeakRef<T>& operator=(const KWeakRef<T>& other)
+		{
+			if (other.control)
+				other.control->duplicate();
+			if (control)
+				control->release();
+
+			pointer = other.pointer;
+			control = other.control;
+			return *this;
+		}
+
+		/**
+		 * @return a strong reference to the object or a null reference
+		 * if the object has already been destroyed
+		 */
+		AutoPtr<T> Lock() const
+		{
+			if (control && control->Lock())
+				return AutoPtr<T>(pointer);
+			return AutoPtr<T>();
+		}
+
+		bool IsAlive() const
+		{
+			return control && control->IsAlive();
+		}
+
+		bool operator==(const KWeakRef<T>& other) const
+		{
+			return control == other.control && pointer == other.pointer;
+		}
+
+		bool operator!=(const KWeakRef<T>& other) const
+		{
+			return !(*this == other);
+		}
+
+		private:
+		T* pointer;
+		WeakReferenceControl* control;
+
+		void Attach()
+		{
+			if (!pointer)
+				return;
+
+			control = pointer->GetWeakReferenceControl();
+			control->duplicate();
+		}
+	};
+}
+
+#endif
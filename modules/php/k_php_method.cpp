@@ -28,6 +28,7 @@ namespace kroll {
 
 	KValueRef KPHPMethod::Call(const ValueList& args)
 	{
+		TraceSpan span("PHP", this->methodName);
 		TSRMLS_FETCH();
 
 		zval* zReturnValue = NULL;
@@ -326,14 +326,15 @@ namespace kroll
 
 		zend_function* GetGlobalFunction(const char *name TSRMLS_DC)
 		{
+			static LoggerHandle logger = { "PHP" };
 			zend_function *function;
 			if (zend_hash_find(EG(function_table), (char*)name, strlen(name)+1, (void **) &function) == SUCCESS)
 			{
-				Logger::Get("PHP")->Debug("Succeeded finding Global function: %s", name);
+				logger->Debug("Succeeded finding Global function: %s", name);
 				return function;
 			}
 			
-			Logger::Get("PHP")->Debug("Failed to find Global function: %s", name);
+			logger->Debug("Failed to find Global function: %s", name);
 			return 0;
 		}
 
@@ -9,24 +9,56 @@ namespace kroll
 {
 	KPythonMethod::KPythonMethod(PyObject *method) :
 		KMethod("Python.KMethod"),
+		CycleCollectable(this),
 		method(method),
 		object(new KPythonObject(method))
 	{
 		PyLockGIL lock;
 		Py_INCREF(this->method);
+		CycleCollector::Add(this);
 	}
 
 	KPythonMethod::~KPythonMethod()
 	{
+		CycleCollector::Remove(this);
 		PyLockGIL lock;
-		Py_DECREF(this->method);
+		Py_XDECREF(this->method);
+	}
+
+	const char* KPythonMethod::GetTraceName()
+	{
+		PyLockGIL lock;
+		if (!this->traceName.empty())
+			return this->traceName.c_str();
+
+		// Only read the name of callables whose __name__ is built in, so
+		// that tracing never runs a class's own __getattr__. Others are
+		// traced under the type.
+		if (this->method && (PyFunction_Check(this->method) ||
+			PyMethod_Check(this->method) || PyCFunction_Check(this->method) ||
+			PyType_Check(this->method)))
+		{
+			PyObject* name = PyObject_GetAttrString(this->method, "__name__");
+			if (name && PyString_Check(name))
+				this->traceName = PyString_AsString(name);
+			else
+				PyErr_Clear();
+			Py_XDECREF(name);
+		}
+		if (this->traceName.empty())
+			this->traceName = this->GetType();
+		return this->traceName.c_str();
 	}
 
 	KValueRef KPythonMethod::Call(const ValueList& args)
 	{
+		TraceSpan span("Python", Tracer::IsEnabled() ? this->GetTraceName() : 0);
 		PyLockGIL lock;
 		PyObject *arglist = NULL;
 
+		if (!this->method)
+			throw ValueException::FromString("Python method was collected");
+
 		if (args.size() > 0)
 		{
 			arglist = PyTuple_New(args.size());
@@ -56,21 +88,35 @@ namespace kroll
 
 	void KPythonMethod::Set(const char *name, KValueRef value)
 	{
+		if (this->object.isNull())
+			return;
+
 		this->object->Set(name, value);
 	}
 
 	KValueRef KPythonMethod::Get(const char *name)
 	{
+		if (this->object.isNull())
+			return Value::Undefined;
+
 		return this->object->Get(name);
 	}
 
 	SharedStringList KPythonMethod::GetPropertyNames()
 	{
+		if (this->object.isNull())
+			return SharedStringList(new StringList());
+
 		return this->object->GetPropertyNames();
 	}
 
 	PyObject* KPythonMethod::ToPython()
 	{
+		// A collected method is None to Python, like a borrowed reference
+		// to any other object.
+		if (this->object.isNull())
+			return Py_None;
+
 		return this->object->ToPython();
 	}
 
@@ -82,7 +128,28 @@ namespace kroll
 		if (pyOther.isNull())
 			return false;
 
+		if (this->object.isNull() || pyOther->object.isNull())
+			return false;
+
 		return pyOther->ToPython() == this->ToPython();
 	}
 
+	void KPythonMethod::Traverse(CycleCollectorTraversal& traversal)
+	{
+		PyLockGIL lock;
+		if (!this->method)
+			return;
+
+		// Both this object and its KPythonObject pin the method.
+		PythonUtils::TraverseBridgeReferences(this->method, 2, traversal);
+	}
+
+	void KPythonMethod::Unlink()
+	{
+		PyLockGIL lock;
+		PyObject* unlinked = this->method;
+		this->method = NULL;
+		this->object = NULL;
+		Py_XDECREF(unlinked);
+	}
 }
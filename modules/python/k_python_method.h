@@ -12,7 +12,7 @@
 namespace kroll
 {
 	class KPythonObject;
-	class KPythonMethod : public KMethod
+	class KPythonMethod : public KMethod, public CycleCollectable
 	{
 	public:
 		KPythonMethod(PyObject *obj);
@@ -25,9 +25,19 @@ namespace kroll
 		virtual SharedStringList GetPropertyNames();
 		PyObject* ToPython();
 
+		virtual void Traverse(CycleCollectorTraversal& traversal);
+		virtual void Unlink();
+
 	private:
 		PyObject* method;
 		AutoPtr<KPythonObject> object;
+		std::string traceName;
+
+		/**
+		 * The name spans are recorded under, found the first time the
+		 * method is called while tracing.
+		 */
+		const char* GetTraceName();
 		DISALLOW_EVIL_CONSTRUCTORS(KPythonMethod);
 	};
 }
@@ -4,6 +4,11 @@
  * Copyright (c) 2008 Appcelerator, Inc. All Rights Reserved.
  */
 #include "python_module.h"
+#include <set>
+#include <algorithm>
+
+// Python graphs larger than this are not traversed by the cycle collector.
+#define MAX_BRIDGE_TRAVERSAL 10000
 
 namespace kroll
 {
@@ -20,12 +25,33 @@ namespace kroll
 	static PyObject* PyKListInPlaceConcat(PyObject*, PyObject*);
 	static PyObject* PyKListInPlaceRepeat(PyObject*, Py_ssize_t);
 	static PyObject* PyKMethod_call(PyObject*, PyObject *, PyObject*);
+	static void PyKBytes_dealloc(PyObject*);
+	static PyObject* PyKBytes_str(PyObject*);
+	static Py_ssize_t PyKBytesLength(PyObject*);
+	static PyObject* PyKBytesGetItem(PyObject*, Py_ssize_t);
+	static PyObject* PyKBytesSlice(PyObject*, Py_ssize_t, Py_ssize_t);
+	static Py_ssize_t PyKBytesGetReadBuffer(PyObject*, Py_ssize_t, void**);
+	static Py_ssize_t PyKBytesGetSegmentCount(PyObject*, Py_ssize_t*);
+	static Py_ssize_t PyKBytesGetCharBuffer(PyObject*, Py_ssize_t, char**);
+#if PY_VERSION_HEX >= 0x02060000
+	static int PyKBytesGetBuffer(PyObject*, Py_buffer*, int);
+#endif
 
 	typedef struct {
 		PyObject_HEAD
 		KValueRef* value;
 	} PyKObject;
 
+	// Bytes wrappers start like any other object wrapper, so they share
+	// its attribute access. The view is a slice of the whole Bytes, which
+	// keeps its storage alive and shared for as long as Python may hold a
+	// pointer into it. Shared storage is never changed in place.
+	typedef struct {
+		PyObject_HEAD
+		KValueRef* value;
+		BytesRef* view;
+	} PyKBytes;
+
 	static PyTypeObject PyKObjectType =
 	{
 		PyObject_HEAD_INIT(NULL)
@@ -133,7 +159,45 @@ namespace kroll
 		0                           /* tp_base */
 	};
 
+	static PyTypeObject PyKBytesType =
+	{
+		PyObject_HEAD_INIT(NULL)
+		0,
+		"KBytes",
+		sizeof(PyKBytes),
+		0,
+		PyKBytes_dealloc,           /*tp_dealloc*/
+		0,                          /*tp_print*/
+		PyKObject_getattr,          /*tp_getattr*/
+		PyKObject_setattr,          /*tp_setattr*/
+		0,                          /*tp_compare*/
+		0,                          /*tp_repr*/
+		0,                          /*tp_as_number*/
+		0,                          /*tp_as_sequence*/
+		0,                          /*tp_as_mapping*/
+		0,                          /*tp_hash */
+		0,                          /*tp_call */
+		PyKBytes_str,               /*tp_str */
+		0,                          /*tp_getattro*/
+		0,                          /*tp_setattro*/
+		0,                          /*tp_as_buffer*/
+		0,                          /*tp_flags*/
+		0,                          /*tp_doc*/
+		0,                          /* tp_traverse */
+		0,                          /* tp_clear */
+		0,                          /* tp_richcompare */
+		0,                          /* tp_weaklistoffset */
+		0,                          /* tp_iter */
+		0,                          /* tp_iternext */
+		0,                          /* tp_methods */
+		0,                          /* tp_members */
+		0,                          /* tp_getset */
+		0                           /* tp_base */
+	};
+
 	PySequenceMethods KPySequenceMethods = { 0 };
+	PySequenceMethods KPyBytesSequenceMethods = { 0 };
+	PyBufferProcs KPyBytesBufferProcs = { 0 };
 
 	void PythonUtils::InitializePythonKClasses()
 	{
@@ -151,6 +215,21 @@ namespace kroll
 		PyKListType.tp_as_sequence = &KPySequenceMethods;
 		PyKListType.tp_flags = Py_TPFLAGS_HAVE_INPLACEOPS | Py_TPFLAGS_HAVE_SEQUENCE_IN;
 
+		KPyBytesSequenceMethods.sq_length = &PyKBytesLength;
+		KPyBytesSequenceMethods.sq_item = &PyKBytesGetItem;
+		KPyBytesSequenceMethods.sq_slice = &PyKBytesSlice;
+		KPyBytesBufferProcs.bf_getreadbuffer = &PyKBytesGetReadBuffer;
+		KPyBytesBufferProcs.bf_getsegcount = &PyKBytesGetSegmentCount;
+		KPyBytesBufferProcs.bf_getcharbuffer = &PyKBytesGetCharBuffer;
+
+		PyKBytesType.tp_as_sequence = &KPyBytesSequenceMethods;
+		PyKBytesType.tp_as_buffer = &KPyBytesBufferProcs;
+		PyKBytesType.tp_flags = Py_TPFLAGS_HAVE_GETCHARBUFFER;
+#if PY_VERSION_HEX >= 0x02060000
+		KPyBytesBufferProcs.bf_getbuffer = &PyKBytesGetBuffer;
+		PyKBytesType.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+
 		if (PyType_Ready(&PyKObjectType) < 0)
 			throw ValueException::FromString("Could not initialize PyKObjectType!");
 
@@ -160,6 +239,9 @@ namespace kroll
 		if (PyType_Ready(&PyKMethodType) < 0)
 			throw ValueException::FromString("Could not initialize PyKMethodType!");
 
+		if (PyType_Ready(&PyKBytesType) < 0)
+			throw ValueException::FromString("Could not initialize PyKBytesType!");
+
 	}
 
 	PyObject* PythonUtils::ToPyObject(KValueRef value)
@@ -233,6 +315,11 @@ namespace kroll
 			{
 				pythonValue = pydict->ToPython();
 			}
+			else if (!obj.cast<Bytes>().isNull())
+			{
+				pythonValue = PythonUtils::BytesToPyObject(value);
+				needsReferenceIncrement = false;
+			}
 			else
 			{
 				pythonValue = PythonUtils::KObjectToPyObject(value);
@@ -344,6 +431,27 @@ namespace kroll
 			PyKObject *o = reinterpret_cast<PyKObject*>(value);
 			kvalue = *(o->value);
 		}
+		else if (PyObject_TypeCheck(value, &PyKBytesType))
+		{
+			PyKObject *o = reinterpret_cast<PyKObject*>(value);
+			kvalue = *(o->value);
+		}
+
+		// Passing a buffer or memoryview asks for Bytes which use
+		// Python's memory directly. Strings are still copied into strings.
+		else if (PyBuffer_Check(value)
+#if PY_VERSION_HEX >= 0x02070000
+			|| PyMemoryView_Check(value)
+#endif
+			)
+		{
+			BytesRef bytes(PythonUtils::ToBytes(value));
+			if (bytes.isNull())
+			{
+				THROW_PYTHON_EXCEPTION
+			}
+			kvalue = Value::NewObject(bytes);
+		}
 		else if (PyObject_TypeCheck(value, &PyModule_Type))
 		{
 			kvalue = Value::NewObject(new KPythonObject(value));
@@ -380,7 +488,8 @@ namespace kroll
 		if (kvalue.isNull())
 		{
 			std::string valueStr(PythonUtils::ToString(value));
-			Logger::Get("Python.PythonUtils")->Error(
+			static LoggerHandle logger = { "Python.PythonUtils" };
+			logger->Error(
 				"Failed to convert Python value to Kroll value: %s",
 				valueStr.c_str());
 			kvalue = Value::Undefined;
@@ -458,6 +567,174 @@ namespace kroll
 		return (PyObject*) obj;
 	}
 
+	/**
+	 * Storage for Bytes which view memory owned by a Python object. The
+	 * object is kept alive, and with a new-style buffer its exporter is
+	 * kept from moving the memory, until the last Bytes is gone.
+	 */
+	class PythonBytesStorage : public BytesStorage
+	{
+	public:
+		PythonBytesStorage(PyObject* object, char* data, long length) :
+			BytesStorage(data, length),
+			object(object),
+			hasView(false)
+		{
+			Py_INCREF(object);
+		}
+
+#if PY_VERSION_HEX >= 0x02060000
+		PythonBytesStorage(Py_buffer& view) :
+			BytesStorage(static_cast<char*>(view.buf), (long) view.len),
+			object(0),
+			view(view),
+			hasView(true)
+		{
+		}
+#endif
+
+		virtual ~PythonBytesStorage()
+		{
+			{
+				PyLockGIL lock;
+#if PY_VERSION_HEX >= 0x02060000
+				if (hasView)
+					PyBuffer_Release(&view);
+#endif
+				Py_XDECREF(object);
+			}
+			this->buffer = 0;
+		}
+
+		virtual bool IsWritable() { return false; }
+
+		// Only Python strings are known to be terminated, so assume that
+		// no buffer is.
+		virtual bool IsTerminated() { return false; }
+
+	private:
+		PyObject* object;
+#if PY_VERSION_HEX >= 0x02060000
+		Py_buffer view;
+#endif
+		bool hasView;
+	};
+
+	BytesRef PythonUtils::ToBytes(PyObject* value)
+	{
+		PyLockGIL lock;
+#if PY_VERSION_HEX >= 0x02060000
+		if (PyObject_CheckBuffer(value))
+		{
+			Py_buffer view;
+			if (PyObject_GetBuffer(value, &view, PyBUF_SIMPLE) < 0)
+				return 0;
+			return new Bytes(new PythonBytesStorage(view));
+		}
+#endif
+
+		const void* data;
+		Py_ssize_t length;
+		if (PyObject_AsReadBuffer(value, &data, &length) < 0)
+			return 0;
+		return new Bytes(new PythonBytesStorage(value,
+			static_cast<char*>(const_cast<void*>(data)), (long) length));
+	}
+
+	PyObject* PythonUtils::BytesToPyObject(KValueRef v)
+	{
+		PyLockGIL lock;
+		BytesRef bytes(v->ToObject().cast<Bytes>());
+		PyKBytes* obj = PyObject_New(PyKBytes, &PyKBytesType);
+		obj->value = new KValueRef(v);
+		obj->view = new BytesRef(bytes->Slice(0, bytes->Length()));
+		return (PyObject*) obj;
+	}
+
+	static Bytes* GetBytesView(PyObject* o)
+	{
+		return reinterpret_cast<PyKBytes*>(o)->view->get();
+	}
+
+	static void PyKBytes_dealloc(PyObject* self)
+	{
+		PyKBytes *pykb = reinterpret_cast<PyKBytes*>(self);
+
+		{
+			PyAllowThreads allow;
+			delete pykb->view;
+			delete pykb->value;
+		}
+
+		PyObject_Del(self);
+	}
+
+	static PyObject* PyKBytes_str(PyObject* self)
+	{
+		Bytes* bytes = GetBytesView(self);
+		return PyString_FromStringAndSize(bytes->GetBuffer(), bytes->Length());
+	}
+
+	static Py_ssize_t PyKBytesLength(PyObject* self)
+	{
+		return GetBytesView(self)->Length();
+	}
+
+	static PyObject* PyKBytesGetItem(PyObject* self, Py_ssize_t i)
+	{
+		Bytes* bytes = GetBytesView(self);
+		if (i < 0 || i >= bytes->Length())
+		{
+			PyErr_SetString(PyExc_IndexError, "Bytes index out of range");
+			return NULL;
+		}
+		return PyString_FromStringAndSize(bytes->GetBuffer() + i, 1);
+	}
+
+	static PyObject* PyKBytesSlice(PyObject* self, Py_ssize_t start, Py_ssize_t end)
+	{
+		// Python has already made negative indexes relative to the length.
+		Bytes* bytes = GetBytesView(self);
+		Py_ssize_t length = bytes->Length();
+		start = std::max((Py_ssize_t) 0, std::min(start, length));
+		end = std::max(start, std::min(end, length));
+		return PyString_FromStringAndSize(bytes->GetBuffer() + start, end - start);
+	}
+
+	static Py_ssize_t PyKBytesGetReadBuffer(PyObject* self, Py_ssize_t segment, void** data)
+	{
+		if (segment != 0)
+		{
+			PyErr_SetString(PyExc_SystemError, "Bytes have only one segment");
+			return -1;
+		}
+
+		Bytes* bytes = GetBytesView(self);
+		*data = const_cast<char*>(bytes->GetBuffer());
+		return bytes->Length();
+	}
+
+	static Py_ssize_t PyKBytesGetSegmentCount(PyObject* self, Py_ssize_t* length)
+	{
+		if (length)
+			*length = GetBytesView(self)->Length();
+		return 1;
+	}
+
+	static Py_ssize_t PyKBytesGetCharBuffer(PyObject* self, Py_ssize_t segment, char** data)
+	{
+		return PyKBytesGetReadBuffer(self, segment, reinterpret_cast<void**>(data));
+	}
+
+#if PY_VERSION_HEX >= 0x02060000
+	static int PyKBytesGetBuffer(PyObject* self, Py_buffer* view, int flags)
+	{
+		Bytes* bytes = GetBytesView(self);
+		return PyBuffer_FillInfo(view, self, const_cast<char*>(bytes->GetBuffer()),
+			bytes->Length(), 1, flags);
+	}
+#endif
+
 	static Py_ssize_t PyKListLength(PyObject* o)
 	{
 		PyLockGIL lock;
@@ -647,6 +924,104 @@ namespace kroll
 		return (PyObject*) obj;
 	}
 
+	struct BridgeTraversal
+	{
+		std::map<PyObject*, Py_ssize_t> internal;
+		std::vector<PyObject*> discovered;
+		std::set<PyObject*> alive;
+		std::vector<PyObject*> stack;
+	};
+
+	static bool IsBridgeWrapper(PyObject* object)
+	{
+		return PyObject_TypeCheck(object, &PyKObjectType) ||
+			PyObject_TypeCheck(object, &PyKMethodType) ||
+			PyObject_TypeCheck(object, &PyKListType);
+	}
+
+	static int CountReference(PyObject* referent, void* data)
+	{
+		BridgeTraversal* traversal = static_cast<BridgeTraversal*>(data);
+		std::map<PyObject*, Py_ssize_t>::iterator i =
+			traversal->internal.find(referent);
+		if (i == traversal->internal.end())
+		{
+			traversal->internal[referent] = 1;
+			traversal->discovered.push_back(referent);
+		}
+		else
+		{
+			i->second++;
+		}
+		return 0;
+	}
+
+	static int MarkReference(PyObject* referent, void* data)
+	{
+		BridgeTraversal* traversal = static_cast<BridgeTraversal*>(data);
+		if (traversal->internal.find(referent) != traversal->internal.end() &&
+			traversal->alive.insert(referent).second)
+		{
+			traversal->stack.push_back(referent);
+		}
+		return 0;
+	}
+
+	static void TraverseReferents(PyObject* object, visitproc visit, void* data)
+	{
+		// Wrappers lead back into Kroll, which is the collector's business.
+		if (IsBridgeWrapper(object) || !PyObject_IS_GC(object))
+			return;
+
+		traverseproc traverse = object->ob_type->tp_traverse;
+		if (traverse)
+			traverse(object, visit, data);
+	}
+
+	void PythonUtils::TraverseBridgeReferences(PyObject* object, Py_ssize_t pins,
+		CycleCollectorTraversal& traversal)
+	{
+		PyLockGIL lock;
+		BridgeTraversal t;
+		t.internal[object] = 0;
+		t.discovered.push_back(object);
+		for (size_t i = 0; i < t.discovered.size(); i++)
+		{
+			// Reporting nothing keeps every Kroll object in the graph alive.
+			if (t.discovered.size() > MAX_BRIDGE_TRAVERSAL)
+				return;
+			TraverseReferents(t.discovered[i], &CountReference, &t);
+		}
+
+		// Objects with references from outside the graph (other than the
+		// Kroll objects pinning the root) are reachable from Python's own
+		// roots, and so is everything they reach.
+		t.internal[object] += pins;
+		for (size_t i = 0; i < t.discovered.size(); i++)
+		{
+			PyObject* o = t.discovered[i];
+			if (o->ob_refcnt > t.internal[o] && t.alive.insert(o).second)
+				t.stack.push_back(o);
+		}
+
+		while (!t.stack.empty())
+		{
+			PyObject* o = t.stack.back();
+			t.stack.pop_back();
+			TraverseReferents(o, &MarkReference, &t);
+		}
+
+		for (size_t i = 0; i < t.discovered.size(); i++)
+		{
+			PyObject* o = t.discovered[i];
+			if (IsBridgeWrapper(o) && t.alive.find(o) == t.alive.end())
+			{
+				PyKObject* wrapper = reinterpret_cast<PyKObject*>(o);
+				traversal.NoteValue(wrapper->value->get());
+			}
+		}
+	}
+
 	std::string PythonUtils::PythonErrorToString()
 	{
 		std::string fullTraceString("");
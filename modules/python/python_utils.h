@@ -22,7 +22,17 @@ namespace kroll
 		static PyObject* KObjectToPyObject(KValueRef o);
 		static PyObject* KMethodToPyObject(KValueRef o);
 		static PyObject* KListToPyObject(KValueRef o);
+		static PyObject* BytesToPyObject(KValueRef o);
+
+		/**
+		 * @return a Bytes which uses the memory of a Python object with a
+		 * buffer interface without copying it, or a null reference with a
+		 * Python exception set if the object has none
+		 */
+		static BytesRef ToBytes(PyObject* value);
 		static std::string PythonErrorToString();
+		static void TraverseBridgeReferences(PyObject* object, Py_ssize_t pins,
+			CycleCollectorTraversal& traversal);
 
 	private:
 		PythonUtils() {}
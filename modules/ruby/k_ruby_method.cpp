@@ -58,6 +58,8 @@ namespace kroll
 
 	KValueRef KRubyMethod::Call(const ValueList& args)
 	{
+		TraceSpan span("Ruby", *this->name ? this->name : this->GetType().c_str());
+
 		// Bloody hell, Ruby will segfault if we try to pass a number
 		// of args to a method that is greater than its arity
 		int arity = MethodArity(this->method);